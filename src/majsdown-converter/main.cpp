@@ -1,68 +1,1202 @@
+#include <majsdown/batch_renderer.hpp>
+#include <majsdown/conversion_daemon.hpp>
 #include <majsdown/converter.hpp>
+#include <majsdown/depfile.hpp>
+#include <majsdown/determinism.hpp>
+#include <majsdown/fork_server.hpp>
+#include <majsdown/hash.hpp>
+#include <majsdown/html_renderer.hpp>
+#include <majsdown/js_profile.hpp>
+#include <majsdown/json.hpp>
+#include <majsdown/output_file.hpp>
+#include <majsdown/pipelined_converter.hpp>
+#include <majsdown/result_cache.hpp>
+#include <majsdown/thread_pool.hpp>
 
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
-int main()
+namespace {
+
+struct options
+{
+    std::string_view _prelude_path;
+    std::string_view _fork_server_socket;
+    std::string_view _connect_socket;
+    std::string_view _daemon_socket;
+    std::string_view _cache_dir;
+    std::string_view _cache_size_mib;
+    std::string_view _input_path;
+    std::string_view _output_path;
+    std::string_view _depfile_path;
+    std::string_view _depfile_target;
+    std::string_view _html_options;
+    std::string_view _jobs;
+    std::string_view _batch_path;
+    std::string_view _benchmark_runs;
+    std::string_view _js_profile_name;
+    std::string_view _deterministic_now_ms;
+    bool _daemon = false;
+    bool _html = false;
+    bool _slides = false;
+    bool _pipelined = false;
+    bool _compiled = false;
+    bool _depfile = false;
+    bool _depfile_phony_targets = false;
+    bool _write_if_changed = false;
+    majsdown::html_config _html_config;
+    std::size_t _n_jobs = 0;
+    std::size_t _n_benchmark_runs = 0;
+    majsdown::js_profile _js_profile = majsdown::js_profile::full;
+    std::optional<majsdown::determinism_config> _determinism;
+};
+
+void print_usage()
+{
+    std::cerr << "Usage: majsdown-converter [options] [input.mjsd] "
+                 "[-o out.md]\n"
+                 "\n"
+                 "Reads from stdin and writes to stdout by default.\n"
+                 "\n"
+                 "Options:\n"
+                 "  -o <path>               write output to file\n"
+                 "  --write-if-changed      keep output file untouched if "
+                 "unchanged\n"
+                 "  -MD                     write depfile to <output>.d\n"
+                 "  -MF <path>              write depfile to path\n"
+                 "  -MT <target>            depfile target (default: "
+                 "output)\n"
+                 "  -MP                     add phony depfile targets\n"
+                 "  --html                  render the output to HTML\n"
+                 "  --html-options <list>   e.g. 'footnotes,no-smartypants'"
+                 "\n"
+                 "  --slides                render '---'-separated slides in "
+                 "parallel\n"
+                 "  --jobs <n>              rendering threads (default: all)"
+                 "\n"
+                 "  --prelude <path>        evaluate JS file before "
+                 "converting\n"
+                 "  --js-profile <name>     JS built-ins: 'strings', "
+                 "'standard' or 'full'\n"
+                 "                          (default: full)\n"
+                 "  --pipelined             run both passes concurrently\n"
+                 "  --compiled              run the first pass as a single "
+                 "JS program\n"
+                 "  --batch <path|->        render input once per JSON "
+                 "record (NDJSON\n"
+                 "                          file, stdin, or directory of "
+                 "'.json' files)\n"
+                 "  --benchmark <n>         convert input n times and report "
+                 "latencies\n"
+                 "  --deterministic <ms>    freeze the JS clock at <ms> since "
+                 "the epoch and\n"
+                 "                          seed Math.random\n"
+                 "  --fork-server <socket>  serve conversions over a Unix "
+                 "socket\n"
+                 "  --connect <socket>      convert via a running fork "
+                 "server\n"
+                 "  --daemon                serve JSON-RPC requests over "
+                 "stdio\n"
+                 "  --daemon-socket <path>  serve JSON-RPC requests over a "
+                 "Unix socket\n"
+                 "  --cache-dir <path>      reuse results of unchanged "
+                 "documents and majsdown_memo values\n"
+                 "  --cache-size <MiB>      cache size cap (default: 256)\n"
+              << std::endl;
+}
+
+[[nodiscard]] std::optional<options> parse_options(
+    const int argc, const char* const* argv)
+{
+    options result;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+
+        const auto next_value = [&]() -> std::optional<std::string_view>
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "((MJSD ERROR))(?): Missing value for '" << arg
+                          << "'\n"
+                          << std::endl;
+
+                return std::nullopt;
+            }
+
+            return std::string_view{argv[++i]};
+        };
+
+        if (arg == "--daemon")
+        {
+            result._daemon = true;
+            continue;
+        }
+
+        if (arg == "-MD")
+        {
+            result._depfile = true;
+            continue;
+        }
+
+        if (arg == "-MP")
+        {
+            result._depfile_phony_targets = true;
+            continue;
+        }
+
+        if (arg == "--write-if-changed")
+        {
+            result._write_if_changed = true;
+            continue;
+        }
+
+        if (arg == "--html")
+        {
+            result._html = true;
+            continue;
+        }
+
+        if (arg == "--slides")
+        {
+            result._slides = true;
+            continue;
+        }
+
+        if (arg == "--pipelined")
+        {
+            result._pipelined = true;
+            continue;
+        }
+
+        if (arg == "--compiled")
+        {
+            result._compiled = true;
+            continue;
+        }
+
+        if (!arg.starts_with('-') && result._input_path.empty())
+        {
+            result._input_path = arg;
+            continue;
+        }
+
+        std::string_view* target = nullptr;
+
+        if (arg == "--prelude")
+        {
+            target = &result._prelude_path;
+        }
+        else if (arg == "--fork-server")
+        {
+            target = &result._fork_server_socket;
+        }
+        else if (arg == "--connect")
+        {
+            target = &result._connect_socket;
+        }
+        else if (arg == "--daemon-socket")
+        {
+            target = &result._daemon_socket;
+        }
+        else if (arg == "--cache-dir")
+        {
+            target = &result._cache_dir;
+        }
+        else if (arg == "--cache-size")
+        {
+            target = &result._cache_size_mib;
+        }
+        else if (arg == "-o")
+        {
+            target = &result._output_path;
+        }
+        else if (arg == "-MF")
+        {
+            target = &result._depfile_path;
+        }
+        else if (arg == "-MT")
+        {
+            target = &result._depfile_target;
+        }
+        else if (arg == "--html-options")
+        {
+            target = &result._html_options;
+        }
+        else if (arg == "--jobs")
+        {
+            target = &result._jobs;
+        }
+        else if (arg == "--batch")
+        {
+            target = &result._batch_path;
+        }
+        else if (arg == "--benchmark")
+        {
+            target = &result._benchmark_runs;
+        }
+        else if (arg == "--js-profile")
+        {
+            target = &result._js_profile_name;
+        }
+        else if (arg == "--deterministic")
+        {
+            target = &result._deterministic_now_ms;
+        }
+        else
+        {
+            std::cerr << "((MJSD ERROR))(?): Unknown option '" << arg
+                      << "'\n\n";
+
+            print_usage();
+            return std::nullopt;
+        }
+
+        const std::optional<std::string_view> value = next_value();
+        if (!value.has_value())
+        {
+            return std::nullopt;
+        }
+
+        *target = *value;
+    }
+
+    const auto fail = [](const std::string_view reason)
+    {
+        std::cerr << "((MJSD ERROR))(?): " << reason << "\n\n";
+        print_usage();
+        return std::nullopt;
+    };
+
+    if (!majsdown::parse_html_options(
+            result._html_options, result._html_config))
+    {
+        return fail("Invalid '--html-options'");
+    }
+
+    if (result._slides && !result._html)
+    {
+        return fail("'--slides' requires '--html'");
+    }
+
+    if (result._compiled && result._pipelined)
+    {
+        return fail("'--compiled' cannot be used with '--pipelined'");
+    }
+
+    if (!result._batch_path.empty())
+    {
+        if (result._input_path.empty())
+        {
+            return fail("'--batch' requires an input file");
+        }
+
+        if (result._slides || result._pipelined)
+        {
+            return fail(
+                "'--batch' cannot be used with '--slides' or '--pipelined'");
+        }
+    }
+
+    if (!result._js_profile_name.empty())
+    {
+        const std::optional<majsdown::js_profile> profile =
+            majsdown::parse_js_profile(result._js_profile_name);
+
+        if (!profile.has_value())
+        {
+            return fail("Invalid '--js-profile'");
+        }
+
+        if (!result._fork_server_socket.empty() || result._daemon ||
+            !result._daemon_socket.empty())
+        {
+            return fail("'--js-profile' cannot be used with '--fork-server' "
+                        "or the daemon");
+        }
+
+        result._js_profile = *profile;
+    }
+
+    if (!result._deterministic_now_ms.empty())
+    {
+        const std::string_view value = result._deterministic_now_ms;
+
+        std::int64_t now_ms;
+        const auto [ptr, ec] =
+            std::from_chars(value.data(), value.data() + value.size(), now_ms);
+
+        if (ec != std::errc{} || ptr != value.data() + value.size())
+        {
+            return fail("Invalid '--deterministic'");
+        }
+
+        if (!result._batch_path.empty() || !result._connect_socket.empty() ||
+            !result._fork_server_socket.empty() || result._daemon ||
+            !result._daemon_socket.empty())
+        {
+            return fail("'--deterministic' cannot be used with '--batch', "
+                        "'--connect', '--fork-server' or the daemon");
+        }
+
+        result._determinism.emplace(
+            majsdown::determinism_config{._now_ms = now_ms});
+    }
+
+    if (!result._benchmark_runs.empty())
+    {
+        const auto [ptr, ec] = std::from_chars(result._benchmark_runs.data(),
+            result._benchmark_runs.data() + result._benchmark_runs.size(),
+            result._n_benchmark_runs);
+
+        if (ec != std::errc{} || result._n_benchmark_runs == 0 ||
+            ptr != result._benchmark_runs.data() +
+                       result._benchmark_runs.size())
+        {
+            return fail("Invalid '--benchmark'");
+        }
+
+        if (!result._batch_path.empty() || !result._connect_socket.empty())
+        {
+            return fail(
+                "'--benchmark' cannot be used with '--batch' or '--connect'");
+        }
+    }
+
+    if (!result._jobs.empty())
+    {
+        const auto [ptr, ec] = std::from_chars(result._jobs.data(),
+            result._jobs.data() + result._jobs.size(), result._n_jobs);
+
+        if (ec != std::errc{} ||
+            ptr != result._jobs.data() + result._jobs.size())
+        {
+            return fail("Invalid '--jobs'");
+        }
+    }
+
+    if (result._output_path.empty())
+    {
+        if (result._depfile && result._depfile_path.empty())
+        {
+            return fail("'-MD' requires '-o' or '-MF'");
+        }
+
+        if (result._write_if_changed)
+        {
+            return fail("'--write-if-changed' requires '-o'");
+        }
+
+        if (!result._depfile_path.empty() && result._depfile_target.empty())
+        {
+            return fail("'-MF' requires '-o' or '-MT'");
+        }
+    }
+
+    return result;
+}
+
+void read_lines(std::istream& is, std::string& buffer, std::string& line_buffer)
+{
+    while (std::getline(is, line_buffer))
+    {
+        buffer.append(line_buffer);
+        buffer.append(1, '\n');
+    }
+}
+
+[[nodiscard]] bool read_file(const std::string_view path, std::string& buffer)
+{
+    std::ifstream ifs{std::string{path}, std::ios::binary};
+    if (!ifs)
+    {
+        std::cerr << "((MJSD ERROR))(?): Failed to open file '" << path
+                  << "'\n"
+                  << std::endl;
+
+        return false;
+    }
+
+    buffer.assign(std::istreambuf_iterator<char>{ifs},
+        std::istreambuf_iterator<char>{});
+
+    return true;
+}
+
+[[nodiscard]] std::optional<std::uintmax_t> parse_cache_size(
+    const std::string_view mib)
+{
+    if (mib.empty())
+    {
+        return std::uintmax_t{256} * 1024 * 1024;
+    }
+
+    std::uintmax_t result;
+    const auto [ptr, ec] =
+        std::from_chars(mib.data(), mib.data() + mib.size(), result);
+
+    if (ec != std::errc{} || ptr != mib.data() + mib.size())
+    {
+        std::cerr << "((MJSD ERROR))(?): Invalid cache size '" << mib
+                  << "'\n"
+                  << std::endl;
+
+        return std::nullopt;
+    }
+
+    return result * 1024 * 1024;
+}
+
+[[nodiscard]] bool write_output(
+    const options& opts, const std::string_view output)
+{
+    if (opts._output_path.empty())
+    {
+        std::cout << output << std::endl;
+        return true;
+    }
+
+    std::string contents{output};
+    contents.append(1, '\n');
+
+    return opts._write_if_changed
+               ? majsdown::write_file_if_changed(
+                     opts._output_path, contents, std::cerr)
+               : majsdown::write_file(opts._output_path, contents, std::cerr);
+}
+
+[[nodiscard]] bool write_depfile(
+    const options& opts, const std::vector<std::string>& touched_files)
+{
+    if (!opts._depfile && opts._depfile_path.empty())
+    {
+        return true;
+    }
+
+    const std::string depfile_path = opts._depfile_path.empty()
+                                         ? std::string{opts._output_path} + ".d"
+                                         : std::string{opts._depfile_path};
+
+    std::vector<std::string> dependencies;
+
+    if (!opts._input_path.empty())
+    {
+        dependencies.emplace_back(opts._input_path);
+    }
+
+    if (!opts._prelude_path.empty())
+    {
+        dependencies.emplace_back(opts._prelude_path);
+    }
+
+    dependencies.insert(
+        dependencies.end(), touched_files.begin(), touched_files.end());
+
+    const std::string_view target = opts._depfile_target.empty()
+                                        ? opts._output_path
+                                        : opts._depfile_target;
+
+    return majsdown::write_file(depfile_path,
+        majsdown::make_depfile(
+            target, dependencies, opts._depfile_phony_targets),
+        std::cerr);
+}
+
+[[nodiscard]] int report_failed_pass(const int status)
+{
+    std::cerr << "((MJSD ERROR))(?): Fatal error during majsdown "
+                 "conversion process ("
+              << (status == 1 ? "first" : "second") << " pass)\n"
+              << std::endl;
+
+    return status;
+}
+
+// Templates only depend on the source, so they survive changes to included
+// files that invalidate the cached output.
+constexpr std::uint64_t template_cache_variant = std::uint64_t{1} << 35;
+
+[[nodiscard]] std::optional<majsdown::converter::compiled_template>
+load_or_compile_template(majsdown::converter& converter,
+    const std::string& source, majsdown::result_cache* cache)
+{
+    const std::uint64_t key =
+        majsdown::result_cache::compute_key(source, "", template_cache_variant);
+
+    if (std::ostringstream oss;
+        cache != nullptr && cache->write_cached_output(key, oss))
+    {
+        if (auto result =
+                majsdown::converter::compiled_template::deserialize(oss.str());
+            result.has_value())
+        {
+            return result;
+        }
+    }
+
+    majsdown::converter::compiled_template result;
+    if (!converter.compile_template(
+            majsdown::first_pass_config, source, result))
+    {
+        return std::nullopt;
+    }
+
+    if (cache != nullptr)
+    {
+        cache->store(key, {}, result.serialize());
+    }
+
+    return result;
+}
+
+// Modules are resolved relative to the input document
+[[nodiscard]] std::string module_directory(const options& opts)
+{
+    return std::filesystem::path{opts._input_path}.parent_path().string();
+}
+
+// Absolute form of `module_directory`, telling apart identical documents
+// that import different modules.
+[[nodiscard]] std::string absolute_module_directory(const options& opts)
+{
+    const std::filesystem::path directory =
+        std::filesystem::path{module_directory(opts)} / ".";
+
+    std::error_code ec;
+    const std::filesystem::path absolute =
+        std::filesystem::absolute(directory, ec);
+
+    return (ec ? directory : absolute).lexically_normal().string();
+}
+
+[[nodiscard]] int convert(const options& opts, const std::string& prelude,
+    std::string& buffer, std::string& scratch_buffer,
+    std::vector<std::string>& touched_files, majsdown::result_cache* cache,
+    bool* nondeterministic = nullptr, bool* used_js_interpreter = nullptr,
+    majsdown::converter::inline_expression_stats* stats = nullptr)
+{
+    majsdown::converter converter{std::cerr};
+    converter.set_js_profile(opts._js_profile);
+    converter.set_touched_files_sink(&touched_files);
+    converter.set_module_directory(module_directory(opts));
+    converter.set_memo_cache(cache);
+    converter.set_determinism(opts._determinism);
+    converter.set_nondeterminism_flag(nondeterministic);
+
+    if (!opts._prelude_path.empty() && !converter.evaluate(prelude))
+    {
+        return 1;
+    }
+
+    if (!opts._compiled)
+    {
+        const int status = converter.convert_all_passes(buffer, scratch_buffer);
+
+        if (used_js_interpreter != nullptr)
+        {
+            *used_js_interpreter = converter.has_js_interpreter();
+        }
+
+        if (stats != nullptr)
+        {
+            *stats = converter.get_inline_expression_stats();
+        }
+
+        return status == 0 ? 0 : report_failed_pass(status);
+    }
+
+    if (used_js_interpreter != nullptr)
+    {
+        *used_js_interpreter = true;
+    }
+
+    const std::optional<majsdown::converter::compiled_template> tmpl =
+        load_or_compile_template(converter, buffer, cache);
+
+    if (!tmpl.has_value())
+    {
+        return report_failed_pass(1);
+    }
+
+    if (const int status = converter.convert_all_passes_compiled(
+            *tmpl, buffer, scratch_buffer);
+        status != 0)
+    {
+        return report_failed_pass(status);
+    }
+
+    return 0;
+}
+
+[[nodiscard]] int convert_pipelined(const options& opts,
+    const std::string& prelude, std::string& buffer,
+    std::vector<std::string>& touched_files,
+    majsdown::result_cache* cache = nullptr, bool* nondeterministic = nullptr)
+{
+    // Each pass thread records into its own variables
+    std::vector<std::string> second_touched_files;
+    std::array<bool, 2> prelude_failed{};
+    std::array<bool, 2> pass_nondeterministic{};
+
+    const int status = majsdown::convert_all_passes_pipelined(buffer,
+        std::cerr,
+        [&](majsdown::converter& converter, const int pass_index)
+        {
+            converter.set_js_profile(opts._js_profile);
+            converter.set_touched_files_sink(
+                pass_index == 1 ? &touched_files : &second_touched_files);
+            converter.set_module_directory(module_directory(opts));
+            converter.set_memo_cache(cache);
+            converter.set_determinism(opts._determinism);
+            converter.set_nondeterminism_flag(
+                &pass_nondeterministic[pass_index - 1]);
+
+            if (!opts._prelude_path.empty() && !converter.evaluate(prelude))
+            {
+                prelude_failed[pass_index - 1] = true;
+                return false;
+            }
+
+            return true;
+        });
+
+    if (status != 0)
+    {
+        return prelude_failed[0] || prelude_failed[1]
+                   ? 1
+                   : report_failed_pass(status);
+    }
+
+    touched_files.insert(touched_files.end(), second_touched_files.begin(),
+        second_touched_files.end());
+
+    if (nondeterministic != nullptr)
+    {
+        *nondeterministic =
+            pass_nondeterministic[0] || pass_nondeterministic[1];
+    }
+
+    return 0;
+}
+
+[[nodiscard]] bool render_output(
+    const options& opts, std::string& buffer, std::string& scratch_buffer)
+{
+    scratch_buffer.clear();
+    scratch_buffer.reserve(buffer.size() * 2);
+
+    if (opts._slides)
+    {
+        majsdown::thread_pool pool{opts._n_jobs};
+
+        if (!majsdown::render_html_slides(
+                buffer, scratch_buffer, opts._html_config, pool, std::cerr))
+        {
+            return false;
+        }
+    }
+    else if (!majsdown::render_html(
+                 buffer, scratch_buffer, opts._html_config, std::cerr))
+    {
+        return false;
+    }
+
+    buffer.swap(scratch_buffer);
+    return true;
+}
+
+// Converts `source` from scratch `opts._n_benchmark_runs` times, as separate
+// invocations of the converter would, and reports the latency of each run
+// instead of writing the output. The result cache is not used.
+[[nodiscard]] int run_benchmark(
+    const options& opts, const std::string& source, const std::string& prelude)
+{
+    using clock = std::chrono::steady_clock;
+
+    std::string buffer;
+    std::string scratch_buffer;
+    std::vector<std::string> touched_files;
+    std::vector<double> latencies_us;
+    latencies_us.reserve(opts._n_benchmark_runs);
+
+    bool used_js_interpreter = opts._pipelined;
+
+    // Same for every run. Unknown with `--pipelined` and `--compiled`
+    majsdown::converter::inline_expression_stats stats;
+
+    for (std::size_t i = 0; i < opts._n_benchmark_runs; ++i)
+    {
+        buffer.assign(source);
+        touched_files.clear();
+
+        const clock::time_point begin = clock::now();
+
+        if (const int status = opts._pipelined
+                                   ? convert_pipelined(
+                                         opts, prelude, buffer, touched_files)
+                                   : convert(opts, prelude, buffer,
+                                         scratch_buffer, touched_files,
+                                         nullptr, nullptr,
+                                         &used_js_interpreter, &stats);
+            status != 0)
+        {
+            return status;
+        }
+
+        if (opts._html && !render_output(opts, buffer, scratch_buffer))
+        {
+            return 1;
+        }
+
+        latencies_us.push_back(
+            std::chrono::duration<double, std::micro>{clock::now() - begin}
+                .count());
+    }
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+
+    double total_us = 0;
+    for (const double latency_us : latencies_us)
+    {
+        total_us += latency_us;
+    }
+
+    const double mean_us = total_us / static_cast<double>(latencies_us.size());
+
+    std::cout << "runs:           " << latencies_us.size() << '\n'
+              << "input bytes:    " << source.size() << '\n'
+              << "js interpreter: "
+              << (used_js_interpreter ? "created" : "skipped") << '\n'
+              << "min:            " << latencies_us.front() << " us\n"
+              << "median:         " << latencies_us[latencies_us.size() / 2]
+              << " us\n"
+              << "mean:           " << mean_us << " us\n"
+              << "max:            " << latencies_us.back() << " us\n"
+              << "throughput:     "
+              << static_cast<double>(source.size()) / mean_us << " MB/s"
+              << '\n';
+
+    // The whole conversion, apportioned to its inline expressions
+    if (stats._n_evaluated > 0)
+    {
+        std::cout << "inline exprs:   " << stats._n_evaluated << " ("
+                  << stats._n_trivial << " not compiled)\n"
+                  << "per expression: "
+                  << mean_us / static_cast<double>(stats._n_evaluated)
+                  << " us\n";
+    }
+
+    std::cout << std::flush;
+
+    return 0;
+}
+
+// Results of NDJSON records are written as NDJSON, in completion order.
+void write_batch_result_json(
+    std::ostream& os, const majsdown::batch_renderer::result& r)
+{
+    std::string line = "{\"index\":";
+    line.append(std::to_string(r._index));
+    line.append(",\"success\":");
+    line.append(r._status == 0 ? "true" : "false");
+    line.append(",\"failedPass\":");
+    line.append(r._status == 0 ? "null" : std::to_string(r._status));
+    line.append(",\"output\":");
+    majsdown::append_json_string(line, r._status == 0 ? r._output : "");
+    line.append(",\"diagnostics\":");
+    majsdown::append_diagnostics_json(line, r._diagnostics);
+    line.append("}\n");
+
+    // Flushed right away, so consumers can process results as they finish
+    os << line << std::flush;
+}
+
+[[nodiscard]] int run_batch(
+    const options& opts, const std::string& source, const std::string& prelude)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    const bool from_directory =
+        opts._batch_path != "-" && fs::is_directory(opts._batch_path, ec);
+
+    // Directory records, listed upfront as workers name outputs after them
+    std::vector<fs::path> record_paths;
+
+    if (from_directory)
+    {
+        if (opts._output_path.empty())
+        {
+            std::cerr << "((MJSD ERROR))(?): '--batch' with a directory "
+                         "requires '-o <directory>'\n"
+                      << std::endl;
+
+            return 1;
+        }
+
+        for (const fs::directory_entry& entry :
+            fs::directory_iterator{opts._batch_path, ec})
+        {
+            if (entry.path().extension() == ".json")
+            {
+                record_paths.push_back(entry.path());
+            }
+        }
+
+        std::sort(record_paths.begin(), record_paths.end());
+        fs::create_directories(opts._output_path, ec);
+    }
+
+    std::ofstream ofs;
+    std::ostream* os = &std::cout;
+
+    if (!from_directory && !opts._output_path.empty())
+    {
+        ofs.open(std::string{opts._output_path}, std::ios::binary);
+        os = &ofs;
+    }
+
+    // Cleared by the workers as well as by this thread
+    std::atomic<bool> all_ok = true;
+    const std::string_view extension = opts._html ? ".html" : ".md";
+
+    majsdown::batch_renderer renderer{opts._n_jobs,
+        [&](majsdown::batch_renderer::result& r)
+        {
+            if (r._status != 0)
+            {
+                all_ok = false;
+            }
+
+            if (!from_directory)
+            {
+                write_batch_result_json(*os, r);
+                return;
+            }
+
+            const fs::path& record_path = record_paths[r._index];
+
+            if (r._status != 0)
+            {
+                std::cerr << "((MJSD ERROR))(?): Failed to render record '"
+                          << record_path.string() << "'\n\n"
+                          << r._diagnostics << std::flush;
+
+                return;
+            }
+
+            r._output.append(1, '\n');
+
+            const fs::path output_path =
+                fs::path{opts._output_path} /
+                (record_path.stem().string() + std::string{extension});
+
+            if (!majsdown::write_file(
+                    output_path.string(), r._output, std::cerr))
+            {
+                all_ok = false;
+            }
+        },
+        opts._js_profile};
+
+    if (!renderer.load_template(source, prelude,
+            opts._html ? &opts._html_config : nullptr, std::cerr))
+    {
+        return 1;
+    }
+
+    if (from_directory)
+    {
+        for (const fs::path& record_path : record_paths)
+        {
+            std::string record;
+            if (!read_file(record_path.string(), record))
+            {
+                // Keeps indices aligned with `record_paths`
+                record = "null";
+                all_ok = false;
+            }
+
+            renderer.submit(std::move(record));
+        }
+    }
+    else
+    {
+        std::ifstream ifs;
+        std::istream* is = &std::cin;
+
+        if (opts._batch_path != "-")
+        {
+            ifs.open(std::string{opts._batch_path}, std::ios::binary);
+            if (!ifs)
+            {
+                std::cerr << "((MJSD ERROR))(?): Failed to open file '"
+                          << opts._batch_path << "'\n"
+                          << std::endl;
+
+                return 1;
+            }
+
+            is = &ifs;
+        }
+
+        for (std::string line; std::getline(*is, line);)
+        {
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+            {
+                renderer.submit(std::move(line));
+            }
+        }
+    }
+
+    renderer.finish();
+    return all_ok && *os ? 0 : 1;
+}
+
+[[nodiscard]] int run_fork_server(const options& opts)
+{
+    majsdown::fork_server server{std::cerr};
+
+    if (!opts._prelude_path.empty())
+    {
+        std::string prelude;
+        if (!read_file(opts._prelude_path, prelude) ||
+            !server.load_prelude(prelude))
+        {
+            return 1;
+        }
+    }
+
+    return server.run(opts._fork_server_socket) ? 0 : 1;
+}
+
+[[nodiscard]] int run_daemon(const options& opts)
+{
+    majsdown::conversion_daemon daemon{std::cerr};
+
+    if (!opts._prelude_path.empty())
+    {
+        std::string prelude;
+        if (!read_file(opts._prelude_path, prelude) ||
+            !daemon.load_prelude(prelude))
+        {
+            return 1;
+        }
+    }
+
+    const bool ok = opts._daemon_socket.empty()
+                        ? daemon.serve(std::cin, std::cout)
+                        : daemon.serve_socket(opts._daemon_socket);
+
+    return ok ? 0 : 1;
+}
+
+[[nodiscard]] int run_client(const options& opts, const std::string& source)
+{
+    majsdown::fork_server_response response;
+
+    if (!majsdown::request_fork_server_conversion(
+            opts._connect_socket, source, response, std::cerr))
+    {
+        return 1;
+    }
+
+    std::cerr << response._diagnostics;
+
+    if (response._status != 0)
+    {
+        return report_failed_pass(response._status);
+    }
+
+    std::cout << response._output << std::endl;
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
 {
     std::ios_base::sync_with_stdio(false);
     std::cin.tie(nullptr);
 
+    const std::optional<options> opts = parse_options(argc, argv);
+    if (!opts.has_value())
+    {
+        return 1;
+    }
+
+    if (!opts->_fork_server_socket.empty())
+    {
+        return run_fork_server(*opts);
+    }
+
+    if (opts->_daemon || !opts->_daemon_socket.empty())
+    {
+        return run_daemon(*opts);
+    }
+
     std::string input_and_final_buffer;
     input_and_final_buffer.reserve(128000);
 
     std::string line_and_output_buffer;
     line_and_output_buffer.reserve(512);
 
-    while (std::getline(std::cin, line_and_output_buffer))
+    if (opts->_input_path.empty())
     {
-        input_and_final_buffer.append(line_and_output_buffer);
-        input_and_final_buffer.append(1, '\n');
+        read_lines(std::cin, input_and_final_buffer, line_and_output_buffer);
     }
+    else
+    {
+        std::ifstream ifs{std::string{opts->_input_path}};
+        if (!ifs)
+        {
+            std::cerr << "((MJSD ERROR))(?): Failed to open file '"
+                      << opts->_input_path << "'\n"
+                      << std::endl;
 
-    line_and_output_buffer.clear();
-    line_and_output_buffer.reserve(input_and_final_buffer.size() + 1024);
-
-    majsdown::converter converter{std::cerr};
+            return 1;
+        }
 
-    constexpr majsdown::converter::config fst_pass_cfg{
-        .skip_escaped_symbols = true,
-        .skip_inline_expressions = false,
-        .skip_inline_statements = false,
-        .skip_block_statements = false,
-        .skip_code_block_decorators = true //
-    };
+        read_lines(ifs, input_and_final_buffer, line_and_output_buffer);
+    }
 
-    if (!converter.convert(
-            fst_pass_cfg, line_and_output_buffer, input_and_final_buffer))
+    if (!opts->_connect_socket.empty())
     {
-        std::cerr << "((MJSD ERROR))(?): Fatal error during majsdown "
-                     "conversion process (first pass)\n"
-                  << std::endl;
+        return run_client(*opts, input_and_final_buffer);
+    }
 
+    std::string prelude;
+    if (!opts->_prelude_path.empty() &&
+        !read_file(opts->_prelude_path, prelude))
+    {
         return 1;
     }
 
-    input_and_final_buffer.clear();
+    if (!opts->_batch_path.empty())
+    {
+        return run_batch(*opts, input_and_final_buffer, prelude);
+    }
+
+    if (opts->_n_benchmark_runs > 0)
+    {
+        return run_benchmark(*opts, input_and_final_buffer, prelude);
+    }
+
+    std::vector<std::string> touched_files;
 
-    constexpr majsdown::converter::config snd_pass_cfg{
-        .skip_escaped_symbols = false,
-        .skip_inline_expressions = false,
-        .skip_inline_statements = false,
-        .skip_block_statements = false,
-        .skip_code_block_decorators = false //
-    };
+    std::optional<majsdown::result_cache> cache;
+    std::uint64_t cache_key = 0;
 
-    if (!converter.convert(
-            snd_pass_cfg, input_and_final_buffer, line_and_output_buffer))
+    if (!opts->_cache_dir.empty())
     {
-        std::cerr << "((MJSD ERROR))(?): Fatal error during majsdown "
-                     "conversion process (second pass)\n"
-                  << std::endl;
+        const std::optional<std::uintmax_t> max_size =
+            parse_cache_size(opts->_cache_size_mib);
+
+        if (!max_size.has_value())
+        {
+            return 1;
+        }
+
+        cache.emplace(opts->_cache_dir, *max_size, std::cerr);
+
+        std::uint64_t variant = 0;
+
+        if (opts->_html)
+        {
+            // Offset by one to tell HTML without flags apart from Markdown
+            variant = majsdown::get_discount_flags(opts->_html_config) + 1;
+            variant |= std::uint64_t{opts->_slides} << 32;
+        }
 
-        return 2;
+        // Pipelined conversions may see different JS state in the second pass
+        variant |= std::uint64_t{opts->_pipelined} << 33;
+
+        // Compiled templates hoist declarations across directives
+        variant |= std::uint64_t{opts->_compiled} << 34;
+
+        // Smaller profiles can change the result of feature detection
+        variant |= static_cast<std::uint64_t>(opts->_js_profile) << 36;
+
+        // Deterministic outputs depend on the frozen time
+        if (opts->_determinism.has_value())
+        {
+            variant = majsdown::hash_combine(variant | (std::uint64_t{1} << 38),
+                static_cast<std::uint64_t>(opts->_determinism->_now_ms));
+        }
+
+        // Imported modules are resolved relative to the document
+        variant = majsdown::hash_bytes(
+            absolute_module_directory(*opts), variant);
+
+        cache_key = majsdown::result_cache::compute_key(
+            input_and_final_buffer, prelude, variant);
+
+        if (opts->_output_path.empty())
+        {
+            if (cache->write_cached_output(
+                    cache_key, std::cout, &touched_files))
+            {
+                std::cout << std::endl;
+                return write_depfile(*opts, touched_files) ? 0 : 1;
+            }
+        }
+        else if (std::ostringstream oss;
+                 cache->write_cached_output(cache_key, oss, &touched_files))
+        {
+            return write_output(*opts, oss.str()) &&
+                           write_depfile(*opts, touched_files)
+                       ? 0
+                       : 1;
+        }
+    }
+
+    // Set if the output depends on the real clock or random numbers
+    bool nondeterministic = false;
+
+    if (const int status = opts->_pipelined
+                               ? convert_pipelined(*opts, prelude,
+                                     input_and_final_buffer, touched_files,
+                                     cache.has_value() ? &*cache : nullptr,
+                                     &nondeterministic)
+                               : convert(*opts, prelude, input_and_final_buffer,
+                                     line_and_output_buffer, touched_files,
+                                     cache.has_value() ? &*cache : nullptr,
+                                     &nondeterministic);
+        status != 0)
+    {
+        return status;
+    }
+
+    if (opts->_html &&
+        !render_output(*opts, input_and_final_buffer, line_and_output_buffer))
+    {
+        return 1;
+    }
+
+    if (cache.has_value() && !nondeterministic)
+    {
+        cache->store(cache_key, touched_files, input_and_final_buffer);
+    }
+
+    if (!write_output(*opts, input_and_final_buffer) ||
+        !write_depfile(*opts, touched_files))
+    {
+        return 1;
     }
 
-    std::cout << input_and_final_buffer << std::endl;
     return 0;
 }
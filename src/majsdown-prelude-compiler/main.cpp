@@ -0,0 +1,159 @@
+// Build-time tool compiling `std_prelude.js` into a C++ source file that
+// embeds its bytecode, in the spirit of QuickJS' `qjsc`. The exported names
+// are found by running the script once, so they never need to be listed by
+// hand.
+//
+// Usage: majsdown-prelude-compiler <input.js> <output.cpp>
+
+#include <quickjs.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+[[nodiscard]] int fail(JSContext* ctx, const std::string_view what)
+{
+    const JSValue exception = JS_GetException(ctx);
+    const char* const message = JS_ToCString(ctx, exception);
+
+    std::cerr << "((MJSD ERROR))(?): Failed to " << what << " the prelude ("
+              << (message != nullptr ? message : "unknown error") << ")\n"
+              << std::endl;
+
+    JS_FreeCString(ctx, message);
+    JS_FreeValue(ctx, exception);
+
+    return 1;
+}
+
+void write_source(std::ostream& os, const std::uint8_t* bytecode,
+    const std::size_t size, const std::vector<std::string>& names)
+{
+    os << "// Generated by majsdown-prelude-compiler, do not edit.\n\n"
+          "#include \"majsdown/std_prelude.hpp\"\n\n"
+          "#include <cstdint>\n"
+          "#include <span>\n\n"
+          "namespace majsdown {\n\n"
+          "static constexpr std::uint8_t bytecode[] = {";
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        os << (i % 16 == 0 ? "\n    " : " ") << static_cast<int>(bytecode[i])
+           << ',';
+    }
+
+    os << "\n};\n\nstatic constexpr const char* names[] = {";
+
+    for (const std::string& name : names)
+    {
+        os << "\n    \"" << name << "\",";
+    }
+
+    os << "\n};\n\n"
+          "const std::span<const std::uint8_t> std_prelude_bytecode{"
+          "bytecode};\n"
+          "const std::span<const char* const> std_prelude_names{names};\n\n"
+          "} // namespace majsdown\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: majsdown-prelude-compiler <input.js> "
+                     "<output.cpp>\n";
+
+        return 1;
+    }
+
+    std::ifstream ifs{argv[1], std::ios::binary};
+    if (!ifs)
+    {
+        std::cerr << "((MJSD ERROR))(?): Failed to open file '" << argv[1]
+                  << "'\n"
+                  << std::endl;
+
+        return 1;
+    }
+
+    const std::string source{
+        std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    JSRuntime* const rt = JS_NewRuntime();
+    JSContext* const ctx = JS_NewContext(rt);
+
+    // The source must be null-terminated, which `std::string` guarantees
+    const JSValue func = JS_Eval(ctx, source.data(), source.size(),
+        "<std_prelude>", JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+
+    if (JS_IsException(func))
+    {
+        return fail(ctx, "compile");
+    }
+
+    std::size_t size;
+    std::uint8_t* const bytecode =
+        JS_WriteObject(ctx, &size, func, JS_WRITE_OBJ_BYTECODE);
+
+    if (bytecode == nullptr)
+    {
+        return fail(ctx, "serialize");
+    }
+
+    // Takes ownership of `func`
+    const JSValue exports = JS_EvalFunction(ctx, func);
+    if (JS_IsException(exports) || !JS_IsObject(exports))
+    {
+        return fail(ctx, "evaluate");
+    }
+
+    JSPropertyEnum* properties;
+    std::uint32_t n_properties;
+
+    if (JS_GetOwnPropertyNames(ctx, &properties, &n_properties, exports,
+            JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) != 0)
+    {
+        return fail(ctx, "inspect");
+    }
+
+    std::vector<std::string> names;
+
+    for (std::uint32_t i = 0; i < n_properties; ++i)
+    {
+        const char* const name = JS_AtomToCString(ctx, properties[i].atom);
+        names.emplace_back(name);
+
+        JS_FreeCString(ctx, name);
+        JS_FreeAtom(ctx, properties[i].atom);
+    }
+
+    js_free(ctx, properties);
+
+    std::ofstream ofs{argv[2], std::ios::binary | std::ios::trunc};
+    write_source(ofs, bytecode, size, names);
+    ofs.close();
+
+    js_free(ctx, bytecode);
+    JS_FreeValue(ctx, exports);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+
+    if (!ofs)
+    {
+        std::cerr << "((MJSD ERROR))(?): Failed to write file '" << argv[2]
+                  << "'\n"
+                  << std::endl;
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "base64.hpp"
+
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace majsdown {
+
+void append_base64(
+    std::string& output, const std::span<const std::uint8_t> bytes)
+{
+    constexpr std::string_view alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    const std::size_t out_begin = output.size();
+    output.resize(out_begin + (bytes.size() + 2) / 3 * 4);
+
+    char* out = output.data() + out_begin;
+    std::size_t i = 0;
+
+    for (; i + 3 <= bytes.size(); i += 3)
+    {
+        const std::uint32_t triple = (std::uint32_t{bytes[i]} << 16) |
+                                     (std::uint32_t{bytes[i + 1]} << 8) |
+                                     std::uint32_t{bytes[i + 2]};
+
+        *out++ = alphabet[(triple >> 18) & 0x3F];
+        *out++ = alphabet[(triple >> 12) & 0x3F];
+        *out++ = alphabet[(triple >> 6) & 0x3F];
+        *out++ = alphabet[triple & 0x3F];
+    }
+
+    if (const std::size_t rest = bytes.size() - i; rest > 0)
+    {
+        std::uint32_t triple = std::uint32_t{bytes[i]} << 16;
+        if (rest == 2)
+        {
+            triple |= std::uint32_t{bytes[i + 1]} << 8;
+        }
+
+        *out++ = alphabet[(triple >> 18) & 0x3F];
+        *out++ = alphabet[(triple >> 12) & 0x3F];
+        *out++ = rest == 2 ? alphabet[(triple >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+}
+
+} // namespace majsdown
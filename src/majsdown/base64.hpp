@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace majsdown {
+
+// Appends the standard (RFC 4648) base64 encoding of `bytes`, with padding.
+void append_base64(std::string& output, std::span<const std::uint8_t> bytes);
+
+} // namespace majsdown
@@ -0,0 +1,242 @@
+#include "batch_renderer.hpp"
+
+#include "majsdown/converter.hpp"
+#include "majsdown/html_renderer.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+#include <cstddef>
+
+namespace majsdown {
+
+namespace {
+
+struct job
+{
+    std::size_t _index;
+    std::string _record_json;
+};
+
+// Records queued per worker before `submit` blocks
+constexpr std::size_t queue_capacity_per_worker = 4;
+
+} // namespace
+
+struct batch_renderer::impl
+{
+    std::size_t _n_workers;
+    result_handler _on_result;
+    js_profile _js_profile;
+
+    converter::compiled_template _template;
+    std::string _prelude;
+    std::optional<html_config> _html;
+
+    std::mutex _mutex;
+    std::condition_variable _not_empty_cv;
+    std::condition_variable _not_full_cv;
+    std::deque<job> _jobs;
+    std::size_t _n_submitted = 0;
+    bool _finishing = false;
+
+    std::mutex _result_mutex;
+    std::vector<std::thread> _workers;
+
+    [[nodiscard]] explicit impl(const std::size_t n_workers,
+        result_handler&& on_result, const js_profile profile)
+        : _n_workers{n_workers},
+          _on_result{std::move(on_result)},
+          _js_profile{profile}
+    {
+        if (_n_workers == 0)
+        {
+            _n_workers = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+
+    [[nodiscard]] std::optional<job> pop_job()
+    {
+        std::unique_lock lock{_mutex};
+        _not_empty_cv.wait(lock, [&] { return _finishing || !_jobs.empty(); });
+
+        if (_jobs.empty())
+        {
+            return std::nullopt;
+        }
+
+        job result = std::move(_jobs.front());
+        _jobs.pop_front();
+
+        lock.unlock();
+        _not_full_cv.notify_one();
+
+        return result;
+    }
+
+    [[nodiscard]] int render_record(converter& cnvtr,
+        const std::string_view record_json, std::string& buffer,
+        std::string& scratch_buffer)
+    {
+        // A new context is much cheaper than a new runtime, and leaves no
+        // state behind from the previous record
+        cnvtr.reset();
+
+        if (!_prelude.empty() && !cnvtr.evaluate(_prelude))
+        {
+            return 1;
+        }
+
+        if (!cnvtr.set_global_json("majsdown_record", record_json))
+        {
+            return 1;
+        }
+
+        if (const int status = cnvtr.convert_all_passes_compiled(
+                _template, buffer, scratch_buffer);
+            status != 0)
+        {
+            return status;
+        }
+
+        if (_html.has_value() &&
+            !cnvtr.render_html(buffer, scratch_buffer, *_html))
+        {
+            return 3;
+        }
+
+        return 0;
+    }
+
+    void worker_loop()
+    {
+        // The interpreter must be created on the thread using it
+        std::ostringstream diagnostics;
+        converter cnvtr{diagnostics};
+        cnvtr.set_js_profile(_js_profile);
+
+        std::string buffer;
+        std::string scratch_buffer;
+
+        while (std::optional<job> j = pop_job())
+        {
+            diagnostics.str("");
+
+            result r{._index = j->_index, ._status = 0};
+            r._status =
+                render_record(cnvtr, j->_record_json, buffer, scratch_buffer);
+
+            r._output = std::move(buffer);
+            r._diagnostics = diagnostics.str();
+            buffer.clear();
+
+            const std::lock_guard lock{_result_mutex};
+            _on_result(r);
+        }
+    }
+
+    void join_workers()
+    {
+        {
+            const std::lock_guard lock{_mutex};
+            _finishing = true;
+        }
+
+        _not_empty_cv.notify_all();
+
+        for (std::thread& worker : _workers)
+        {
+            worker.join();
+        }
+
+        _workers.clear();
+    }
+};
+
+batch_renderer::batch_renderer(const std::size_t n_workers,
+    result_handler on_result, const js_profile profile)
+    : _impl{std::make_unique<impl>(n_workers, std::move(on_result), profile)}
+{}
+
+batch_renderer::~batch_renderer()
+{
+    finish();
+}
+
+bool batch_renderer::load_template(const std::string_view source,
+    const std::string_view prelude, const html_config* html,
+    std::ostream& err_stream) noexcept
+{
+    assert(_impl->_workers.empty());
+
+    {
+        converter cnvtr{err_stream};
+        cnvtr.set_js_profile(_impl->_js_profile);
+
+        // Reports errors in the prelude upfront, rather than once per record
+        if (!prelude.empty() && !cnvtr.evaluate(prelude))
+        {
+            return false;
+        }
+
+        if (!cnvtr.compile_template(
+                first_pass_config, source, _impl->_template))
+        {
+            return false;
+        }
+    }
+
+    _impl->_prelude.assign(prelude);
+
+    if (html != nullptr)
+    {
+        _impl->_html.emplace(*html);
+    }
+
+    _impl->_workers.reserve(_impl->_n_workers);
+
+    for (std::size_t i = 0; i < _impl->_n_workers; ++i)
+    {
+        _impl->_workers.emplace_back([this] { _impl->worker_loop(); });
+    }
+
+    return true;
+}
+
+void batch_renderer::submit(std::string record_json)
+{
+    assert(!_impl->_workers.empty());
+
+    {
+        std::unique_lock lock{_impl->_mutex};
+
+        _impl->_not_full_cv.wait(lock,
+            [&]
+            {
+                return _impl->_jobs.size() <
+                       _impl->_n_workers * queue_capacity_per_worker;
+            });
+
+        _impl->_jobs.push_back(job{._index = _impl->_n_submitted++,
+            ._record_json = std::move(record_json)});
+    }
+
+    _impl->_not_empty_cv.notify_one();
+}
+
+void batch_renderer::finish()
+{
+    _impl->join_workers();
+}
+
+} // namespace majsdown
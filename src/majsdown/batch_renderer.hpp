@@ -0,0 +1,71 @@
+#pragma once
+
+#include "majsdown/js_profile.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace majsdown {
+
+struct html_config;
+
+// Renders one document for many JSON records ("one template, many data
+// sets"). The document is compiled once into a template, which worker threads
+// then run for every record on a fresh JS context: the prelude is evaluated,
+// the record is bound to the global `majsdown_record`, and the result of both
+// passes (optionally rendered to HTML) is handed over as soon as it is done.
+class batch_renderer
+{
+public:
+    struct result
+    {
+        std::size_t _index; // Order in which the record was submitted
+
+        // `0` on success, otherwise the failing stage: `1` and `2` for the
+        // passes (including malformed records), `3` for HTML rendering
+        int _status;
+
+        std::string _output;
+        std::string _diagnostics;
+    };
+
+    // Called from worker threads, one result at a time, in completion order.
+    // It may move from the result.
+    using result_handler = std::function<void(result&)>;
+
+private:
+    struct impl;
+    std::unique_ptr<impl> _impl;
+
+public:
+    // Uses one worker per hardware thread if `n_workers` is `0`. Records are
+    // rendered with the JS built-ins of `profile`.
+    [[nodiscard]] explicit batch_renderer(std::size_t n_workers,
+        result_handler on_result, js_profile profile = js_profile::full);
+
+    // Finishes the submitted records, then joins the workers.
+    ~batch_renderer();
+
+    batch_renderer(const batch_renderer&) = delete;
+    batch_renderer& operator=(const batch_renderer&) = delete;
+
+    // Compiles `source` and starts the workers. Must be called once, before
+    // any `submit`. If `html` is not null, outputs are rendered to HTML.
+    // Returns `false` on failure, reported to `err_stream`.
+    [[nodiscard]] bool load_template(const std::string_view source,
+        const std::string_view prelude, const html_config* html,
+        std::ostream& err_stream) noexcept;
+
+    // Queues a JSON record for rendering, blocking while the workers are far
+    // behind.
+    void submit(std::string record_json);
+
+    // Blocks until every submitted record has been handed over.
+    void finish();
+};
+
+} // namespace majsdown
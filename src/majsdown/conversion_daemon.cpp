@@ -0,0 +1,657 @@
+#include "conversion_daemon.hpp"
+
+#include "majsdown/converter.hpp"
+#include "majsdown/file_cache.hpp"
+#include "majsdown/html_renderer.hpp"
+#include "majsdown/incremental_converter.hpp"
+#include "majsdown/json.hpp"
+#include "majsdown/slide_cache.hpp"
+#include "majsdown/thread_pool.hpp"
+#include "majsdown/unix_socket.hpp"
+
+#include <charconv>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <cstddef>
+
+namespace majsdown {
+
+namespace {
+
+struct warm_converter
+{
+    std::ostringstream _diagnostics;
+    converter _converter;
+
+    [[nodiscard]] explicit warm_converter()
+        : _diagnostics{}, _converter{_diagnostics}
+    {}
+};
+
+// Kept across requests naming the same document, so that successive
+// revisions are converted incrementally.
+struct document_session
+{
+    std::ostringstream _diagnostics;
+    incremental_converter _converter;
+
+    [[nodiscard]] explicit document_session()
+        : _diagnostics{}, _converter{_diagnostics}
+    {}
+};
+
+[[nodiscard]] std::string_view trim(std::string_view sv) noexcept
+{
+    const auto is_space = [](const char c)
+    { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+
+    while (!sv.empty() && is_space(sv.front()))
+    {
+        sv.remove_prefix(1);
+    }
+
+    while (!sv.empty() && is_space(sv.back()))
+    {
+        sv.remove_suffix(1);
+    }
+
+    return sv;
+}
+
+} // namespace
+
+void append_diagnostics_json(std::string& output, const std::string_view text)
+{
+    using namespace std::string_view_literals;
+    constexpr auto header = "((MJSD ERROR))("sv;
+
+    output.append(1, '[');
+
+    std::size_t curr = text.find(header);
+    bool first = true;
+
+    while (curr != std::string_view::npos)
+    {
+        const std::size_t line_begin = curr + header.size();
+        const std::size_t line_end = text.find(')', line_begin);
+
+        if (line_end == std::string_view::npos)
+        {
+            break;
+        }
+
+        const std::size_t next = text.find(header, line_end);
+        std::string_view message = text.substr(line_end + 1,
+            next == std::string_view::npos ? std::string_view::npos
+                                           : next - line_end - 1);
+
+        if (message.starts_with(':'))
+        {
+            message.remove_prefix(1);
+        }
+
+        if (!first)
+        {
+            output.append(1, ',');
+        }
+
+        first = false;
+        output.append("{\"line\":");
+
+        const std::string_view line_sv =
+            text.substr(line_begin, line_end - line_begin);
+
+        std::size_t line;
+        const auto [ptr, ec] = std::from_chars(
+            line_sv.data(), line_sv.data() + line_sv.size(), line);
+
+        if (ec == std::errc{} && ptr == line_sv.data() + line_sv.size())
+        {
+            output.append(std::to_string(line));
+        }
+        else
+        {
+            output.append("null");
+        }
+
+        output.append(",\"message\":");
+        append_json_string(output, trim(message));
+        output.append(1, '}');
+
+        curr = next;
+    }
+
+    output.append(1, ']');
+}
+
+namespace {
+
+// Formats `hits / (hits + misses)`, or `null` before any lookup.
+void append_hit_rate(
+    std::string& output, const std::size_t hits, const std::size_t misses)
+{
+    if (hits + misses == 0)
+    {
+        output.append("null");
+        return;
+    }
+
+    json_value rate;
+    rate._kind = json_value::kind::number;
+    rate._number =
+        static_cast<double>(hits) / static_cast<double>(hits + misses);
+
+    append_json(output, rate);
+}
+
+void append_response_header(std::string& response, const json_value& id)
+{
+    response.append("{\"jsonrpc\":\"2.0\",\"id\":");
+    append_json(response, id);
+}
+
+void append_error_response(std::string& response, const json_value& id,
+    const int code, const std::string_view message)
+{
+    append_response_header(response, id);
+    response.append(",\"error\":{\"code\":");
+    response.append(std::to_string(code));
+    response.append(",\"message\":");
+    append_json_string(response, message);
+    response.append("}}");
+}
+
+} // namespace
+
+struct conversion_daemon::impl
+{
+    std::ostream& _log_stream;
+    file_cache _file_cache;
+    std::string _prelude;
+    std::unique_ptr<warm_converter> _spare;
+    std::unordered_map<std::string, std::unique_ptr<document_session>>
+        _documents;
+    std::optional<thread_pool> _render_pool;
+    slide_cache _slide_cache;
+    std::string _buffer;
+    std::string _scratch_buffer;
+    std::size_t _n_requests;
+    std::size_t _n_segments_executed;
+    std::size_t _n_segments_reused;
+
+    [[nodiscard]] explicit impl(std::ostream& log_stream)
+        : _log_stream{log_stream},
+          _n_requests{0},
+          _n_segments_executed{0},
+          _n_segments_reused{0}
+    {}
+
+    [[nodiscard]] document_session& get_document_session(
+        const std::string& key)
+    {
+        std::unique_ptr<document_session>& session = _documents[key];
+
+        if (session == nullptr)
+        {
+            session = std::make_unique<document_session>();
+            session->_converter.set_file_cache(&_file_cache);
+
+            if (!_prelude.empty() &&
+                !session->_converter.load_prelude(_prelude))
+            {
+                _log_stream << session->_diagnostics.str();
+            }
+        }
+
+        return *session;
+    }
+
+    [[nodiscard]] std::unique_ptr<warm_converter> make_warm_converter()
+    {
+        auto result = std::make_unique<warm_converter>();
+        result->_converter.set_file_cache(&_file_cache);
+        result->_converter.warm_up();
+
+        if (!_prelude.empty() && !result->_converter.evaluate(_prelude))
+        {
+            _log_stream << result->_diagnostics.str();
+        }
+
+        return result;
+    }
+
+    void prepare()
+    {
+        if (_spare == nullptr)
+        {
+            _spare = make_warm_converter();
+        }
+    }
+
+    // Reads the optional `html`, `htmlOptions` and `slides` parameters.
+    // Appends an error response and returns `false` if they are invalid.
+    [[nodiscard]] static bool read_render_params(const json_value* params,
+        html_config& cfg, bool& html, bool& slides, const json_value& id,
+        std::string& response)
+    {
+        const auto find = [&](const std::string_view key)
+        { return params != nullptr ? params->find(key) : nullptr; };
+
+        const json_value* html_param = find("html");
+        const json_value* options_param = find("htmlOptions");
+        const json_value* slides_param = find("slides");
+
+        if ((html_param != nullptr && !html_param->is_boolean()) ||
+            (slides_param != nullptr && !slides_param->is_boolean()))
+        {
+            append_error_response(response, id, -32602,
+                "Parameters 'html' and 'slides' must be booleans");
+
+            return false;
+        }
+
+        if (options_param != nullptr &&
+            (!options_param->is_string() ||
+                !parse_html_options(options_param->_string, cfg)))
+        {
+            append_error_response(
+                response, id, -32602, "Invalid parameter 'htmlOptions'");
+
+            return false;
+        }
+
+        html = html_param != nullptr && html_param->_boolean;
+        slides = slides_param != nullptr && slides_param->_boolean;
+
+        if (slides && !html)
+        {
+            append_error_response(
+                response, id, -32602, "Parameter 'slides' requires 'html'");
+
+            return false;
+        }
+
+        return true;
+    }
+
+    // Renders `buffer` to HTML in place.
+    [[nodiscard]] bool render(std::string& buffer, const html_config& cfg,
+        const bool slides, std::ostream& err_stream)
+    {
+        _scratch_buffer.clear();
+
+        if (slides)
+        {
+            if (!_render_pool.has_value())
+            {
+                _render_pool.emplace();
+            }
+
+            if (!render_html_slides(buffer, _scratch_buffer, cfg,
+                    *_render_pool, err_stream, &_slide_cache))
+            {
+                return false;
+            }
+        }
+        else if (!render_html(buffer, _scratch_buffer, cfg, err_stream))
+        {
+            return false;
+        }
+
+        buffer.swap(_scratch_buffer);
+        return true;
+    }
+
+    void handle_convert(const json_value& id, const json_value* params,
+        std::string& response)
+    {
+        const json_value* source =
+            params != nullptr ? params->find("source") : nullptr;
+
+        if (source == nullptr || !source->is_string())
+        {
+            append_error_response(
+                response, id, -32602, "Missing string parameter 'source'");
+
+            return;
+        }
+
+        const json_value* document =
+            params != nullptr ? params->find("document") : nullptr;
+
+        if (document != nullptr && !document->is_string())
+        {
+            append_error_response(
+                response, id, -32602, "Parameter 'document' must be a string");
+
+            return;
+        }
+
+        html_config render_cfg;
+        bool html = false;
+        bool slides = false;
+
+        if (!read_render_params(
+                params, render_cfg, html, slides, id, response))
+        {
+            return;
+        }
+
+        // Match the line normalization performed by the command-line tool
+        _buffer.assign(source->_string);
+        if (!_buffer.empty() && _buffer.back() != '\n')
+        {
+            _buffer.append(1, '\n');
+        }
+
+        int status;
+        std::string diagnostics;
+
+        if (document != nullptr)
+        {
+            document_session& session =
+                get_document_session(document->_string);
+
+            session._diagnostics.str("");
+            status = session._converter.convert_all_passes(
+                _buffer, _scratch_buffer);
+            diagnostics = session._diagnostics.str();
+
+            const incremental_converter::stats ic_stats =
+                session._converter.get_last_stats();
+
+            _n_segments_executed += ic_stats._n_executed;
+            _n_segments_reused += ic_stats._n_reused;
+        }
+        else
+        {
+            prepare();
+            const std::unique_ptr<warm_converter> wc = std::move(_spare);
+
+            status =
+                wc->_converter.convert_all_passes(_buffer, _scratch_buffer);
+            diagnostics = wc->_diagnostics.str();
+        }
+
+        if (status == 0 && html)
+        {
+            std::ostringstream render_diagnostics;
+
+            if (!render(_buffer, render_cfg, slides, render_diagnostics))
+            {
+                status = 3;
+                diagnostics += render_diagnostics.str();
+            }
+        }
+
+        append_response_header(response, id);
+        response.append(",\"result\":{\"success\":");
+        response.append(status == 0 ? "true" : "false");
+        response.append(",\"failedPass\":");
+        response.append(status == 0 ? "null" : std::to_string(status));
+        response.append(",\"output\":");
+        append_json_string(response, status == 0 ? _buffer : "");
+        response.append(",\"diagnostics\":");
+        append_diagnostics_json(response, diagnostics);
+        response.append("}}");
+    }
+
+    void handle_close_document(const json_value& id, const json_value* params,
+        std::string& response)
+    {
+        const json_value* document =
+            params != nullptr ? params->find("document") : nullptr;
+
+        if (document == nullptr || !document->is_string())
+        {
+            append_error_response(
+                response, id, -32602, "Missing string parameter 'document'");
+
+            return;
+        }
+
+        const bool erased = _documents.erase(document->_string) != 0;
+
+        append_response_header(response, id);
+        response.append(",\"result\":");
+        response.append(erased ? "true" : "false");
+        response.append(1, '}');
+    }
+
+    void handle_stats(const json_value& id, std::string& response)
+    {
+        const file_cache::stats fc_stats = _file_cache.get_stats();
+        const slide_cache::stats sc_stats = _slide_cache.get_stats();
+
+        append_response_header(response, id);
+        response.append(",\"result\":{\"requests\":");
+        response.append(std::to_string(_n_requests));
+        response.append(",\"fileCacheHits\":");
+        response.append(std::to_string(fc_stats._hits));
+        response.append(",\"fileCacheMisses\":");
+        response.append(std::to_string(fc_stats._misses));
+        response.append(",\"documents\":");
+        response.append(std::to_string(_documents.size()));
+        response.append(",\"segmentsExecuted\":");
+        response.append(std::to_string(_n_segments_executed));
+        response.append(",\"segmentsReused\":");
+        response.append(std::to_string(_n_segments_reused));
+        response.append(",\"fileCacheHitRate\":");
+        append_hit_rate(response, fc_stats._hits, fc_stats._misses);
+        response.append(",\"slideCacheHits\":");
+        response.append(std::to_string(sc_stats._hits));
+        response.append(",\"slideCacheMisses\":");
+        response.append(std::to_string(sc_stats._misses));
+        response.append(",\"slideCacheHitRate\":");
+        append_hit_rate(response, sc_stats._hits, sc_stats._misses);
+        response.append("}}");
+    }
+
+    [[nodiscard]] bool handle_request(
+        const std::string_view request, std::string& response)
+    {
+        ++_n_requests;
+
+        const std::optional<json_value> parsed = parse_json(request);
+        if (!parsed.has_value() || !parsed->is_object())
+        {
+            append_error_response(response, json_value{}, -32700,
+                "Parse error");
+
+            return true;
+        }
+
+        const json_value* id = parsed->find("id");
+        const json_value* method = parsed->find("method");
+
+        std::string discarded;
+        std::string& target = id != nullptr ? response : discarded;
+        const json_value null_id{};
+
+        if (method == nullptr || !method->is_string())
+        {
+            append_error_response(target, id != nullptr ? *id : null_id,
+                -32600, "Invalid request");
+
+            return true;
+        }
+
+        const json_value& id_or_null = id != nullptr ? *id : null_id;
+
+        if (method->_string == "convert")
+        {
+            handle_convert(id_or_null, parsed->find("params"), target);
+            return true;
+        }
+
+        if (method->_string == "closeDocument")
+        {
+            handle_close_document(id_or_null, parsed->find("params"), target);
+            return true;
+        }
+
+        if (method->_string == "stats")
+        {
+            handle_stats(id_or_null, target);
+            return true;
+        }
+
+        if (method->_string == "shutdown")
+        {
+            append_response_header(target, id_or_null);
+            target.append(",\"result\":null}");
+            return false;
+        }
+
+        append_error_response(target, id_or_null, -32601, "Method not found");
+        return true;
+    }
+};
+
+conversion_daemon::conversion_daemon(std::ostream& log_stream)
+    : _impl{std::make_unique<impl>(log_stream)}
+{}
+
+conversion_daemon::~conversion_daemon() = default;
+
+bool conversion_daemon::load_prelude(const std::string_view js_source) noexcept
+{
+    _impl->_prelude.assign(js_source);
+    _impl->_spare.reset();
+
+    // Validate the prelude once up front
+    warm_converter wc;
+    wc._converter.set_file_cache(&_impl->_file_cache);
+
+    if (!wc._converter.evaluate(_impl->_prelude))
+    {
+        _impl->_log_stream << wc._diagnostics.str();
+        return false;
+    }
+
+    return true;
+}
+
+bool conversion_daemon::handle_request(
+    const std::string_view request, std::string& response) noexcept
+{
+    return _impl->handle_request(request, response);
+}
+
+void conversion_daemon::prepare() noexcept
+{
+    _impl->prepare();
+}
+
+bool conversion_daemon::serve(std::istream& is, std::ostream& os) noexcept
+{
+    std::string line;
+    std::string response;
+
+    prepare();
+
+    while (std::getline(is, line))
+    {
+        if (trim(line).empty())
+        {
+            continue;
+        }
+
+        response.clear();
+        const bool keep_going = handle_request(line, response);
+
+        if (!response.empty())
+        {
+            os << response << '\n';
+            os.flush();
+        }
+
+        if (!keep_going)
+        {
+            return true;
+        }
+
+        prepare();
+    }
+
+    return true;
+}
+
+bool conversion_daemon::serve_socket(const std::string_view socket_path) noexcept
+{
+    unix_socket listener = unix_socket::listen(socket_path, _impl->_log_stream);
+    if (!listener.is_valid())
+    {
+        return false;
+    }
+
+    std::string pending;
+    std::string response;
+    char chunk[4096];
+
+    prepare();
+
+    while (true)
+    {
+        unix_socket conn = listener.accept(_impl->_log_stream);
+        if (!conn.is_valid())
+        {
+            return false;
+        }
+
+        pending.clear();
+        bool connected = true;
+
+        while (connected)
+        {
+            const std::size_t n = conn.read_some(chunk, sizeof(chunk));
+            if (n == 0)
+            {
+                break;
+            }
+
+            pending.append(chunk, n);
+
+            std::size_t line_end;
+            while (connected &&
+                   (line_end = pending.find('\n')) != std::string::npos)
+            {
+                const std::string_view line =
+                    std::string_view{pending}.substr(0, line_end);
+
+                response.clear();
+                bool keep_going = true;
+
+                if (!trim(line).empty())
+                {
+                    keep_going = handle_request(line, response);
+                }
+
+                pending.erase(0, line_end + 1);
+
+                if (!response.empty())
+                {
+                    response.append(1, '\n');
+
+                    // The client is gone, along with its pending requests
+                    connected = conn.write_all(response);
+                }
+
+                if (!keep_going)
+                {
+                    return true;
+                }
+
+                prepare();
+            }
+        }
+    }
+}
+
+} // namespace majsdown
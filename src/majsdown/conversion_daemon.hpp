@@ -0,0 +1,58 @@
+#pragma once
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace majsdown {
+
+// Splits the converter's textual diagnostics into `{"line", "message"}`
+// objects, one per `((MJSD ERROR))(<line>): ` header, and appends them as a
+// JSON array.
+void append_diagnostics_json(std::string& output, const std::string_view text);
+
+// Long-lived conversion service speaking newline-delimited JSON-RPC 2.0.
+//
+// Every request is served by a pre-warmed `converter` (prelude already
+// evaluated) that is discarded afterwards, so documents never observe each
+// other's globals. A replacement is warmed up after the response is sent.
+// File contents and bytecode of included scripts are cached across requests.
+//
+// Supported methods:
+// - `convert`, params `{"source", "document"?}` (strings): returns
+//   `{"success", "output", "failedPass", "diagnostics": [{"line", "message"}]}`
+//   Requests naming a `document` share an `incremental_converter` instead,
+//   so that editing a document only re-executes what the edit affects.
+//   With `"html": true` the output is rendered to HTML (`"htmlOptions"` as
+//   on the command line), and with `"slides": true` it is rendered as a deck
+//   whose unchanged slides are served from a `slide_cache`. Rendering
+//   failures are reported as `"failedPass": 3`.
+// - `closeDocument`, params `{"document": string}`: drops its cached state
+// - `stats`: returns cache and request counters, and cache hit rates
+// - `shutdown`: stops serving after responding
+class conversion_daemon
+{
+private:
+    struct impl;
+    std::unique_ptr<impl> _impl;
+
+public:
+    [[nodiscard]] explicit conversion_daemon(std::ostream& log_stream);
+    ~conversion_daemon();
+
+    [[nodiscard]] bool load_prelude(const std::string_view js_source) noexcept;
+
+    // Appends the response to `response` (nothing for notifications). Returns
+    // `false` once a `shutdown` request has been handled.
+    [[nodiscard]] bool handle_request(
+        const std::string_view request, std::string& response) noexcept;
+
+    // Warms up the converter for the next request, call while idle.
+    void prepare() noexcept;
+
+    [[nodiscard]] bool serve(std::istream& is, std::ostream& os) noexcept;
+    [[nodiscard]] bool serve_socket(const std::string_view socket_path) noexcept;
+};
+
+} // namespace majsdown
@@ -1,43 +1,201 @@
 #include "converter.hpp"
 
 #include "js_interpreter.hpp"
+#include "majsdown/hash.hpp"
+#include "majsdown/html_renderer.hpp"
 #include "majsdown/js_interpreter.hpp"
+#include "majsdown/json.hpp"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <vector>
 
 #include <cassert>
 #include <cstddef>
 
 namespace majsdown {
 
+// ----------------------------------------------------------------------------
+
+// Where the value of a deferred `@@={...}` directive goes.
+struct pure_placement
+{
+    std::size_t _output_idx;
+    std::size_t _start_line;
+    std::size_t _end_line;
+};
+
 class converter::state
 {
+private:
+    // Created on first use, so that directive-free documents never pay for
+    // a JS runtime
+    std::optional<js_interpreter> _js_interpreter;
+    js_profile _js_profile = js_profile::full;
+    file_cache* _file_cache = nullptr;
+    result_cache* _memo_cache = nullptr;
+    std::vector<std::string>* _touched_files_sink = nullptr;
+    std::string _module_directory;
+    std::optional<determinism_config> _determinism;
+    bool* _nondeterminism_flag = nullptr;
+
 public:
     std::ostream& _err_stream;
-    js_interpreter _js_interpreter;
     std::ostringstream _js_interpreter_err_stream;
     std::string _tmp_buffer;
     std::string _js_buffer;
     std::size_t _js_buffer_start_line = 0;
+    std::size_t _first_emitted_at_sign = std::string::npos;
+    std::string* _statement_sink = nullptr;
+
+    // `@@={...}` directives deferred by the current pass
+    std::vector<std::string> _pure_sources;
+    std::vector<pure_placement> _pure_placements;
+    std::vector<std::optional<std::string>> _pure_results;
+    std::string _pure_tail;
 
-    explicit state(std::ostream& err_stream)
-        : _err_stream{err_stream}, _js_interpreter{_js_interpreter_err_stream}
+    converter::inline_expression_stats _inline_expression_stats;
+
+    explicit state(std::ostream& err_stream) : _err_stream{err_stream}
     {}
 
+    [[nodiscard]] bool has_js_interpreter() const noexcept
+    {
+        return _js_interpreter.has_value();
+    }
+
+    [[nodiscard]] js_interpreter& get_js_interpreter()
+    {
+        if (!_js_interpreter.has_value())
+        {
+            _js_interpreter.emplace(_js_interpreter_err_stream, _js_profile);
+            _js_interpreter->set_file_cache(_file_cache);
+            _js_interpreter->set_memo_cache(_memo_cache);
+            _js_interpreter->set_touched_files_sink(_touched_files_sink);
+            _js_interpreter->set_module_directory(_module_directory);
+            _js_interpreter->set_determinism(_determinism);
+            _js_interpreter->set_nondeterminism_flag(_nondeterminism_flag);
+        }
+
+        return *_js_interpreter;
+    }
+
+    [[nodiscard]] std::size_t get_current_diagnostics_line_adjustment() noexcept
+    {
+        return _js_interpreter.has_value()
+                   ? _js_interpreter->get_current_diagnostics_line_adjustment()
+                   : 0;
+    }
+
+    void set_file_cache(file_cache* cache) noexcept
+    {
+        _file_cache = cache;
+
+        if (_js_interpreter.has_value())
+        {
+            _js_interpreter->set_file_cache(cache);
+        }
+    }
+
+    void set_memo_cache(result_cache* cache) noexcept
+    {
+        _memo_cache = cache;
+
+        if (_js_interpreter.has_value())
+        {
+            _js_interpreter->set_memo_cache(cache);
+        }
+    }
+
+    void set_touched_files_sink(std::vector<std::string>* sink) noexcept
+    {
+        _touched_files_sink = sink;
+
+        if (_js_interpreter.has_value())
+        {
+            _js_interpreter->set_touched_files_sink(sink);
+        }
+    }
+
+    void set_module_directory(const std::string_view directory) noexcept
+    {
+        _module_directory = directory;
+
+        if (_js_interpreter.has_value())
+        {
+            _js_interpreter->set_module_directory(directory);
+        }
+    }
+
+    void set_determinism(
+        const std::optional<determinism_config>& config) noexcept
+    {
+        _determinism = config;
+
+        if (_js_interpreter.has_value())
+        {
+            _js_interpreter->set_determinism(config);
+        }
+    }
+
+    void set_nondeterminism_flag(bool* flag) noexcept
+    {
+        _nondeterminism_flag = flag;
+
+        if (_js_interpreter.has_value())
+        {
+            _js_interpreter->set_nondeterminism_flag(flag);
+        }
+    }
+
+    void set_js_profile(const js_profile profile) noexcept
+    {
+        _js_profile = profile;
+        _js_interpreter.reset();
+    }
+
+    // A fresh interpreter would be created by the next use anyway
+    void reset_js_interpreter() noexcept
+    {
+        if (_js_interpreter.has_value())
+        {
+            _js_interpreter->reset();
+        }
+    }
+
     void clear_buffers()
     {
         _tmp_buffer.clear();
         _js_buffer.clear();
+        _first_emitted_at_sign = std::string::npos;
+        _pure_sources.clear();
+        _pure_placements.clear();
     }
 };
 
 // ----------------------------------------------------------------------------
 
+// Program assembled by a compiling pass. Every directive becomes a statement
+// of a single global script, and the text between them an `__mjsd` call.
+struct template_builder
+{
+    std::string _program;
+
+    // Diagnostics line reported for each line of `_program`
+    std::vector<std::size_t> _line_map;
+};
+
+// ----------------------------------------------------------------------------
+
 class converter::pass
 {
 private:
@@ -46,10 +204,32 @@ private:
     const std::string_view _source;
     std::size_t _curr_idx;
     std::size_t _curr_line;
+    std::vector<segment>* _segments; // Only set when finding segments
+    const chunk_handler* _on_chunk;  // Only set when converting in chunks
+    std::size_t _min_chunk_size;
+    template_builder* _template;     // Only set when compiling a template
+    std::string* _template_text;     // Text not yet emitted to the template
 
-    [[nodiscard]] js_interpreter& get_js_interpreter() noexcept
+    [[nodiscard]] js_interpreter& get_js_interpreter()
     {
-        return _state._js_interpreter;
+        if (!_state.has_js_interpreter())
+        {
+            // Catch up with the line tracking skipped until now
+            _state.get_js_interpreter().set_current_diagnostics_line(
+                _curr_line);
+        }
+
+        return _state.get_js_interpreter();
+    }
+
+    // Line tracking is only needed once there is an interpreter to report to
+    void update_diagnostics_line()
+    {
+        if (_state.has_js_interpreter())
+        {
+            _state.get_js_interpreter().set_current_diagnostics_line(
+                _curr_line);
+        }
     }
 
     [[nodiscard]] std::string& get_tmp_buffer() noexcept
@@ -64,7 +244,7 @@ private:
 
     [[nodiscard]] std::size_t get_current_diagnostics_line_adjustment() noexcept
     {
-        return _state._js_interpreter.get_current_diagnostics_line_adjustment();
+        return _state.get_current_diagnostics_line_adjustment();
     }
 
     [[nodiscard]] std::size_t get_adjusted_curr_line() noexcept
@@ -185,9 +365,74 @@ private:
         return std::nullopt;
     }
 
+    [[nodiscard]] bool is_dry_run() const noexcept
+    {
+        return _segments != nullptr;
+    }
+
+    [[nodiscard]] bool is_compiling() const noexcept
+    {
+        return _template != nullptr;
+    }
+
+    // Appends the program text and records the diagnostics line reported
+    // for each of its lines.
+    void append_to_template(const std::string_view js,
+        const std::size_t first_line, const std::size_t line_step)
+    {
+        _template->_program.append(js);
+        _template->_program.append(1, '\n');
+
+        const auto n_lines =
+            static_cast<std::size_t>(std::count(js.begin(), js.end(), '\n')) +
+            1;
+
+        for (std::size_t i = 0; i < n_lines; ++i)
+        {
+            _template->_line_map.push_back(first_line + i * line_step);
+        }
+    }
+
+    void flush_template_text()
+    {
+        if (_template_text->empty())
+        {
+            return;
+        }
+
+        std::string& emit = get_tmp_buffer();
+        emit.clear();
+        emit.append("__mjsd(");
+        append_json_string(emit, *_template_text);
+        emit.append(");");
+
+        append_to_template(emit, _curr_line, 0);
+        _template_text->clear();
+    }
+
+    // Splices `js` into the template where it would have been interpreted.
+    // Lines of `js` are reported as `first_line`, advancing by `line_step`.
+    void emit_to_template(const std::string_view js,
+        const std::size_t first_line, const std::size_t line_step)
+    {
+        flush_template_text();
+
+        // Native functions report errors at the line the converter is at
+        std::string line_setter = "__mjsd_at(";
+        line_setter.append(std::to_string(_curr_line));
+        line_setter.append(");");
+
+        append_to_template(line_setter, _curr_line, 0);
+        append_to_template(js, first_line, line_step);
+    }
+
     [[nodiscard]] std::ostream& error_diagnostic_stream(std::size_t line)
     {
-        return _state._err_stream << "((MJSD ERROR))(" << line << "): ";
+        // Malformed sources are reported by the real conversion instead
+        static thread_local std::ostream null_stream{nullptr};
+
+        return (is_dry_run() ? null_stream : _state._err_stream)
+               << "((MJSD ERROR))(" << line << "): ";
     }
 
     void error_diagnostic_directive(
@@ -234,15 +479,141 @@ private:
         return true;
     }
 
-    [[nodiscard]] bool process_inline_expression(
-        std::string& output_buffer, const std::size_t js_start_idx)
+    // Outputs the value of an inline expression starting at `start_line`.
+    // Trivial expressions skip compilation, see
+    // `js_interpreter::interpret_trivial`.
+    [[nodiscard]] bool interpret_inline_expression(std::string& output_buffer,
+        const std::string_view expression, const std::size_t start_line)
+    {
+        const std::size_t output_begin = output_buffer.size();
+
+        converter::inline_expression_stats& stats =
+            _state._inline_expression_stats;
+
+        ++stats._n_evaluated;
+
+        std::optional<js_interpreter::error> res;
+        if (get_js_interpreter().interpret_trivial(
+                output_buffer, expression, res))
+        {
+            ++stats._n_trivial;
+        }
+        else
+        {
+            get_tmp_buffer().assign("__mjsd(");
+            get_tmp_buffer().append(expression);
+            get_tmp_buffer().append(");");
+
+            res = get_js_interpreter().interpret(
+                output_buffer, get_tmp_buffer() /* null-terminated JS */);
+        }
+
+        record_emitted_range(output_buffer, output_begin);
+
+        if (res.has_value())
+        {
+            const std::size_t computed_line = start_line + res->_line - 1;
+            const std::size_t final_line =
+                computed_line + 1 + get_current_diagnostics_line_adjustment();
+
+            error_diagnostic_stream(final_line)
+                << '\n'
+                << _state._js_interpreter_err_stream.str() << '\n';
+
+            // TODO: error case
+            return false;
+        }
+
+        return true;
+    }
+
+    // `@@={...}` directives promise not to modify the JS state, so their
+    // values are only computed before the next directive that runs JS, all
+    // at once and concurrently, then spliced in at their positions.
+    [[nodiscard]] bool flush_pure_expressions(std::string& output_buffer)
+    {
+        std::vector<std::string>& sources = _state._pure_sources;
+        if (sources.empty())
+        {
+            return true;
+        }
+
+        std::vector<std::optional<std::string>>& results =
+            _state._pure_results;
+
+        // A single expression is not worth a worker
+        if (sources.size() > 1)
+        {
+            get_js_interpreter().evaluate_pure(sources, results);
+        }
+        else
+        {
+            results.assign(1, std::nullopt);
+        }
+
+        const std::vector<pure_placement>& placements =
+            _state._pure_placements;
+
+        const std::size_t first_idx = placements.front()._output_idx;
+
+        std::string& tail = _state._pure_tail;
+        tail.assign(output_buffer, first_idx);
+        output_buffer.resize(first_idx);
+
+        std::size_t tail_idx = 0;
+        for (std::size_t i = 0; i < sources.size(); ++i)
+        {
+            const std::size_t idx = placements[i]._output_idx - first_idx;
+            output_buffer.append(tail, tail_idx, idx - tail_idx);
+            tail_idx = idx;
+
+            if (results[i].has_value())
+            {
+                output_buffer.append(*results[i]);
+                continue;
+            }
+
+            // Needs the interpreter itself, which is still in the same state
+            get_js_interpreter().set_current_diagnostics_line(
+                placements[i]._end_line);
+
+            if (!interpret_inline_expression(
+                    output_buffer, sources[i], placements[i]._start_line))
+            {
+                return false;
+            }
+        }
+
+        output_buffer.append(tail, tail_idx);
+        update_diagnostics_line();
+
+        // Text after the first deferred directive has moved
+        if (_state._first_emitted_at_sign != std::string::npos &&
+            _state._first_emitted_at_sign >= first_idx)
+        {
+            _state._first_emitted_at_sign = std::string::npos;
+        }
+
+        record_emitted_range(output_buffer, first_idx);
+
+        sources.clear();
+        _state._pure_placements.clear();
+
+        return true;
+    }
+
+    // Handles both `@@{...}` and, if `pure`, `@@={...}`.
+    [[nodiscard]] bool process_inline_expression(std::string& output_buffer,
+        const std::size_t js_start_idx, const bool pure)
     {
+        const std::string_view disambiguator = pure ? "={" : "{";
+
         const std::optional<find_result> js_end_idx_result =
             find_js_end_idx(js_start_idx);
 
         if (!js_end_idx_result.has_value())
         {
-            error_diagnostic_directive('{', "missing closing brace");
+            error_diagnostic_directive(disambiguator, "missing closing brace");
             return false;
         }
 
@@ -254,30 +625,54 @@ private:
 
         if (js_end_idx == js_start_idx)
         {
-            error_diagnostic_directive('{', "empty directive");
+            error_diagnostic_directive(disambiguator, "empty directive");
             return false;
         }
 
-        get_tmp_buffer().clear();
-        get_tmp_buffer().append("__mjsd(");
-        copy_range_to_tmp_buffer(js_start_idx, js_end_idx);
-        get_tmp_buffer().append(");");
+        if (is_dry_run())
+        {
+            _curr_idx = js_end_idx + 1 /* newline */;
+            return true;
+        }
 
-        const std::optional<js_interpreter::error> res =
-            get_js_interpreter().interpret(
-                output_buffer, get_tmp_buffer() /* null-terminated JS */);
+        if (pure && !is_compiling())
+        {
+            _state._pure_sources.emplace_back(
+                _source.substr(js_start_idx, js_end_idx - js_start_idx));
 
-        if (res.has_value())
+            _state._pure_placements.push_back(
+                pure_placement{._output_idx = output_buffer.size(),
+                    ._start_line = start_line,
+                    ._end_line = _curr_line});
+
+            _curr_idx = js_end_idx + 1 /* newline */;
+            return true;
+        }
+
+        if (!is_compiling() && !flush_pure_expressions(output_buffer))
         {
-            const std::size_t computed_line = start_line + res->_line - 1;
-            const std::size_t final_line =
-                computed_line + 1 + get_current_diagnostics_line_adjustment();
+            return false;
+        }
 
-            error_diagnostic_stream(final_line)
-                << '\n'
-                << _state._js_interpreter_err_stream.str() << '\n';
+        const std::string_view expression =
+            _source.substr(js_start_idx, js_end_idx - js_start_idx);
 
-            // TODO: error case
+        if (is_compiling())
+        {
+            get_tmp_buffer().clear();
+            get_tmp_buffer().append("__mjsd(");
+            copy_range_to_tmp_buffer(js_start_idx, js_end_idx);
+            get_tmp_buffer().append(");");
+
+            const std::string js = get_tmp_buffer();
+            emit_to_template(js, start_line + 1, 1);
+
+            _curr_idx = js_end_idx + 1 /* newline */;
+            return true;
+        }
+
+        if (!interpret_inline_expression(output_buffer, expression, start_line))
+        {
             return false;
         }
 
@@ -285,6 +680,70 @@ private:
         return true;
     }
 
+    // Copies file contents straight into the output, without involving JS.
+    // Index of the `>` closing the `@@<` directive whose spec starts at
+    // `spec_start_idx`, or `npos` if there is no non-empty spec followed by
+    // `>` on the same line.
+    [[nodiscard]] std::size_t find_splice_spec_end(
+        const std::size_t spec_start_idx) const noexcept
+    {
+        const std::size_t spec_end_idx =
+            _source.find_first_of(">\n", spec_start_idx);
+
+        if (spec_end_idx == std::string_view::npos ||
+            _source[spec_end_idx] != '>' || spec_end_idx == spec_start_idx)
+        {
+            return std::string_view::npos;
+        }
+
+        return spec_end_idx;
+    }
+
+    [[nodiscard]] bool process_splice_directive(
+        std::string& output_buffer, const std::size_t spec_start_idx)
+    {
+        const std::size_t spec_end_idx = find_splice_spec_end(spec_start_idx);
+        assert(spec_end_idx != std::string_view::npos);
+
+        const std::string_view spec =
+            _source.substr(spec_start_idx, spec_end_idx - spec_start_idx);
+
+        if (is_dry_run())
+        {
+            _curr_idx = spec_end_idx + 1;
+            return true;
+        }
+
+        if (is_compiling())
+        {
+            // Files are read when the template runs, not when it is compiled
+            std::string js = "__mjsd_splice(";
+            append_json_string(js, spec);
+            js.append(");");
+
+            emit_to_template(js, _curr_line, 0);
+
+            _curr_idx = spec_end_idx + 1;
+            return true;
+        }
+
+        const std::size_t output_begin = output_buffer.size();
+
+        const std::optional<std::string> error =
+            get_js_interpreter().splice(output_buffer, spec);
+
+        if (error.has_value())
+        {
+            error_diagnostic_directive('<', *error);
+            return false;
+        }
+
+        record_emitted_range(output_buffer, output_begin);
+
+        _curr_idx = spec_end_idx + 1;
+        return true;
+    }
+
     [[nodiscard]] bool process_block_statement(const std::size_t js_start_idx)
     {
         const std::optional<find_result> js_end_idx_result =
@@ -432,6 +891,17 @@ private:
 
         assert(code_end_idx.has_value());
 
+        if (is_dry_run())
+        {
+            _curr_idx = *code_end_idx + n_backticks + 1;
+            return true;
+        }
+
+        if (!is_compiling() && !flush_pure_expressions(output_buffer))
+        {
+            return false;
+        }
+
         const std::string_view extracted_code =
             _source.substr(code_start_idx, *code_end_idx - code_start_idx);
 
@@ -457,10 +927,27 @@ private:
         copy_range_to_tmp_buffer(real_js_start_idx, js_end_idx);
         get_tmp_buffer().append("); })()");
 
+        if (is_compiling())
+        {
+            get_tmp_buffer().append(";");
+
+            const std::string js = get_tmp_buffer();
+            emit_to_template(js, _curr_line, 0);
+
+            _curr_idx = *code_end_idx + n_backticks + 1;
+            return true;
+        }
+
         const std::string_view null_terminated_js = get_tmp_buffer();
-        if (get_js_interpreter()
-                .interpret(output_buffer, null_terminated_js)
-                .has_value())
+        const std::size_t output_begin = output_buffer.size();
+
+        const bool failed = get_js_interpreter()
+                                .interpret(output_buffer, null_terminated_js)
+                                .has_value();
+
+        record_emitted_range(output_buffer, output_begin);
+
+        if (failed)
         {
             error_diagnostic_stream(get_adjusted_curr_line())
                 << '\n'
@@ -473,36 +960,109 @@ private:
         return true;
     }
 
+    // Tracks the first `@` written to the output, so that the converter can
+    // tell whether a following pass would change anything.
+    void record_emitted_range(
+        const std::string& output_buffer, const std::size_t begin)
+    {
+        if (_state._first_emitted_at_sign == std::string::npos)
+        {
+            _state._first_emitted_at_sign = output_buffer.find('@', begin);
+        }
+    }
+
     void process_normal_character(std::string& output_buffer, const char c)
     {
         if (c == '\n')
         {
             increment_curr_line(1);
         }
+        else if (c == '@' &&
+                 _state._first_emitted_at_sign == std::string::npos)
+        {
+            _state._first_emitted_at_sign = output_buffer.size();
+        }
 
         output_buffer.append(1, c);
         step_fwd(1);
     }
 
-    [[nodiscard]] bool is_special_character(const char c)
+    // Copies the run of characters that cannot start a directive or an
+    // escape in one go, instead of one `process_normal_character` at a time.
+    void process_plain_run(std::string& output_buffer)
     {
-        return c == '$' || c == '{' || c == '_';
+        std::size_t run_end =
+            std::min(_source.find_first_of("@\\", _curr_idx), _source.size());
+
+        // Keep long runs from delaying the next chunk
+        if (_on_chunk != nullptr && run_end - _curr_idx > _min_chunk_size)
+        {
+            const std::size_t newline_idx =
+                _source.find('\n', _curr_idx + _min_chunk_size);
+
+            if (newline_idx != std::string_view::npos &&
+                newline_idx + 1 < run_end)
+            {
+                run_end = newline_idx + 1;
+            }
+        }
+
+        const std::string_view run =
+            _source.substr(_curr_idx, run_end - _curr_idx);
+
+        output_buffer.append(run);
+
+        const auto n_newlines =
+            static_cast<std::size_t>(std::count(run.begin(), run.end(), '\n'));
+
+        if (n_newlines > 0)
+        {
+            increment_curr_line(n_newlines);
+        }
+
+        _curr_idx = run_end;
+    }
+
+    [[nodiscard]] bool is_special_character(const char c)
+    {
+        return c == '$' || c == '{' || c == '_' || c == '<' || c == '=';
     }
 
     void increment_curr_line(const std::size_t n)
     {
         _curr_line += n;
-        get_js_interpreter().set_current_diagnostics_line(_curr_line);
+
+        if (!is_dry_run())
+        {
+            update_diagnostics_line();
+        }
     }
 
     void decrement_curr_line(const std::size_t n)
     {
         _curr_line -= n;
-        get_js_interpreter().set_current_diagnostics_line(_curr_line);
+        update_diagnostics_line();
     }
 
     [[nodiscard]] bool consume_js_statement_buffer()
     {
+        if (is_dry_run())
+        {
+            get_js_buffer().clear();
+            return true;
+        }
+
+        if (is_compiling())
+        {
+            // Statements end with a newline, terminate them on their own line
+            get_js_buffer().append(1, ';');
+            emit_to_template(
+                get_js_buffer(), _state._js_buffer_start_line + 1, 1);
+
+            get_js_buffer().clear();
+            return true;
+        }
+
         const std::optional<js_interpreter::error> res =
             get_js_interpreter().interpret_discard(get_js_buffer());
 
@@ -521,6 +1081,11 @@ private:
             return false;
         }
 
+        if (_state._statement_sink != nullptr)
+        {
+            _state._statement_sink->append(get_js_buffer());
+        }
+
         get_js_buffer().clear();
         return true;
     }
@@ -538,11 +1103,31 @@ private:
 
             if (!next_is_stmt && !get_js_buffer().empty())
             {
-                if (!consume_js_statement_buffer())
+                if (!flush_pure_expressions(output_buffer) ||
+                    !consume_js_statement_buffer())
                 {
                     return false;
                 }
             }
+
+            const bool at_line_start =
+                _curr_idx == 0 || _source[_curr_idx - 1] == '\n';
+
+            if (is_dry_run() && next_is_stmt && at_line_start &&
+                get_js_buffer().empty() && _curr_idx != 0)
+            {
+                _segments->push_back(
+                    segment{._begin = _curr_idx, ._line = _curr_line});
+            }
+        }
+
+        //
+        // Fast path for text without directives
+        // ----------------------------------------------------------------
+        if (c != '@' && c != '\\')
+        {
+            process_plain_run(output_buffer);
+            return true;
         }
 
         //
@@ -579,8 +1164,12 @@ private:
             return true;
         }
 
+        // Unlike the others, `@@=` and `@@<` are plain text unless complete
         const std::optional<char> next2 = peek(2);
-        if (!next2.has_value() || !is_special_character(*next2))
+        if (!next2.has_value() || !is_special_character(*next2) ||
+            (*next2 == '=' && peek(3) != '{') ||
+            (*next2 == '<' &&
+                find_splice_spec_end(_curr_idx + 3) == std::string_view::npos))
         {
             process_normal_character(output_buffer, c);
             return true;
@@ -635,7 +1224,39 @@ private:
                 return true;
             }
 
-            return process_inline_expression(output_buffer, js_start_idx);
+            return process_inline_expression(
+                output_buffer, js_start_idx, false);
+        }
+
+        //
+        // Process `@@={`
+        // ----------------------------------------------------------------
+        if (*next2 == '=')
+        {
+            if (_cfg.skip_inline_expressions)
+            {
+                process_normal_character(output_buffer, c);
+                return true;
+            }
+
+            assert(peek(3) == '{');
+
+            return process_inline_expression(
+                output_buffer, js_start_idx + 1, true);
+        }
+
+        //
+        // Process `@@<`
+        // ----------------------------------------------------------------
+        if (*next2 == '<')
+        {
+            if (_cfg.skip_splice_directives)
+            {
+                process_normal_character(output_buffer, c);
+                return true;
+            }
+
+            return process_splice_directive(output_buffer, js_start_idx);
         }
 
         //
@@ -672,24 +1293,61 @@ private:
 
 public:
     [[nodiscard]] explicit pass(state& state, const converter::config& cfg,
-        const std::string_view source)
-        : _state{state}, _cfg{cfg}, _source{source}, _curr_idx{0}, _curr_line{0}
+        const std::string_view source, const std::size_t start_line,
+        std::vector<segment>* segments,
+        const chunk_handler* on_chunk = nullptr,
+        const std::size_t min_chunk_size = 0,
+        template_builder* compile_target = nullptr)
+        : _state{state},
+          _cfg{cfg},
+          _source{source},
+          _curr_idx{0},
+          _curr_line{start_line},
+          _segments{segments},
+          _on_chunk{on_chunk},
+          _min_chunk_size{min_chunk_size},
+          _template{compile_target},
+          _template_text{nullptr}
     {
-        get_js_interpreter().set_current_diagnostics_line(_curr_line);
+        if (!is_dry_run())
+        {
+            update_diagnostics_line();
+        }
     }
 
     ~pass() = default;
 
     [[nodiscard]] bool convert(std::string& output_buffer) noexcept
     {
+        // Text is accumulated in the output, and emitted before each directive
+        _template_text = &output_buffer;
+
         while (!is_done())
         {
+            if (_on_chunk != nullptr &&
+                output_buffer.size() >= _min_chunk_size &&
+                _source[_curr_idx - 1] == '\n' && get_js_buffer().empty())
+            {
+                if (!flush_pure_expressions(output_buffer))
+                {
+                    return false;
+                }
+
+                (*_on_chunk)(output_buffer);
+                output_buffer.clear();
+            }
+
             if (!convert_step(output_buffer))
             {
                 return false;
             }
         }
 
+        if (!flush_pure_expressions(output_buffer))
+        {
+            return false;
+        }
+
         if (!get_js_buffer().empty())
         {
             if (!consume_js_statement_buffer())
@@ -698,6 +1356,11 @@ public:
             }
         }
 
+        if (is_compiling())
+        {
+            flush_template_text();
+        }
+
         return true;
     }
 };
@@ -712,9 +1375,476 @@ converter::~converter() = default;
 
 bool converter::convert(const config& cfg, std::string& output_buffer,
     const std::string_view source) noexcept
+{
+    return convert(cfg, output_buffer, source, 0);
+}
+
+bool converter::convert(const config& cfg, std::string& output_buffer,
+    const std::string_view source, const std::size_t start_line) noexcept
+{
+    _state->clear_buffers();
+    return pass{*_state, cfg, source, start_line, nullptr}.convert(
+        output_buffer);
+}
+
+bool converter::convert_chunked(const config& cfg,
+    const std::string_view source, const std::size_t min_chunk_size,
+    const chunk_handler& on_chunk) noexcept
 {
     _state->clear_buffers();
-    return pass{*_state, cfg, source}.convert(output_buffer);
+
+    std::string output_buffer;
+    output_buffer.reserve(min_chunk_size + 1024);
+
+    if (!pass{*_state, cfg, source, 0, nullptr, &on_chunk,
+            std::max(min_chunk_size, std::size_t{1})}
+            .convert(output_buffer))
+    {
+        return false;
+    }
+
+    if (!output_buffer.empty())
+    {
+        on_chunk(output_buffer);
+    }
+
+    return true;
+}
+
+bool converter::find_segments(const config& cfg,
+    const std::string_view source, std::vector<segment>& segments) noexcept
+{
+    _state->clear_buffers();
+    segments.push_back(segment{._begin = 0, ._line = 0});
+
+    std::string discarded_output;
+    return pass{*_state, cfg, source, 0, &segments}.convert(
+        discarded_output);
+}
+
+// Returns the index of the first `\@` escape or `@@$`, `@@{`, `@@_`, `@@<`,
+// `@@={` directive in `text`, looking at `@` signs from `from` onwards. A pass
+// over text before that index copies it unchanged.
+[[nodiscard]] static std::size_t find_first_sigil(
+    const std::string_view text, const std::size_t from) noexcept
+{
+    for (std::size_t i = text.find('@', from); i != std::string_view::npos;
+         i = text.find('@', i + 1))
+    {
+        if (i > 0 && text[i - 1] == '\\')
+        {
+            return i - 1;
+        }
+
+        if (i + 2 < text.size() && text[i + 1] == '@' &&
+            (text[i + 2] == '$' || text[i + 2] == '{' || text[i + 2] == '_' ||
+                text[i + 2] == '<' ||
+                (text[i + 2] == '=' && i + 3 < text.size() &&
+                    text[i + 3] == '{')))
+        {
+            return i;
+        }
+    }
+
+    return std::string_view::npos;
+}
+
+int converter::run_until_fixed_point(const std::span<const config> passes,
+    std::string& buffer, std::string& scratch_buffer,
+    const std::size_t max_passes, std::size_t* n_passes_run) noexcept
+{
+    assert(!passes.empty());
+
+    // Where to start looking for directives in the input of the next pass
+    std::size_t scan_from = 0;
+    std::size_t n_run = 0;
+
+    for (std::size_t i = 0; i < max_passes; ++i)
+    {
+        const std::size_t first_sigil = find_first_sigil(buffer, scan_from);
+
+        if (first_sigil == std::string_view::npos)
+        {
+            break; // Fixed point: every following pass would be a copy
+        }
+
+        // Lines before the first directive are copied as-is, and the pass
+        // resumes with the line numbering it would have had there
+        const std::size_t prefix_end =
+            first_sigil == 0 ? 0 : buffer.rfind('\n', first_sigil - 1) + 1;
+
+        const std::string_view prefix{buffer.data(), prefix_end};
+        const auto prefix_lines = static_cast<std::size_t>(
+            std::count(prefix.begin(), prefix.end(), '\n'));
+
+        scratch_buffer.clear();
+        scratch_buffer.reserve(buffer.size() + 1024);
+        scratch_buffer.append(prefix);
+
+        const config& cfg = passes[std::min(i, passes.size() - 1)];
+        const std::string_view rest =
+            std::string_view{buffer}.substr(prefix_end);
+
+        if (!convert(cfg, scratch_buffer, rest, prefix_lines))
+        {
+            if (n_passes_run != nullptr)
+            {
+                *n_passes_run = n_run + 1;
+            }
+
+            return static_cast<int>(i + 1);
+        }
+
+        ++n_run;
+
+        // Repeating the last pass without effect would loop forever on
+        // sigils it skips (e.g. escapes in the first pass)
+        const bool unchanged = i >= passes.size() && scratch_buffer == buffer;
+
+        buffer.swap(scratch_buffer);
+        scan_from = _state->_first_emitted_at_sign == std::string::npos
+                        ? buffer.size()
+                        : _state->_first_emitted_at_sign;
+
+        if (unchanged)
+        {
+            break;
+        }
+    }
+
+    if (n_passes_run != nullptr)
+    {
+        *n_passes_run = n_run;
+    }
+
+    return 0;
+}
+
+int converter::convert_all_passes(
+    std::string& buffer, std::string& scratch_buffer) noexcept
+{
+    static constexpr std::array passes{first_pass_config, second_pass_config};
+    return run_until_fixed_point(passes, buffer, scratch_buffer, passes.size());
+}
+
+std::string converter::compiled_template::serialize() const
+{
+    std::string result = std::to_string(_line_map.size());
+    result.append(1, '\n');
+
+    for (const std::size_t line : _line_map)
+    {
+        result.append(std::to_string(line));
+        result.append(1, '\n');
+    }
+
+    result.append(_bytecode);
+    return result;
+}
+
+[[nodiscard]] static std::optional<std::size_t> read_size_line(
+    const std::string_view data, std::size_t& idx)
+{
+    const std::size_t end = data.find('\n', idx);
+    if (end == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+
+    std::size_t result;
+    const auto [ptr, ec] =
+        std::from_chars(data.data() + idx, data.data() + end, result);
+
+    if (ec != std::errc{} || ptr != data.data() + end)
+    {
+        return std::nullopt;
+    }
+
+    idx = end + 1;
+    return result;
+}
+
+std::optional<converter::compiled_template>
+converter::compiled_template::deserialize(const std::string_view data)
+{
+    std::size_t idx = 0;
+
+    const std::optional<std::size_t> n_lines = read_size_line(data, idx);
+    if (!n_lines.has_value() || *n_lines > data.size())
+    {
+        return std::nullopt;
+    }
+
+    compiled_template result;
+    result._line_map.reserve(*n_lines);
+
+    for (std::size_t i = 0; i < *n_lines; ++i)
+    {
+        const std::optional<std::size_t> line = read_size_line(data, idx);
+        if (!line.has_value())
+        {
+            return std::nullopt;
+        }
+
+        result._line_map.push_back(*line);
+    }
+
+    result._bytecode.assign(data.substr(idx));
+    return result;
+}
+
+// Maps a 1-based line of a template's program back to the source.
+[[nodiscard]] static std::size_t map_template_line(
+    const converter::compiled_template& tmpl, const std::size_t program_line)
+{
+    if (program_line == 0 || tmpl._line_map.empty())
+    {
+        return 0;
+    }
+
+    return tmpl._line_map[std::min(program_line, tmpl._line_map.size()) - 1];
+}
+
+bool converter::compile_template(const config& cfg,
+    const std::string_view source, compiled_template& result) noexcept
+{
+    _state->clear_buffers();
+
+    template_builder builder;
+    std::string text_buffer;
+
+    if (!pass{*_state, cfg, source, 0, nullptr, nullptr, 0, &builder}.convert(
+            text_buffer))
+    {
+        return false;
+    }
+
+    // Syntax errors in any directive are caught here, before any output
+    const std::optional<js_interpreter::error> res =
+        _state->get_js_interpreter().compile(
+            builder._program /* null-terminated JS */, result._bytecode);
+
+    result._line_map = std::move(builder._line_map);
+
+    if (res.has_value())
+    {
+        _state->_err_stream << "((MJSD ERROR))("
+                            << map_template_line(result, res->_line) << "): \n"
+                            << _state->_js_interpreter_err_stream.str()
+                            << '\n';
+
+        return false;
+    }
+
+    return true;
+}
+
+bool converter::run_template(
+    const compiled_template& tmpl, std::string& output_buffer) noexcept
+{
+    _state->clear_buffers();
+
+    const std::size_t output_begin = output_buffer.size();
+
+    const std::optional<js_interpreter::error> res =
+        _state->get_js_interpreter().run_bytecode(
+            output_buffer, tmpl._bytecode);
+
+    if (_state->_first_emitted_at_sign == std::string::npos)
+    {
+        _state->_first_emitted_at_sign = output_buffer.find('@', output_begin);
+    }
+
+    if (res.has_value())
+    {
+        const std::size_t final_line =
+            map_template_line(tmpl, res->_line) +
+            _state->get_current_diagnostics_line_adjustment();
+
+        _state->_err_stream << "((MJSD ERROR))(" << final_line << "): \n"
+                            << _state->_js_interpreter_err_stream.str()
+                            << '\n';
+
+        return false;
+    }
+
+    return true;
+}
+
+int converter::convert_all_passes_compiled(const compiled_template& tmpl,
+    std::string& buffer, std::string& scratch_buffer) noexcept
+{
+    buffer.clear();
+
+    if (!run_template(tmpl, buffer))
+    {
+        return 1;
+    }
+
+    static constexpr std::array passes{second_pass_config};
+    const int res = run_until_fixed_point(passes, buffer, scratch_buffer, 1);
+
+    return res == 0 ? 0 : res + 1;
+}
+
+bool converter::render_html(std::string& buffer, std::string& scratch_buffer,
+    const html_config& cfg) noexcept
+{
+    scratch_buffer.clear();
+    scratch_buffer.reserve(buffer.size() * 2);
+
+    if (!majsdown::render_html(
+            buffer, scratch_buffer, cfg, _state->_err_stream))
+    {
+        return false;
+    }
+
+    buffer.swap(scratch_buffer);
+    return true;
+}
+
+bool converter::render_html_slides(std::string& buffer,
+    std::string& scratch_buffer, const html_config& cfg,
+    thread_pool& pool) noexcept
+{
+    scratch_buffer.clear();
+    scratch_buffer.reserve(buffer.size() * 2);
+
+    if (!majsdown::render_html_slides(
+            buffer, scratch_buffer, cfg, pool, _state->_err_stream))
+    {
+        return false;
+    }
+
+    buffer.swap(scratch_buffer);
+    return true;
+}
+
+bool converter::evaluate(const std::string_view js_source) noexcept
+{
+    _state->clear_buffers();
+
+    // The interpreter expects null-terminated JS
+    _state->_js_buffer.assign(js_source);
+
+    const std::optional<js_interpreter::error> res =
+        _state->get_js_interpreter().interpret_discard(_state->_js_buffer);
+
+    _state->_js_buffer.clear();
+
+    if (res.has_value())
+    {
+        _state->_err_stream << "((MJSD ERROR))(" << res->_line << "): \n"
+                            << _state->_js_interpreter_err_stream.str()
+                            << '\n';
+
+        return false;
+    }
+
+    return true;
+}
+
+bool converter::set_global_json(
+    const std::string_view name, const std::string_view json) noexcept
+{
+    _state->clear_buffers();
+
+    // The interpreter expects null-terminated strings
+    _state->_tmp_buffer.assign(name);
+    _state->_js_buffer.assign(json);
+
+    const std::optional<js_interpreter::error> res =
+        _state->get_js_interpreter().set_global_json(
+            _state->_tmp_buffer, _state->_js_buffer);
+
+    _state->clear_buffers();
+
+    if (res.has_value())
+    {
+        _state->_err_stream << "((MJSD ERROR))(?): Invalid JSON for '" << name
+                            << "'\n"
+                            << _state->_js_interpreter_err_stream.str()
+                            << '\n';
+
+        return false;
+    }
+
+    return true;
+}
+
+void converter::set_file_cache(file_cache* cache) noexcept
+{
+    _state->set_file_cache(cache);
+}
+
+void converter::set_memo_cache(result_cache* cache) noexcept
+{
+    _state->set_memo_cache(cache);
+}
+
+void converter::set_touched_files_sink(std::vector<std::string>* sink) noexcept
+{
+    _state->set_touched_files_sink(sink);
+}
+
+void converter::set_module_directory(
+    const std::string_view directory) noexcept
+{
+    _state->set_module_directory(directory);
+}
+
+void converter::set_determinism(
+    const std::optional<determinism_config>& config) noexcept
+{
+    _state->set_determinism(config);
+}
+
+void converter::set_nondeterminism_flag(bool* flag) noexcept
+{
+    _state->set_nondeterminism_flag(flag);
+}
+
+void converter::set_statement_sink(std::string* sink) noexcept
+{
+    _state->_statement_sink = sink;
+}
+
+void converter::reset() noexcept
+{
+    _state->clear_buffers();
+    _state->_js_interpreter_err_stream.str("");
+
+    _state->reset_js_interpreter();
+}
+
+void converter::warm_up() noexcept
+{
+    (void)_state->get_js_interpreter();
+}
+
+bool converter::has_js_interpreter() const noexcept
+{
+    return _state->has_js_interpreter();
+}
+
+converter::inline_expression_stats
+converter::get_inline_expression_stats() const noexcept
+{
+    return _state->_inline_expression_stats;
+}
+
+void converter::set_js_profile(const js_profile profile) noexcept
+{
+    // Drops the interpreter first, so that `reset` has none to recreate
+    _state->set_js_profile(profile);
+    reset();
+}
+
+std::uint64_t converter::get_execution_hash() const noexcept
+{
+    return _state->has_js_interpreter()
+               ? _state->get_js_interpreter().get_execution_hash()
+               : hash_seed;
 }
 
 } // namespace majsdown
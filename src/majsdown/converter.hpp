@@ -1,12 +1,26 @@
 #pragma once
 
+#include "majsdown/determinism.hpp"
+#include "majsdown/js_profile.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iosfwd>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace majsdown {
 
+class file_cache;
+class result_cache;
+class thread_pool;
+struct html_config;
+
 class converter
 {
 private:
@@ -23,13 +37,191 @@ public:
         bool skip_inline_statements = false;
         bool skip_block_statements = false;
         bool skip_code_block_decorators = false;
+        bool skip_splice_directives = false;
+    };
+
+    // Position where a conversion can be split: the interpreter is idle and a
+    // statement directive begins a new line.
+    struct segment
+    {
+        std::size_t _begin;
+        std::size_t _line;
+    };
+
+    // A document pass compiled into a single JS program, which can be run
+    // repeatedly without scanning the source again.
+    struct compiled_template
+    {
+        std::string _bytecode;
+
+        // 1-based source line reported for each line of the program
+        std::vector<std::size_t> _line_map;
+
+        // Flat representation, e.g. for on-disk caching.
+        [[nodiscard]] std::string serialize() const;
+
+        [[nodiscard]] static std::optional<compiled_template> deserialize(
+            const std::string_view data);
     };
 
+    // Inline expressions evaluated by the interpreter, e.g. for benchmarks.
+    struct inline_expression_stats
+    {
+        std::size_t _n_evaluated = 0;
+
+        // Evaluated without compiling, see `js_interpreter::interpret_trivial`
+        std::size_t _n_trivial = 0;
+    };
+
+    // Receives a finished piece of output, which it may move from.
+    using chunk_handler = std::function<void(std::string& chunk)>;
+
     [[nodiscard]] explicit converter(std::ostream& err_stream);
     ~converter();
 
     [[nodiscard]] bool convert(const config& cfg, std::string& output_buffer,
         const std::string_view source) noexcept;
+
+    // Converts a slice of a larger document, starting at line `start_line`.
+    [[nodiscard]] bool convert(const config& cfg, std::string& output_buffer,
+        const std::string_view source, const std::size_t start_line) noexcept;
+
+    // Like `convert`, but hands the output over to `on_chunk` as soon as at
+    // least `min_chunk_size` bytes are final. Chunks end at a line boundary
+    // of `source` where no directive is pending.
+    [[nodiscard]] bool convert_chunked(const config& cfg,
+        const std::string_view source, const std::size_t min_chunk_size,
+        const chunk_handler& on_chunk) noexcept;
+
+    // Scans `source` without evaluating any JS and appends the positions
+    // where it can be split. The first segment always begins at `0`. Returns
+    // `false` if the source is malformed.
+    [[nodiscard]] bool find_segments(const config& cfg,
+        const std::string_view source,
+        std::vector<segment>& segments) noexcept;
+
+    // Runs `passes` in order, each over the output of the previous one, then
+    // repeats the last one until the output stops changing, for at most
+    // `max_passes` passes overall. `buffer` holds the source on entry and the
+    // final output on exit. Returns `0` on success, otherwise the 1-based
+    // index of the failing pass.
+    //
+    // Passes only process the text from the line holding the first directive
+    // or escape onwards, and are skipped altogether once none is left, as
+    // they would copy their input unchanged.
+    [[nodiscard]] int run_until_fixed_point(std::span<const config> passes,
+        std::string& buffer, std::string& scratch_buffer,
+        const std::size_t max_passes,
+        std::size_t* n_passes_run = nullptr) noexcept;
+
+    // Runs the two standard passes used by `majsdown-converter`. `buffer`
+    // holds the source on entry and the final output on exit. Returns `0` on
+    // success, otherwise the 1-based index of the failing pass.
+    [[nodiscard]] int convert_all_passes(
+        std::string& buffer, std::string& scratch_buffer) noexcept;
+
+    // Compiles the directives of `source` and the text between them into a
+    // single JS program, without running it. Running the template appends
+    // what `convert` would have output. Returns `false` on malformed sources
+    // and JS syntax errors.
+    [[nodiscard]] bool compile_template(const config& cfg,
+        const std::string_view source, compiled_template& result) noexcept;
+
+    // Runs `tmpl`, possibly compiled by another converter. Errors are
+    // reported at the line of the directive that raised them.
+    [[nodiscard]] bool run_template(
+        const compiled_template& tmpl, std::string& output_buffer) noexcept;
+
+    // Like `convert_all_passes`, with a template compiled with
+    // `first_pass_config` standing in for the first pass. `buffer` only
+    // holds the final output on exit.
+    [[nodiscard]] int convert_all_passes_compiled(
+        const compiled_template& tmpl, std::string& buffer,
+        std::string& scratch_buffer) noexcept;
+
+    // Optional final stage: renders the Markdown in `buffer` to HTML in-place,
+    // using Discount. Returns `false` on failure.
+    [[nodiscard]] bool render_html(std::string& buffer,
+        std::string& scratch_buffer, const html_config& cfg) noexcept;
+
+    // Like `render_html`, but renders every `---`-separated slide separately
+    // and concurrently on `pool`. See `render_html_slides`.
+    [[nodiscard]] bool render_html_slides(std::string& buffer,
+        std::string& scratch_buffer, const html_config& cfg,
+        thread_pool& pool) noexcept;
+
+    // Evaluates plain JavaScript (e.g. a prelude) in the converter's
+    // interpreter, making its globals visible to subsequent conversions.
+    [[nodiscard]] bool evaluate(const std::string_view js_source) noexcept;
+
+    // Binds the JSON document `json` to the global `name`, e.g. to feed data
+    // to a template. Returns `false` if `json` is malformed.
+    [[nodiscard]] bool set_global_json(
+        const std::string_view name, const std::string_view json) noexcept;
+
+    // See `js_interpreter::set_file_cache`.
+    void set_file_cache(file_cache* cache) noexcept;
+
+    // See `js_interpreter::set_memo_cache`.
+    void set_memo_cache(result_cache* cache) noexcept;
+
+    // See `js_interpreter::set_touched_files_sink`.
+    void set_touched_files_sink(std::vector<std::string>* sink) noexcept;
+
+    // See `js_interpreter::set_module_directory`.
+    void set_module_directory(const std::string_view directory) noexcept;
+
+    // See `js_interpreter::set_determinism`.
+    void set_determinism(
+        const std::optional<determinism_config>& config) noexcept;
+
+    // See `js_interpreter::set_nondeterminism_flag`.
+    void set_nondeterminism_flag(bool* flag) noexcept;
+
+    // Appends the JS of every statement directive successfully executed to
+    // `sink`, which must outlive the conversions. Pass `nullptr` to stop.
+    void set_statement_sink(std::string* sink) noexcept;
+
+    // Discards all JS state, including a previously evaluated prelude.
+    void reset() noexcept;
+
+    // The interpreter is only created once some JS has to run, so converting
+    // directive-free documents does not pay for its startup. `warm_up`
+    // creates it right away, e.g. before forking.
+    void warm_up() noexcept;
+
+    [[nodiscard]] bool has_js_interpreter() const noexcept;
+
+    // Counts since construction.
+    [[nodiscard]] inline_expression_stats
+    get_inline_expression_stats() const noexcept;
+
+    // Selects the built-ins available to JS, see `js_profile`. Discards all
+    // JS state, like `reset`. Defaults to `js_profile::full`.
+    void set_js_profile(const js_profile profile) noexcept;
+
+    // See `js_interpreter::get_execution_hash`.
+    [[nodiscard]] std::uint64_t get_execution_hash() const noexcept;
+};
+
+// First pass: evaluate JS directives, leave escapes and decorators untouched.
+inline constexpr converter::config first_pass_config{
+    .skip_escaped_symbols = true,
+    .skip_inline_expressions = false,
+    .skip_inline_statements = false,
+    .skip_block_statements = false,
+    .skip_code_block_decorators = true,
+    .skip_splice_directives = false //
+};
+
+// Second pass: process everything, including escapes and decorators.
+inline constexpr converter::config second_pass_config{
+    .skip_escaped_symbols = false,
+    .skip_inline_expressions = false,
+    .skip_inline_statements = false,
+    .skip_block_statements = false,
+    .skip_code_block_decorators = false,
+    .skip_splice_directives = false //
 };
 
 } // namespace majsdown
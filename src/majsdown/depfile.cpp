@@ -0,0 +1,68 @@
+#include "depfile.hpp"
+
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace majsdown {
+
+static void append_escaped_path(
+    std::string& output, const std::string_view path)
+{
+    for (const char c : path)
+    {
+        if (c == ' ' || c == '#')
+        {
+            output.append(1, '\\');
+        }
+        else if (c == '$')
+        {
+            output.append(1, '$');
+        }
+
+        output.append(1, c);
+    }
+}
+
+std::string make_depfile(const std::string_view target,
+    const std::vector<std::string>& dependencies, const bool phony_targets)
+{
+    std::unordered_set<std::string_view> seen;
+    std::vector<std::string_view> unique_dependencies;
+
+    for (const std::string& dependency : dependencies)
+    {
+        if (seen.insert(dependency).second)
+        {
+            unique_dependencies.push_back(dependency);
+        }
+    }
+
+    std::string result;
+
+    append_escaped_path(result, target);
+    result.append(1, ':');
+
+    for (const std::string_view dependency : unique_dependencies)
+    {
+        result.append(" \\\n  ");
+        append_escaped_path(result, dependency);
+    }
+
+    result.append(1, '\n');
+
+    if (phony_targets)
+    {
+        for (const std::string_view dependency : unique_dependencies)
+        {
+            result.append(1, '\n');
+            append_escaped_path(result, dependency);
+            result.append(":\n");
+        }
+    }
+
+    return result;
+}
+
+} // namespace majsdown
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace majsdown {
+
+// Formats a Make rule stating that `target` depends on `dependencies`, in the
+// format produced by `gcc -MD` and understood by Make and Ninja. Duplicate
+// dependencies are dropped. With `phony_targets`, an empty rule is added for
+// every dependency (like `gcc -MP`), so that deleting one does not break Make.
+[[nodiscard]] std::string make_depfile(const std::string_view target,
+    const std::vector<std::string>& dependencies, const bool phony_targets);
+
+} // namespace majsdown
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace majsdown {
+
+// Fixed values standing in for the sources of nondeterminism available to
+// JS, the clock and `Math.random`, so that identical inputs always convert to
+// identical outputs.
+struct determinism_config
+{
+    // Milliseconds since the Unix epoch, returned by `Date.now()` and used by
+    // `new Date()`
+    std::int64_t _now_ms = 0;
+
+    // Seed of the `Math.random` sequence
+    std::uint64_t _random_seed = 0;
+};
+
+} // namespace majsdown
@@ -0,0 +1,130 @@
+#include "file_cache.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace majsdown {
+
+bool file_cache::get_stamp(const std::string& path, stamp& result) noexcept
+{
+    std::error_code ec;
+
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    result._mtime = static_cast<std::int64_t>(
+        mtime.time_since_epoch().count());
+    result._size = size;
+
+    return true;
+}
+
+file_cache::shared_buffer file_cache::read(const std::string_view path)
+{
+    std::string key{path};
+
+    stamp current;
+    if (!get_stamp(key, current))
+    {
+        return nullptr;
+    }
+
+    {
+        const std::lock_guard lock{_mutex};
+
+        const auto it = _entries.find(key);
+        if (it != _entries.end() && it->second._stamp == current)
+        {
+            ++_stats._hits;
+            return it->second._contents;
+        }
+
+        ++_stats._misses;
+    }
+
+    std::ifstream ifs(key, std::ios::binary);
+    if (!ifs)
+    {
+        return nullptr;
+    }
+
+    auto contents = std::make_shared<const std::string>(
+        std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{});
+
+    const std::lock_guard lock{_mutex};
+
+    _entries.insert_or_assign(std::move(key),
+        entry{._stamp = current,
+            ._contents = contents,
+            ._bytecode = nullptr,
+            ._module_bytecode = nullptr});
+
+    return contents;
+}
+
+file_cache::shared_buffer file_cache::find_bytecode(
+    const std::string_view path, const bytecode_kind kind)
+{
+    const std::string key{path};
+
+    stamp current;
+    if (!get_stamp(key, current))
+    {
+        return nullptr;
+    }
+
+    const std::lock_guard lock{_mutex};
+
+    const auto it = _entries.find(key);
+    if (it == _entries.end() || !(it->second._stamp == current) ||
+        it->second.bytecode_of(kind) == nullptr)
+    {
+        return nullptr;
+    }
+
+    ++_stats._hits;
+    return it->second.bytecode_of(kind);
+}
+
+void file_cache::store_bytecode(const std::string_view path,
+    const shared_buffer& contents, std::string bytecode,
+    const bytecode_kind kind)
+{
+    const std::lock_guard lock{_mutex};
+
+    const auto it = _entries.find(std::string{path});
+    if (it != _entries.end() && it->second._contents == contents)
+    {
+        it->second.bytecode_of(kind) =
+            std::make_shared<const std::string>(std::move(bytecode));
+    }
+}
+
+void file_cache::clear()
+{
+    const std::lock_guard lock{_mutex};
+    _entries.clear();
+}
+
+file_cache::stats file_cache::get_stats()
+{
+    const std::lock_guard lock{_mutex};
+    return _stats;
+}
+
+} // namespace majsdown
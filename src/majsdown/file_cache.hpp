@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace majsdown {
+
+// Thread-safe cache of file contents and of the bytecode compiled from them,
+// shared by long-lived interpreters. Entries are revalidated against the
+// file's modification time and size on every lookup.
+class file_cache
+{
+public:
+    using shared_buffer = std::shared_ptr<const std::string>;
+
+    // The same file can be both included as a script and imported as a
+    // module, which compile differently.
+    enum class bytecode_kind
+    {
+        script,
+        module
+    };
+
+    struct stats
+    {
+        std::size_t _hits;
+        std::size_t _misses;
+    };
+
+private:
+    struct stamp
+    {
+        std::int64_t _mtime;
+        std::uintmax_t _size;
+
+        [[nodiscard]] bool operator==(const stamp&) const = default;
+    };
+
+    struct entry
+    {
+        stamp _stamp;
+        shared_buffer _contents;
+        shared_buffer _bytecode;
+        shared_buffer _module_bytecode;
+
+        [[nodiscard]] shared_buffer& bytecode_of(
+            const bytecode_kind kind) noexcept
+        {
+            return kind == bytecode_kind::module ? _module_bytecode
+                                                 : _bytecode;
+        }
+    };
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, entry> _entries;
+    stats _stats{};
+
+    [[nodiscard]] static bool get_stamp(
+        const std::string& path, stamp& result) noexcept;
+
+public:
+    // Returns `nullptr` if the file cannot be read.
+    [[nodiscard]] shared_buffer read(const std::string_view path);
+
+    // Returns `nullptr` if no bytecode matches the current file contents.
+    [[nodiscard]] shared_buffer find_bytecode(const std::string_view path,
+        const bytecode_kind kind = bytecode_kind::script);
+
+    // Attaches `bytecode` to `path`, unless its `contents` were replaced
+    // meanwhile by a newer version of the file.
+    void store_bytecode(const std::string_view path,
+        const shared_buffer& contents, std::string bytecode,
+        const bytecode_kind kind = bytecode_kind::script);
+
+    void clear();
+
+    [[nodiscard]] stats get_stats();
+};
+
+} // namespace majsdown
@@ -0,0 +1,167 @@
+#include "fork_server.hpp"
+
+#include "majsdown/converter.hpp"
+#include "majsdown/unix_socket.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+namespace majsdown {
+
+[[nodiscard]] static std::ostream& error_diagnostic_stream(std::ostream& os)
+{
+    return os << "((MJSD ERROR))(SERVER): ";
+}
+
+struct fork_server::impl
+{
+    std::ostream& _log_stream;
+    std::ostringstream _diagnostics;
+    converter _converter;
+    std::string _buffer;
+    std::string _scratch_buffer;
+
+    [[nodiscard]] explicit impl(std::ostream& log_stream)
+        : _log_stream{log_stream}, _diagnostics{}, _converter{_diagnostics}
+    {}
+
+    // Runs in the forked child, never returns to the accept loop.
+    [[nodiscard]] int serve(unix_socket& conn) noexcept
+    {
+        if (!conn.read_message(_buffer))
+        {
+            return 1;
+        }
+
+        _diagnostics.str("");
+
+        const std::uint64_t status = static_cast<std::uint64_t>(
+            _converter.convert_all_passes(_buffer, _scratch_buffer));
+
+        const bool ok =
+            conn.write_all(
+                {reinterpret_cast<const char*>(&status), sizeof(status)}) &&
+            conn.write_message(_buffer) &&
+            conn.write_message(_diagnostics.str());
+
+        return ok ? 0 : 1;
+    }
+};
+
+fork_server::fork_server(std::ostream& log_stream)
+    : _impl{std::make_unique<impl>(log_stream)}
+{}
+
+fork_server::~fork_server() = default;
+
+bool fork_server::load_prelude(const std::string_view js_source) noexcept
+{
+    _impl->_diagnostics.str("");
+
+    if (!_impl->_converter.evaluate(js_source))
+    {
+        _impl->_log_stream << _impl->_diagnostics.str();
+        return false;
+    }
+
+    return true;
+}
+
+#if !defined(_WIN32)
+
+bool fork_server::run(const std::string_view socket_path) noexcept
+{
+    unix_socket listener = unix_socket::listen(socket_path, _impl->_log_stream);
+    if (!listener.is_valid())
+    {
+        return false;
+    }
+
+    // Children inherit the interpreter instead of each creating their own
+    _impl->_converter.warm_up();
+
+    // Children are never waited for, let the kernel reap them
+    ::signal(SIGCHLD, SIG_IGN);
+
+    // Anything buffered now would otherwise be flushed once per child
+    _impl->_log_stream.flush();
+
+    while (true)
+    {
+        unix_socket conn = listener.accept(_impl->_log_stream);
+        if (!conn.is_valid())
+        {
+            return false;
+        }
+
+        const pid_t pid = ::fork();
+
+        if (pid < 0)
+        {
+            error_diagnostic_stream(_impl->_log_stream)
+                << "Failed to fork (" << std::strerror(errno) << ")\n\n";
+
+            continue;
+        }
+
+        if (pid == 0)
+        {
+            listener.close();
+
+            // Skip destructors and `atexit` handlers inherited from the parent
+            ::_exit(_impl->serve(conn));
+        }
+    }
+}
+
+#else
+
+bool fork_server::run(const std::string_view) noexcept
+{
+    error_diagnostic_stream(_impl->_log_stream)
+        << "Fork server mode is not supported on this platform\n\n";
+
+    return false;
+}
+
+#endif
+
+bool request_fork_server_conversion(const std::string_view socket_path,
+    const std::string_view source, fork_server_response& response,
+    std::ostream& err_stream) noexcept
+{
+    unix_socket conn = unix_socket::connect(socket_path, err_stream);
+    if (!conn.is_valid())
+    {
+        return false;
+    }
+
+    std::uint64_t status;
+
+    if (!conn.write_message(source) ||
+        !conn.read_all(reinterpret_cast<char*>(&status), sizeof(status)) ||
+        !conn.read_message(response._output) ||
+        !conn.read_message(response._diagnostics))
+    {
+        error_diagnostic_stream(err_stream)
+            << "Connection to '" << socket_path << "' lost\n\n";
+
+        return false;
+    }
+
+    response._status = static_cast<int>(status);
+    return true;
+}
+
+} // namespace majsdown
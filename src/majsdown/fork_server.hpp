@@ -0,0 +1,41 @@
+#pragma once
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace majsdown {
+
+// Serves conversion requests over a Unix domain socket. The server owns a
+// single warmed-up `converter` (with its prelude already evaluated) and forks
+// one child per request, so that every conversion starts from the parent's
+// heap via copy-on-write instead of creating a fresh JS runtime.
+class fork_server
+{
+private:
+    struct impl;
+    std::unique_ptr<impl> _impl;
+
+public:
+    [[nodiscard]] explicit fork_server(std::ostream& log_stream);
+    ~fork_server();
+
+    [[nodiscard]] bool load_prelude(const std::string_view js_source) noexcept;
+
+    // Blocks serving requests, returns only on unrecoverable errors.
+    [[nodiscard]] bool run(const std::string_view socket_path) noexcept;
+};
+
+struct fork_server_response
+{
+    int _status; // `0` on success, otherwise the 1-based failing pass index
+    std::string _output;
+    std::string _diagnostics;
+};
+
+[[nodiscard]] bool request_fork_server_conversion(
+    const std::string_view socket_path, const std::string_view source,
+    fork_server_response& response, std::ostream& err_stream) noexcept;
+
+} // namespace majsdown
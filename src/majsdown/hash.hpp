@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string_view>
+
+#include <cstdint>
+
+namespace majsdown {
+
+// 64-bit FNV-1a, used to key caches. Not suitable for untrusted inputs that
+// could be crafted to collide.
+inline constexpr std::uint64_t hash_seed = 14695981039346656037ull;
+
+[[nodiscard]] inline constexpr std::uint64_t hash_bytes(
+    const std::string_view bytes, std::uint64_t seed = hash_seed) noexcept
+{
+    for (const char c : bytes)
+    {
+        seed ^= static_cast<unsigned char>(c);
+        seed *= 1099511628211ull;
+    }
+
+    return seed;
+}
+
+// Hashes `value` on top of `seed`, for composite keys.
+[[nodiscard]] inline constexpr std::uint64_t hash_combine(
+    std::uint64_t seed, const std::uint64_t value) noexcept
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        seed ^= (value >> (i * 8)) & 0xFFu;
+        seed *= 1099511628211ull;
+    }
+
+    return seed;
+}
+
+} // namespace majsdown
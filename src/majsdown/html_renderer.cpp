@@ -0,0 +1,274 @@
+#include "html_renderer.hpp"
+
+#include "majsdown/slide_cache.hpp"
+#include "majsdown/slides.hpp"
+#include "majsdown/thread_pool.hpp"
+
+extern "C" {
+#include <mkdio.h>
+}
+
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace majsdown {
+
+[[nodiscard]] static std::ostream& error_diagnostic_stream(std::ostream& os)
+{
+    return os << "((MJSD ERROR))(HTML): ";
+}
+
+struct mmiot_deleter
+{
+    void operator()(MMIOT* doc) const noexcept
+    {
+        mkd_cleanup(doc);
+    }
+};
+
+using mmiot_uptr = std::unique_ptr<MMIOT, mmiot_deleter>;
+
+bool parse_html_options(const std::string_view list, html_config& cfg) noexcept
+{
+    std::string_view remaining = list;
+
+    while (!remaining.empty())
+    {
+        const std::size_t comma = remaining.find(',');
+        std::string_view name = remaining.substr(0, comma);
+
+        remaining = comma == std::string_view::npos
+                        ? std::string_view{}
+                        : remaining.substr(comma + 1);
+
+        const bool value = !name.starts_with("no-");
+        if (!value)
+        {
+            name.remove_prefix(3);
+        }
+
+        bool* target = nullptr;
+
+        if (name == "fenced-code")
+        {
+            target = &cfg.fenced_code;
+        }
+        else if (name == "id-anchors")
+        {
+            target = &cfg.id_anchors;
+        }
+        else if (name == "github-tags")
+        {
+            target = &cfg.github_tags;
+        }
+        else if (name == "smartypants")
+        {
+            target = &cfg.smartypants;
+        }
+        else if (name == "tables")
+        {
+            target = &cfg.tables;
+        }
+        else if (name == "strikethrough")
+        {
+            target = &cfg.strikethrough;
+        }
+        else if (name == "footnotes")
+        {
+            target = &cfg.footnotes;
+        }
+        else if (name == "autolink")
+        {
+            target = &cfg.autolink;
+        }
+        else if (name == "safe-links")
+        {
+            target = &cfg.safe_links;
+        }
+        else if (name == "raw-html")
+        {
+            target = &cfg.raw_html;
+        }
+        else
+        {
+            return false;
+        }
+
+        *target = value;
+    }
+
+    return true;
+}
+
+unsigned int get_discount_flags(const html_config& cfg) noexcept
+{
+    mkd_flag_t flags = 0;
+
+    flags |= cfg.fenced_code ? MKD_FENCEDCODE : 0;
+    flags |= cfg.id_anchors ? MKD_IDANCHOR : 0;
+    flags |= cfg.github_tags ? MKD_GITHUBTAGS : 0;
+    flags |= cfg.smartypants ? 0 : MKD_NOPANTS;
+    flags |= cfg.tables ? 0 : MKD_NOTABLES;
+    flags |= cfg.strikethrough ? 0 : MKD_NOSTRIKETHROUGH;
+    flags |= cfg.footnotes ? MKD_EXTRA_FOOTNOTE : 0;
+    flags |= cfg.autolink ? MKD_AUTOLINK : 0;
+    flags |= cfg.safe_links ? MKD_SAFELINK : 0;
+    flags |= cfg.raw_html ? 0 : MKD_NOHTML;
+
+    return flags;
+}
+
+static void initialize_discount() noexcept
+{
+    // Discount lazily initializes global tables, which is not thread-safe.
+    // Everything else lives in the per-document `MMIOT`.
+    static std::once_flag initialized;
+    std::call_once(initialized, [] { mkd_initialize(); });
+}
+
+bool render_html(const std::string_view markdown, std::string& output,
+    const html_config& cfg, std::ostream& err_stream) noexcept
+{
+    initialize_discount();
+
+    if (markdown.size() > static_cast<std::size_t>(INT_MAX))
+    {
+        error_diagnostic_stream(err_stream) << "Document too large\n\n";
+        return false;
+    }
+
+    const mkd_flag_t flags = get_discount_flags(cfg);
+
+    const mmiot_uptr doc{mkd_string(
+        markdown.data(), static_cast<int>(markdown.size()), flags)};
+
+    if (doc == nullptr || !mkd_compile(doc.get(), flags))
+    {
+        error_diagnostic_stream(err_stream)
+            << "Failed to compile Markdown document\n\n";
+
+        return false;
+    }
+
+    char* html = nullptr;
+    const int html_size = mkd_document(doc.get(), &html);
+
+    if (html_size < 0)
+    {
+        error_diagnostic_stream(err_stream)
+            << "Failed to generate HTML document\n\n";
+
+        return false;
+    }
+
+    if (html_size > 0)
+    {
+        output.append(html, static_cast<std::size_t>(html_size));
+    }
+
+    return true;
+}
+
+bool render_html_slides(const std::string_view markdown, std::string& output,
+    const html_config& cfg, thread_pool& pool, std::ostream& err_stream,
+    slide_cache* cache) noexcept
+{
+    initialize_discount();
+
+    const slide_deck deck = split_slides(markdown);
+    const std::size_t n_slides = deck._slides.size();
+    const unsigned int flags = get_discount_flags(cfg);
+
+    std::vector<slide_cache::shared_html> rendered(n_slides);
+    std::vector<std::uint64_t> keys(n_slides);
+    std::vector<std::size_t> pending;
+
+    for (std::size_t i = 0; i < n_slides; ++i)
+    {
+        if (cache != nullptr)
+        {
+            keys[i] = slide_cache::compute_key(deck._slides[i], flags);
+            rendered[i] = cache->find(keys[i], deck._slides[i]);
+        }
+
+        if (rendered[i] == nullptr)
+        {
+            pending.push_back(i);
+        }
+    }
+
+    std::vector<std::string> errors(pending.size());
+
+    pool.parallel_for(pending.size(),
+        [&](const std::size_t j)
+        {
+            const std::size_t i = pending[j];
+
+            std::string html;
+            std::ostringstream slide_err_stream;
+
+            if (!render_html(deck._slides[i], html, cfg, slide_err_stream))
+            {
+                errors[j] = slide_err_stream.str();
+                return;
+            }
+
+            rendered[i] = std::make_shared<const std::string>(std::move(html));
+        });
+
+    bool success = true;
+    for (const std::string& error : errors)
+    {
+        if (!error.empty())
+        {
+            err_stream << error;
+            success = false;
+        }
+    }
+
+    if (cache != nullptr)
+    {
+        for (const std::size_t i : pending)
+        {
+            if (rendered[i] != nullptr)
+            {
+                cache->store(keys[i], deck._slides[i], rendered[i]);
+            }
+        }
+
+        cache->end_render();
+    }
+
+    if (!success)
+    {
+        return false;
+    }
+
+    std::size_t total_size = 0;
+    for (const slide_cache::shared_html& html : rendered)
+    {
+        total_size += html->size() + 32;
+    }
+
+    // Front matter configures the deck, it is not part of the HTML
+    output.reserve(output.size() + total_size);
+
+    for (const slide_cache::shared_html& html : rendered)
+    {
+        output.append("<section>\n");
+        output.append(*html);
+        output.append("\n</section>\n");
+    }
+
+    return true;
+}
+
+} // namespace majsdown
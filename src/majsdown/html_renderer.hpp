@@ -0,0 +1,50 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace majsdown {
+
+class slide_cache;
+class thread_pool;
+
+// Markdown extensions of the Discount library used to render HTML. Defaults
+// match the features enabled in `config.h.in`.
+struct html_config
+{
+    bool fenced_code = true;
+    bool id_anchors = true;
+    bool github_tags = true;
+    bool smartypants = true;
+    bool tables = true;
+    bool strikethrough = true;
+    bool footnotes = false;
+    bool autolink = false;
+    bool safe_links = false;
+    bool raw_html = true;
+};
+
+// Updates `cfg` from a comma-separated list of option names (e.g.
+// `footnotes,no-smartypants`). Returns `false` on unknown names.
+[[nodiscard]] bool parse_html_options(
+    const std::string_view list, html_config& cfg) noexcept;
+
+// Discount flags corresponding to `cfg`.
+[[nodiscard]] unsigned int get_discount_flags(const html_config& cfg) noexcept;
+
+// Renders `markdown` in-process with Discount, appending the HTML to
+// `output`. Thread-safe.
+[[nodiscard]] bool render_html(const std::string_view markdown,
+    std::string& output, const html_config& cfg,
+    std::ostream& err_stream) noexcept;
+
+// Renders a Reveal-style deck (see `split_slides`), rendering the slides
+// concurrently on `pool`. Each slide is wrapped in a `<section>` element, in
+// document order. Front matter is left out. If `cache` is not null,
+// only slides missing from it are rendered.
+[[nodiscard]] bool render_html_slides(const std::string_view markdown,
+    std::string& output, const html_config& cfg, thread_pool& pool,
+    std::ostream& err_stream, slide_cache* cache = nullptr) noexcept;
+
+} // namespace majsdown
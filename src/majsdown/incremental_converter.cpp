@@ -0,0 +1,406 @@
+#include "incremental_converter.hpp"
+
+#include "majsdown/converter.hpp"
+#include "majsdown/hash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace majsdown {
+
+struct file_stamp
+{
+    std::int64_t _mtime;
+    std::uintmax_t _size;
+
+    [[nodiscard]] bool operator==(const file_stamp&) const = default;
+};
+
+[[nodiscard]] static std::optional<file_stamp> get_file_stamp(
+    const std::string& path) noexcept
+{
+    std::error_code ec;
+
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+    {
+        return std::nullopt;
+    }
+
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec)
+    {
+        return std::nullopt;
+    }
+
+    return file_stamp{
+        ._mtime = static_cast<std::int64_t>(mtime.time_since_epoch().count()),
+        ._size = size};
+}
+
+struct segment_dependency
+{
+    std::string _path;
+    std::optional<file_stamp> _stamp;
+
+    [[nodiscard]] bool changed() const noexcept
+    {
+        return !_stamp.has_value() || get_file_stamp(_path) != _stamp;
+    }
+};
+
+struct cached_segment
+{
+    std::string _source;
+    std::string _output;                     // First pass output
+    std::optional<std::uint64_t> _state_key; // JS state before the segment
+    std::vector<segment_dependency> _dependencies;
+
+    [[nodiscard]] bool dependencies_changed() const noexcept
+    {
+        return std::any_of(_dependencies.begin(), _dependencies.end(),
+            [](const segment_dependency& d) { return d.changed(); });
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+class incremental_converter::impl
+{
+private:
+    std::ostream& _err_stream;
+    std::ostringstream _diagnostics;
+    converter _converter;
+    std::string _prelude;
+
+    // Current revision
+    std::string _source;
+    std::vector<converter::segment> _boundaries;
+
+    // Previous revision
+    std::vector<cached_segment> _segments;
+    std::optional<std::uint64_t> _final_state_key;
+
+    // Files read by the segments executed since the last fresh start, and
+    // whether any JS read the real clock or random numbers
+    std::uint64_t _files_key = hash_seed;
+    bool _nondeterministic = false;
+
+    std::vector<std::string> _touched_files;
+    stats _last_stats{};
+
+    [[nodiscard]] std::string_view segment_source(
+        const std::size_t i) const noexcept
+    {
+        const std::size_t begin = _boundaries[i]._begin;
+        const std::size_t end = i + 1 < _boundaries.size()
+                                    ? _boundaries[i + 1]._begin
+                                    : _source.size();
+
+        return std::string_view{_source}.substr(begin, end - begin);
+    }
+
+    // Two runs holding the same key hold the same JS state: they ran the
+    // same code over the same files, see `js_interpreter::get_execution_hash`.
+    [[nodiscard]] std::optional<std::uint64_t> current_state_key()
+        const noexcept
+    {
+        if (_nondeterministic)
+        {
+            return std::nullopt;
+        }
+
+        return hash_combine(_converter.get_execution_hash(), _files_key);
+    }
+
+    void discard_diagnostics()
+    {
+        _diagnostics.str("");
+        _diagnostics.clear();
+    }
+
+    void forward_diagnostics()
+    {
+        _err_stream << _diagnostics.str();
+        discard_diagnostics();
+    }
+
+    [[nodiscard]] bool start_fresh() noexcept
+    {
+        _converter.reset();
+        _files_key = hash_seed;
+        _nondeterministic = false;
+
+        return _prelude.empty() || _converter.evaluate(_prelude);
+    }
+
+    [[nodiscard]] std::size_t count_unchanged_trailing_segments() const noexcept
+    {
+        std::size_t n = 0;
+
+        while (n < _boundaries.size() && n < _segments.size())
+        {
+            const cached_segment& old = _segments[_segments.size() - 1 - n];
+
+            if (segment_source(_boundaries.size() - 1 - n) != old._source ||
+                old.dependencies_changed())
+            {
+                break;
+            }
+
+            ++n;
+        }
+
+        return n;
+    }
+
+    // Runs the first pass over segment `i`, appending its output to `buffer`
+    // and recording the files it read in `dependencies`.
+    [[nodiscard]] bool execute(const std::size_t i, std::string& buffer,
+        std::vector<segment_dependency>& dependencies) noexcept
+    {
+        _touched_files.clear();
+        _converter.set_touched_files_sink(&_touched_files);
+
+        const bool success = _converter.convert(first_pass_config, buffer,
+            segment_source(i), _boundaries[i]._line);
+
+        _converter.set_touched_files_sink(nullptr);
+
+        for (std::string& path : _touched_files)
+        {
+            const std::optional<file_stamp> stamp = get_file_stamp(path);
+
+            _files_key = hash_bytes(path, _files_key);
+            _files_key = hash_combine(_files_key,
+                stamp.has_value()
+                    ? hash_combine(static_cast<std::uint64_t>(stamp->_mtime),
+                          static_cast<std::uint64_t>(stamp->_size))
+                    : 0);
+
+            dependencies.push_back(
+                segment_dependency{._path = std::move(path), ._stamp = stamp});
+        }
+
+        return success;
+    }
+
+    [[nodiscard]] int run(
+        std::string& buffer, std::string& scratch_buffer) noexcept
+    {
+        const std::size_t n_new = _boundaries.size();
+        const std::size_t n_old = _segments.size();
+        const std::size_t n_unchanged_tail =
+            count_unchanged_trailing_segments();
+
+        _last_stats =
+            stats{._n_segments = n_new, ._n_executed = 0, ._n_reused = 0};
+
+        // Snapshots of JS state cannot be restored faithfully (e.g. closures),
+        // so the segments before an edit are executed again
+        if (!start_fresh())
+        {
+            return 1;
+        }
+
+        std::vector<cached_segment> segments;
+        segments.reserve(n_new);
+        scratch_buffer.clear();
+
+        // First segment whose output was reused rather than executed
+        std::size_t tail_begin = n_new;
+
+        for (std::size_t i = 0; i < n_new; ++i)
+        {
+            std::optional<std::uint64_t> state_key = current_state_key();
+
+            // An unchanged tail entered with the same state as before produces
+            // the same output, unless it read the clock or random numbers
+            if (n_new - i <= n_unchanged_tail && state_key.has_value() &&
+                _final_state_key.has_value() &&
+                state_key == _segments[i + n_old - n_new]._state_key)
+            {
+                for (std::size_t j = i + n_old - n_new; j < n_old; ++j)
+                {
+                    scratch_buffer.append(_segments[j]._output);
+                    segments.push_back(std::move(_segments[j]));
+                }
+
+                tail_begin = i;
+                break;
+            }
+
+            cached_segment segment{._source = std::string{segment_source(i)},
+                ._output = {},
+                ._state_key = state_key,
+                ._dependencies = {}};
+
+            const std::size_t output_begin = scratch_buffer.size();
+            if (!execute(i, scratch_buffer, segment._dependencies))
+            {
+                return 1;
+            }
+
+            segment._output.assign(scratch_buffer, output_begin);
+            segments.push_back(std::move(segment));
+            ++_last_stats._n_executed;
+        }
+
+        _segments = std::move(segments);
+
+        if (tail_begin == n_new)
+        {
+            _final_state_key = current_state_key();
+        }
+        else if (scratch_buffer.find("@@") != std::string::npos)
+        {
+            // The directives left for the second pass need the final state,
+            // which only executing the reused tail produces
+            std::string discarded_output;
+            std::vector<segment_dependency> discarded_dependencies;
+
+            for (std::size_t i = tail_begin; i < n_new; ++i)
+            {
+                if (!execute(i, discarded_output, discarded_dependencies))
+                {
+                    return 1;
+                }
+
+                ++_last_stats._n_executed;
+            }
+        }
+
+        _last_stats._n_reused = n_new - _last_stats._n_executed;
+
+        // `scratch_buffer` holds the output of the first pass
+        static constexpr std::array second_pass{second_pass_config};
+
+        if (_converter.run_until_fixed_point(
+                second_pass, scratch_buffer, buffer, 1) != 0)
+        {
+            return 2;
+        }
+
+        buffer.swap(scratch_buffer);
+        return 0;
+    }
+
+public:
+    [[nodiscard]] explicit impl(std::ostream& err_stream)
+        : _err_stream{err_stream}, _converter{_diagnostics}
+    {
+        _converter.set_nondeterminism_flag(&_nondeterministic);
+    }
+
+    [[nodiscard]] bool load_prelude(const std::string_view js_source) noexcept
+    {
+        _prelude.assign(js_source);
+        invalidate();
+
+        const bool success = start_fresh();
+        forward_diagnostics();
+
+        return success;
+    }
+
+    void set_file_cache(file_cache* cache) noexcept
+    {
+        _converter.set_file_cache(cache);
+    }
+
+    [[nodiscard]] int convert_all_passes(
+        std::string& buffer, std::string& scratch_buffer) noexcept
+    {
+        discard_diagnostics();
+
+        _source.assign(buffer);
+        _boundaries.clear();
+
+        if (!_converter.find_segments(first_pass_config, _source, _boundaries))
+        {
+            // Let a regular conversion report the malformed source
+            invalidate();
+            _last_stats =
+                stats{._n_segments = 1, ._n_executed = 1, ._n_reused = 0};
+
+            const int result =
+                start_fresh()
+                    ? _converter.convert_all_passes(buffer, scratch_buffer)
+                    : 1;
+
+            forward_diagnostics();
+            return result;
+        }
+
+        const int result = run(buffer, scratch_buffer);
+
+        if (result != 0)
+        {
+            invalidate();
+        }
+
+        forward_diagnostics();
+        return result;
+    }
+
+    [[nodiscard]] stats get_last_stats() const noexcept
+    {
+        return _last_stats;
+    }
+
+    void invalidate() noexcept
+    {
+        _segments.clear();
+        _final_state_key.reset();
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+incremental_converter::incremental_converter(std::ostream& err_stream)
+    : _impl{std::make_unique<impl>(err_stream)}
+{}
+
+incremental_converter::~incremental_converter() = default;
+
+bool incremental_converter::load_prelude(
+    const std::string_view js_source) noexcept
+{
+    return _impl->load_prelude(js_source);
+}
+
+void incremental_converter::set_file_cache(file_cache* cache) noexcept
+{
+    _impl->set_file_cache(cache);
+}
+
+int incremental_converter::convert_all_passes(
+    std::string& buffer, std::string& scratch_buffer) noexcept
+{
+    return _impl->convert_all_passes(buffer, scratch_buffer);
+}
+
+incremental_converter::stats incremental_converter::get_last_stats()
+    const noexcept
+{
+    return _impl->get_last_stats();
+}
+
+void incremental_converter::invalidate() noexcept
+{
+    _impl->invalidate();
+}
+
+} // namespace majsdown
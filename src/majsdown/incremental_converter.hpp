@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace majsdown {
+
+class file_cache;
+
+// Converts successive revisions of the same document, reusing the output of
+// what an edit cannot affect.
+//
+// The document is split into segments at top-level statement directives. JS
+// state cannot be restored faithfully, so every revision executes the
+// segments again from the start, but stops once it enters an unchanged tail
+// with the same state as the previous revision did: same code run and same
+// files read (see `js_interpreter::get_execution_hash`). The tail's output is
+// then reused, and the tail is only executed if the second pass needs the
+// final state. Segments that read files through `majsdown_include` or
+// `majsdown_embed` are re-executed when those files change, and tails that
+// read the real clock or random numbers are never reused.
+class incremental_converter
+{
+private:
+    class impl;
+    std::unique_ptr<impl> _impl;
+
+public:
+    struct stats
+    {
+        std::size_t _n_segments;
+        std::size_t _n_executed;
+        std::size_t _n_reused;
+    };
+
+    [[nodiscard]] explicit incremental_converter(std::ostream& err_stream);
+    ~incremental_converter();
+
+    // The prelude is re-evaluated whenever the JS state is rebuilt.
+    [[nodiscard]] bool load_prelude(const std::string_view js_source) noexcept;
+
+    // See `js_interpreter::set_file_cache`.
+    void set_file_cache(file_cache* cache) noexcept;
+
+    // Same contract as `converter::convert_all_passes`.
+    [[nodiscard]] int convert_all_passes(
+        std::string& buffer, std::string& scratch_buffer) noexcept;
+
+    // Segment counters of the last `convert_all_passes` call.
+    [[nodiscard]] stats get_last_stats() const noexcept;
+
+    // Forgets all cached segments, forcing the next conversion from scratch.
+    void invalidate() noexcept;
+};
+
+} // namespace majsdown
@@ -1,21 +1,52 @@
 #include "js_interpreter.hpp"
+#include "majsdown/base64.hpp"
+#include "majsdown/determinism.hpp"
+#include "majsdown/file_cache.hpp"
+#include "majsdown/hash.hpp"
 #include "majsdown/js_interpreter.hpp"
+#include "majsdown/js_profile.hpp"
+#include "majsdown/mapped_file.hpp"
+#include "majsdown/result_cache.hpp"
+#include "majsdown/snippet_cache.hpp"
+#include "majsdown/std_prelude.hpp"
+#include "majsdown/thread_pool.hpp"
 
 #include <quickjs-libc.h>
 #include <quickjs.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <random>
+#include <span>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <cassert>
 #include <cstdint>
 
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
 namespace majsdown {
 
 [[nodiscard]] static std::string*& get_tl_buffer_ptr() noexcept
@@ -116,276 +147,3072 @@ struct raii_js_value
 
 // ----------------------------------------------------------------------------
 
-static raii_js_value eval_impl(
-    JSContext* context, const std::string_view source) noexcept
+// Document parsed by `majsdown_json`, deep-frozen so it can be shared.
+struct json_cache_entry
 {
-    return raii_js_value{context, JS_Eval(context, source.data(), source.size(),
-                                      "<evalScript>", JS_EVAL_TYPE_GLOBAL)};
-}
+    mapped_file::stamp _stamp;
+    raii_js_value _value;
+};
 
-static void output_to_tl_buffer_pointee(JSContext* context, JSValueConst* argv)
+// Module compiled by `majsdown_import` or `import`, kept across resets.
+struct module_bytecode_entry
 {
-    const raii_js_value str_value{context, JS_ToString(context, argv[0])};
-    const char* string_arg{JS_ToCString(context, str_value._value)};
+    mapped_file::stamp _stamp;
+    std::string _bytecode;
+};
 
-    std::string* const buffer_ptr{get_tl_buffer_ptr()};
-    assert(buffer_ptr != nullptr);
-    buffer_ptr->append(string_arg);
+// Result of a native async operation, produced on the I/O pool.
+struct async_completion
+{
+    std::uint64_t _id;
+    bool _ok;
+    std::string _path;
+    std::string _value;
+};
+
+// Hands finished async operations over to the JS thread. Shared with the
+// operations in flight, which may outlive the interpreter.
+class async_completion_queue
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<async_completion> _completions;
+
+public:
+    void push(async_completion completion)
+    {
+        {
+            const std::lock_guard lock{_mutex};
+            _completions.push_back(std::move(completion));
+        }
+
+        _cv.notify_one();
+    }
+
+    [[nodiscard]] async_completion pop()
+    {
+        std::unique_lock lock{_mutex};
+        _cv.wait(lock, [&] { return !_completions.empty(); });
+
+        async_completion result = std::move(_completions.front());
+        _completions.pop_front();
+
+        return result;
+    }
+};
+
+// Per-interpreter state, reachable from native bindings via the context opaque.
+struct context_data
+{
+    js_profile _profile = js_profile::full;
+    file_cache* _file_cache = nullptr;
+    result_cache* _memo_cache = nullptr;
+    std::vector<std::string>* _touched_files = nullptr;
+    snippet_cache _snippets;
+    std::string _module_directory;
+    std::unordered_map<std::string, module_bytecode_entry> _module_bytecode;
+
+    // Absolute paths of the files included by the current context
+    std::unordered_set<std::string> _included_files;
+
+    // See `js_interpreter::set_determinism`
+    std::optional<determinism_config> _determinism;
+    std::uint64_t _random_state = 0;
+    bool* _nondeterminism_flag = nullptr;
+
+    // Set for the workers of `evaluate_pure`, which replay what the
+    // document's interpreter ran (`_replaying`) before evaluating expressions.
+    // Anything they cannot reproduce exactly sets `_diverged`.
+    bool _pure_worker = false;
+    bool _replaying = false;
+    bool _diverged = false;
+
+    std::shared_ptr<async_completion_queue> _async_operations =
+        std::make_shared<async_completion_queue>();
+    std::uint64_t _next_async_id = 0;
+
+    // JS values, owned by the current context
+    std::unordered_map<std::string, json_cache_entry> _json_cache;
+    std::optional<raii_js_value> _deep_freeze;
+    std::unordered_map<std::string, raii_js_value> _module_namespaces;
+    std::optional<raii_js_value> _async_helpers;
+
+    // Resolve and reject functions of the async operations in flight
+    std::unordered_map<std::uint64_t, std::array<raii_js_value, 2>>
+        _async_resolvers;
+
+    // Must be called before the context is freed.
+    void release_js_values() noexcept
+    {
+        _json_cache.clear();
+        _deep_freeze.reset();
+        _module_namespaces.clear();
+        _async_helpers.reset();
+        _async_resolvers.clear();
+    }
+};
+
+[[nodiscard]] static context_data& get_context_data(JSContext* context) noexcept
+{
+    void* const opaque = JS_GetContextOpaque(context);
+    assert(opaque != nullptr);
+
+    return *static_cast<context_data*>(opaque);
 }
 
-[[nodiscard]] static std::ostream& error_diagnostic_stream(const char* type)
+// ----------------------------------------------------------------------------
+
+// Globals provided by intrinsics that some profiles leave out. Names absent
+// from a context are defined as getters throwing a descriptive error, rather
+// than being silently undefined.
+static constexpr std::array optional_intrinsic_globals{"Date", "RegExp", "Map",
+    "Set", "WeakMap", "WeakSet", "WeakRef", "FinalizationRegistry",
+    "ArrayBuffer", "SharedArrayBuffer", "DataView", "Int8Array", "Uint8Array",
+    "Uint8ClampedArray", "Int16Array", "Uint16Array", "Int32Array",
+    "Uint32Array", "BigInt64Array", "BigUint64Array", "Float32Array",
+    "Float64Array", "Atomics", "Proxy", "Promise", "BigInt"};
+
+[[nodiscard]] static JSValue throw_missing_intrinsic(
+    JSContext* context, const char* name)
 {
-    return (*get_tl_err_stream()) << "((" << type << " ERROR)): ";
+    return JS_ThrowReferenceError(context,
+        "'%s' is not available with the '%s' JS profile", name,
+        to_string(get_context_data(context)._profile).data());
 }
 
-static void set_line_adjustment(JSContext* context, JSValueConst* argv)
+[[nodiscard]] static JSValue get_missing_intrinsic(JSContext* context,
+    JSValueConst this_val, int argc, JSValueConst* argv, int magic)
 {
-    std::int32_t out;
-    if (JS_ToInt32(context, &out, argv[0]) != 0)
+    (void)this_val;
+    (void)argc;
+    (void)argv;
+
+    return throw_missing_intrinsic(
+        context, optional_intrinsic_globals[static_cast<std::size_t>(magic)]);
+}
+
+[[nodiscard]] static JSContext* make_context(
+    JSRuntime* runtime, const js_profile profile) noexcept
+{
+    if (profile == js_profile::full)
     {
-        error_diagnostic_stream("INTERNAL")
-            << "Error in 'set_line_adjustment'\n\n";
+        return JS_NewContext(runtime);
+    }
 
-        return;
+    JSContext* const context = JS_NewContextRaw(runtime);
+    if (context == nullptr)
+    {
+        return nullptr;
     }
 
-    get_tl_diagnostics_line_adjustment() = out;
+    JS_AddIntrinsicBaseObjects(context);
+    JS_AddIntrinsicEval(context);
+    JS_AddIntrinsicJSON(context);
+
+    if (profile == js_profile::standard)
+    {
+        JS_AddIntrinsicDate(context);
+        JS_AddIntrinsicStringNormalize(context);
+        JS_AddIntrinsicRegExpCompiler(context);
+        JS_AddIntrinsicRegExp(context);
+        JS_AddIntrinsicMapSet(context);
+        JS_AddIntrinsicTypedArrays(context);
+    }
+
+    return context;
 }
 
-[[nodiscard]] static bool read_file_in_buffer(
-    const std::string_view path, std::string& buffer)
+static void define_missing_intrinsics(JSContext* context) noexcept
 {
-    const std::size_t diagnostic_line =
-        get_tl_diagnostics_line() + get_tl_diagnostics_line_adjustment();
+    const raii_js_value global_obj{context, JS_GetGlobalObject(context)};
 
-    std::ifstream ifs(path.data(), std::ios::binary | std::ios::ate);
-    if (!ifs)
+    for (std::size_t i = 0; i < optional_intrinsic_globals.size(); ++i)
     {
-        ::majsdown::error_diagnostic_stream("IO")
-            << "(" << diagnostic_line << ") Failed to open file '" << buffer
-            << "'\n\n";
+        const char* const name = optional_intrinsic_globals[i];
+        const JSAtom atom = JS_NewAtom(context, name);
+
+        if (JS_HasProperty(context, global_obj._value, atom) == 0)
+        {
+            // Configurable, so that documents can still provide their own
+            JS_DefinePropertyGetSet(context, global_obj._value, atom,
+                JS_NewCFunctionMagic(context, &get_missing_intrinsic, name, 0,
+                    JS_CFUNC_generic_magic, static_cast<int>(i)),
+                JS_UNDEFINED, JS_PROP_CONFIGURABLE);
+        }
+
+        JS_FreeAtom(context, atom);
+    }
+}
 
+// ----------------------------------------------------------------------------
+
+// Whether the global `name` is still the accessor standing in for a built-in
+// prelude export, i.e. was neither loaded nor redefined by the document.
+[[nodiscard]] static bool is_unloaded_std_prelude_export(
+    JSContext* context, JSValueConst global_obj, const char* name) noexcept
+{
+    const JSAtom atom = JS_NewAtom(context, name);
+
+    JSPropertyDescriptor desc;
+    const int found = JS_GetOwnProperty(context, &desc, global_obj, atom);
+
+    JS_FreeAtom(context, atom);
+
+    if (found <= 0)
+    {
         return false;
     }
 
-    const auto size = static_cast<std::streamsize>(ifs.tellg());
-    ifs.seekg(0, std::ios::beg);
+    JS_FreeValue(context, desc.value);
+    JS_FreeValue(context, desc.getter);
+    JS_FreeValue(context, desc.setter);
 
-    buffer.clear();
-    buffer.resize(size);
+    return (desc.flags & JS_PROP_GETSET) != 0;
+}
 
-    if (!ifs.read(buffer.data(), size))
+// Runs the built-in prelude and binds its exports still left unloaded.
+[[nodiscard]] static bool load_std_prelude(JSContext* context) noexcept
+{
+    const JSValue func = JS_ReadObject(context, std_prelude_bytecode.data(),
+        std_prelude_bytecode.size(), JS_READ_OBJ_BYTECODE);
+
+    if (JS_IsException(func))
     {
-        ::majsdown::error_diagnostic_stream("IO")
-            << "(" << diagnostic_line << ") Failed to read file '" << buffer
-            << "'\n\n";
+        return false;
+    }
 
+    // Takes ownership of `func`
+    const raii_js_value exports{context, JS_EvalFunction(context, func)};
+    if (JS_IsException(exports._value))
+    {
         return false;
     }
 
+    const raii_js_value global_obj{context, JS_GetGlobalObject(context)};
+
+    for (std::size_t i = 0; i < std_prelude_names.size(); ++i)
+    {
+        if (!is_unloaded_std_prelude_export(
+                context, global_obj._value, std_prelude_names[i]))
+        {
+            continue;
+        }
+
+        JS_DefinePropertyValueStr(context, global_obj._value,
+            std_prelude_names[i],
+            JS_GetPropertyStr(context, exports._value, std_prelude_names[i]),
+            JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE);
+    }
+
     return true;
 }
 
-static void include_file(JSContext* context, JSValueConst* argv)
+// First use of any export loads the whole prelude.
+[[nodiscard]] static JSValue get_std_prelude_export(JSContext* context,
+    JSValueConst this_val, int argc, JSValueConst* argv, int magic)
 {
-    const raii_js_value str_value{context, JS_ToString(context, argv[0])};
-    const char* string_arg{JS_ToCString(context, str_value._value)};
-
-    thread_local std::string tmp_buffer;
-
-    tmp_buffer.clear();
-    tmp_buffer.append(string_arg);
+    (void)this_val;
+    (void)argc;
+    (void)argv;
 
-    if (!read_file_in_buffer(tmp_buffer, tmp_buffer))
+    if (!load_std_prelude(context))
     {
-        return;
+        return JS_EXCEPTION;
     }
 
-    eval_impl(context, tmp_buffer);
+    const raii_js_value global_obj{context, JS_GetGlobalObject(context)};
+    return JS_GetPropertyStr(context, global_obj._value,
+        std_prelude_names[static_cast<std::size_t>(magic)]);
 }
 
-[[nodiscard]] static const char* embed_file(
-    JSContext* context, JSValueConst* argv)
+// Assigning an export (e.g. `var Base64 = ...`) redefines it without loading
+// the prelude.
+[[nodiscard]] static JSValue set_std_prelude_export(JSContext* context,
+    JSValueConst this_val, int argc, JSValueConst* argv, int magic)
 {
-    const raii_js_value str_value{context, JS_ToString(context, argv[0])};
-    const char* string_arg{JS_ToCString(context, str_value._value)};
+    (void)this_val;
 
-    thread_local std::string tmp_buffer;
+    const raii_js_value global_obj{context, JS_GetGlobalObject(context)};
+    JS_DefinePropertyValueStr(context, global_obj._value,
+        std_prelude_names[static_cast<std::size_t>(magic)],
+        argc > 0 ? JS_DupValue(context, argv[0]) : JS_UNDEFINED,
+        JS_PROP_CONFIGURABLE | JS_PROP_WRITABLE | JS_PROP_ENUMERABLE);
 
-    tmp_buffer.clear();
-    tmp_buffer.append(string_arg);
+    return JS_UNDEFINED;
+}
+
+static void define_std_prelude_exports(JSContext* context) noexcept
+{
+    const raii_js_value global_obj{context, JS_GetGlobalObject(context)};
 
-    if (!read_file_in_buffer(tmp_buffer, tmp_buffer))
+    for (std::size_t i = 0; i < std_prelude_names.size(); ++i)
     {
-        return "((MJSD ERROR)): Failure reading file to be embedded";
-    }
+        const char* const name = std_prelude_names[i];
+        const JSAtom atom = JS_NewAtom(context, name);
 
-    return tmp_buffer.data();
+        JS_DefinePropertyGetSet(context, global_obj._value, atom,
+            JS_NewCFunctionMagic(context, &get_std_prelude_export, name, 0,
+                JS_CFUNC_generic_magic, static_cast<int>(i)),
+            JS_NewCFunctionMagic(context, &set_std_prelude_export, name, 1,
+                JS_CFUNC_generic_magic, static_cast<int>(i)),
+            JS_PROP_CONFIGURABLE);
+
+        JS_FreeAtom(context, atom);
+    }
 }
 
 // ----------------------------------------------------------------------------
 
-struct js_interpreter::impl
-{
-private:
-    tl_guard<&get_tl_err_stream> _err_stream_tl_guard;
-    js_runtime_uptr _runtime;
-    js_context_uptr _context;
-    std::size_t _curr_diagnostics_line;
+// The clock and `Math.random` are replaced by natives which either follow
+// `context_data::_determinism` or record their use, so that results depending
+// on them are never cached.
 
-    template <auto FPtr>
-    void bind_function(const std::string_view name, const int n_args) noexcept
+static void record_nondeterminism(context_data& data) noexcept
+{
+    if (data._nondeterminism_flag != nullptr)
     {
-        auto func = [](JSContext* context, JSValueConst this_val, int argc,
-                        JSValueConst* argv) -> JSValue
-        {
-            (void)this_val;
-            (void)argc;
+        *data._nondeterminism_flag = true;
+    }
+}
 
-            if constexpr (std::is_void_v<decltype(FPtr(context, argv))>)
-            {
-                FPtr(context, argv);
-                return JS_UNDEFINED;
-            }
-            else
-            {
-                // TODO: does this need to be freed as well?
-                return JS_NewString(context, FPtr(context, argv));
-            }
-        };
+// Fails a worker of `evaluate_pure` on what it cannot reproduce, handing the
+// expression over to the document's interpreter.
+[[nodiscard]] static JSValue throw_unavailable_on_pure_worker(
+    JSContext* context, const char* name) noexcept
+{
+    get_context_data(context)._diverged = true;
+    return JS_ThrowInternalError(context, "%s is not available here", name);
+}
 
-        JSContext* ctx = _context.get();
+// Workers of `evaluate_pure` only reproduce the clock and `Math.random` while
+// replaying, and in deterministic mode. Expressions evaluated concurrently
+// cannot consume the random sequence in order.
+[[nodiscard]] static bool is_entropy_unavailable(
+    const context_data& data) noexcept
+{
+    return data._pure_worker &&
+           !(data._replaying && data._determinism.has_value());
+}
 
-        const raii_js_value global_obj{ctx, JS_GetGlobalObject(ctx)};
+// `Date.now()`
+[[nodiscard]] static JSValue read_clock(JSContext* context,
+    JSValueConst this_val, int argc, JSValueConst* argv) noexcept
+{
+    (void)this_val;
+    (void)argc;
+    (void)argv;
 
-        const JSValue js_func =
-            JS_NewCFunction(ctx, +func, name.data(), n_args);
+    context_data& data = get_context_data(context);
 
-        JS_SetPropertyStr(ctx, global_obj._value, name.data(), js_func);
+    if (is_entropy_unavailable(data))
+    {
+        return throw_unavailable_on_pure_worker(context, "The clock");
     }
 
-    [[nodiscard]] std::optional<error> check_js_errors(const JSValue& js_value)
+    if (data._determinism.has_value())
     {
-        JSContext* ctx = _context.get();
-
-        if (JS_IsException(js_value) || JS_IsError(ctx, js_value))
-        {
-            const raii_js_value js_exception{ctx, JS_GetException(ctx)};
+        return JS_NewInt64(context, data._determinism->_now_ms);
+    }
 
-            const raii_js_value js_stack_trace{
-                ctx, JS_GetPropertyStr(ctx, js_exception._value, "stack")};
+    record_nondeterminism(data);
 
-            const std::string_view js_stack_trace_sv =
-                JS_ToCString(ctx, js_stack_trace._value);
+    return JS_NewInt64(context,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+}
 
-            const auto js_stack_trace_line_num =
-                [&]() -> std::optional<std::size_t>
-            {
-                using namespace std::string_view_literals;
+// SplitMix64, fully specified so that seeded sequences are portable
+[[nodiscard]] static std::uint64_t next_random(std::uint64_t& state) noexcept
+{
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
 
-                const auto needle = "(<evalScript>:"sv;
-                const auto n_begin = js_stack_trace_sv.find(needle);
+// `Math.random()`
+[[nodiscard]] static JSValue random_number(JSContext* context,
+    JSValueConst this_val, int argc, JSValueConst* argv) noexcept
+{
+    (void)this_val;
+    (void)argc;
+    (void)argv;
 
-                if (n_begin == std::string_view::npos)
-                {
-                    return std::nullopt;
-                }
+    context_data& data = get_context_data(context);
 
-                const auto n_end = js_stack_trace_sv.find(")", n_begin);
+    if (is_entropy_unavailable(data))
+    {
+        return throw_unavailable_on_pure_worker(context, "Math.random");
+    }
 
-                if (n_end == std::string_view::npos)
-                {
-                    return std::nullopt;
-                }
+    std::uint64_t bits;
 
-                const auto extr_begin = n_begin + needle.size();
-                const auto extr_len = n_end - extr_begin;
+    if (data._determinism.has_value())
+    {
+        bits = next_random(data._random_state);
+    }
+    else
+    {
+        record_nondeterminism(data);
 
-                const std::string_view extr =
-                    js_stack_trace_sv.substr(extr_begin, extr_len);
+        thread_local std::mt19937_64 engine{std::random_device{}()};
+        bits = engine();
+    }
 
-                return std::stoi(std::string(extr));
-            }();
+    // Uniform in [0, 1), with all 53 bits of precision
+    return JS_NewFloat64(context, static_cast<double>(bits >> 11) * 0x1.0p-53);
+}
 
-            // TODO: deal with number extraction for nicer diagnostics
-            error_diagnostic_stream("JS")
-                << JS_ToCString(ctx, js_exception._value) << "\n\n"
-                << js_stack_trace_sv << "\n\n"
-                << "Interpreter line: '" << js_stack_trace_line_num.value_or(1) << "'\n";
+// Evaluates to a function replacing `Date` by a wrapper reading the current
+// time from `now`. Dates built from explicit values are unaffected.
+static constexpr std::string_view date_hook_source = R"((now) => {
+    const RealDate = globalThis.Date;
 
-            return error{._line = js_stack_trace_line_num.value_or(1)};
+    function Date(...args) {
+        if (new.target === undefined) {
+            return new RealDate(now()).toString();
         }
 
-        return std::nullopt;
+        return Reflect.construct(
+            RealDate, args.length === 0 ? [now()] : args, new.target);
     }
 
-public:
-    [[nodiscard]] explicit impl(std::ostream& err_stream) noexcept
-        : _err_stream_tl_guard{&err_stream},
-          _runtime{JS_NewRuntime()},
-          _context{JS_NewContext(_runtime.get())},
-          _curr_diagnostics_line{0}
-    {
-        bind_function<&output_to_tl_buffer_pointee>("__mjsd", 1);
-        bind_function<&set_line_adjustment>("__mjsd_line", 1);
-        bind_function<&include_file>("majsdown_include", 1);
-        bind_function<&embed_file>("majsdown_embed", 1);
-    }
+    Date.prototype = RealDate.prototype;
+    Date.now = now;
+    Date.parse = RealDate.parse;
+    Date.UTC = RealDate.UTC;
 
-    [[nodiscard]] std::optional<error> interpret(
-        std::string& output_buffer, const std::string_view source) noexcept
-    {
-        tl_guard<&get_tl_buffer_ptr> buffer_ptr_guard{&output_buffer};
-        return check_js_errors(eval_impl(_context.get(), source)._value);
-    }
+    Object.defineProperty(RealDate.prototype, 'constructor',
+        { value: Date, writable: true, configurable: true });
 
-    [[nodiscard]] std::optional<error> interpret_discard(
-        const std::string_view source) noexcept
-    {
-        return check_js_errors(eval_impl(_context.get(), source)._value);
-    }
+    Object.defineProperty(globalThis, 'Date',
+        { value: Date, writable: true, configurable: true });
+})";
 
-    void set_current_diagnostics_line(const std::size_t line) noexcept
-    {
-        get_tl_diagnostics_line() = _curr_diagnostics_line = line;
-    }
+// The context's opaque must be a `context_data`.
+static void install_entropy_hooks(
+    JSContext* context, const bool has_date) noexcept
+{
+    const raii_js_value global_obj{context, JS_GetGlobalObject(context)};
+    const raii_js_value math{
+        context, JS_GetPropertyStr(context, global_obj._value, "Math")};
 
-    [[nodiscard]] std::size_t get_current_diagnostics_line_adjustment() noexcept
+    JS_SetPropertyStr(context, math._value, "random",
+        JS_NewCFunction(context, &random_number, "random", 0));
+
+    if (!has_date)
     {
-        return get_tl_diagnostics_line_adjustment();
+        return;
     }
-};
 
-// ----------------------------------------------------------------------------
+    const raii_js_value hook{context,
+        JS_Eval(context, date_hook_source.data(), date_hook_source.size(),
+            "<date>", JS_EVAL_TYPE_GLOBAL)};
 
-js_interpreter::js_interpreter(std::ostream& err_stream)
-    : _impl{std::make_unique<impl>(err_stream)}
-{}
+    raii_js_value now{
+        context, JS_NewCFunction(context, &read_clock, "now", 0)};
 
-js_interpreter::~js_interpreter() = default;
+    const raii_js_value result{context,
+        JS_IsException(hook._value)
+            ? JS_EXCEPTION
+            : JS_Call(context, hook._value, JS_UNDEFINED, 1, &now._value)};
 
-std::optional<js_interpreter::error> js_interpreter::interpret(
-    std::string& output_buffer, const std::string_view source) noexcept
+    assert(!JS_IsException(result._value));
+}
+
+// ----------------------------------------------------------------------------
+
+static raii_js_value eval_impl(
+    JSContext* context, const std::string_view source) noexcept
 {
-    return _impl->interpret(output_buffer, source);
+    return raii_js_value{context, JS_Eval(context, source.data(), source.size(),
+                                      "<evalScript>", JS_EVAL_TYPE_GLOBAL)};
 }
 
-std::optional<js_interpreter::error> js_interpreter::interpret_discard(
-    const std::string_view source) noexcept
+[[nodiscard]] static std::ostream& error_diagnostic_stream(const char* type)
 {
-    return _impl->interpret_discard(source);
+    return (*get_tl_err_stream()) << "((" << type << " ERROR)): ";
 }
 
-void js_interpreter::set_current_diagnostics_line(
-    const std::size_t line) noexcept
+static void set_line_adjustment(JSContext* context, JSValueConst* argv)
 {
-    _impl->set_current_diagnostics_line(line);
+    std::int32_t out;
+    if (JS_ToInt32(context, &out, argv[0]) != 0)
+    {
+        error_diagnostic_stream("INTERNAL")
+            << "Error in 'set_line_adjustment'\n\n";
+
+        return;
+    }
+
+    get_tl_diagnostics_line_adjustment() = out;
 }
 
-[[nodiscard]] std::size_t
-js_interpreter::get_current_diagnostics_line_adjustment() noexcept
+// Called by compiled templates before each directive, standing in for the
+// converter's own line tracking.
+static void set_current_line(JSContext* context, JSValueConst* argv)
 {
-    return _impl->get_current_diagnostics_line_adjustment();
+    std::int32_t out;
+    if (JS_ToInt32(context, &out, argv[0]) != 0)
+    {
+        error_diagnostic_stream("INTERNAL")
+            << "Error in 'set_current_line'\n\n";
+
+        return;
+    }
+
+    get_tl_diagnostics_line() = out;
+}
+
+[[nodiscard]] static std::size_t get_diagnostic_line() noexcept
+{
+    return get_tl_diagnostics_line() + get_tl_diagnostics_line_adjustment();
+}
+
+static void record_touched_file(JSContext* context, const std::string_view path)
+{
+    if (std::vector<std::string>* const sink =
+            get_context_data(context)._touched_files;
+        sink != nullptr)
+    {
+        sink->emplace_back(path);
+    }
+}
+
+[[nodiscard]] static bool read_file_in_buffer(
+    JSContext* context, const std::string_view path, std::string& buffer)
+{
+    record_touched_file(context, path);
+
+    if (file_cache* const cache = get_context_data(context)._file_cache;
+        cache != nullptr)
+    {
+        const file_cache::shared_buffer contents = cache->read(path);
+        if (contents == nullptr)
+        {
+            ::majsdown::error_diagnostic_stream("IO")
+                << "(" << get_diagnostic_line() << ") Failed to open file '"
+                << path << "'\n\n";
+
+            return false;
+        }
+
+        buffer.assign(*contents);
+        return true;
+    }
+
+    const std::size_t diagnostic_line = get_diagnostic_line();
+
+    std::ifstream ifs(path.data(), std::ios::binary | std::ios::ate);
+    if (!ifs)
+    {
+        ::majsdown::error_diagnostic_stream("IO")
+            << "(" << diagnostic_line << ") Failed to open file '" << buffer
+            << "'\n\n";
+
+        return false;
+    }
+
+    const auto size = static_cast<std::streamsize>(ifs.tellg());
+    ifs.seekg(0, std::ios::beg);
+
+    buffer.clear();
+    buffer.resize(size);
+
+    if (!ifs.read(buffer.data(), size))
+    {
+        ::majsdown::error_diagnostic_stream("IO")
+            << "(" << diagnostic_line << ") Failed to read file '" << buffer
+            << "'\n\n";
+
+        return false;
+    }
+
+    return true;
+}
+
+// Evaluates an included file through the shared cache, compiling it to
+// bytecode only the first time it is seen (or after it changes on disk).
+static void include_file_cached(
+    JSContext* context, file_cache& cache, const std::string& path)
+{
+    record_touched_file(context, path);
+
+    if (const file_cache::shared_buffer bytecode = cache.find_bytecode(path);
+        bytecode != nullptr)
+    {
+        const JSValue func = JS_ReadObject(context,
+            reinterpret_cast<const std::uint8_t*>(bytecode->data()),
+            bytecode->size(), JS_READ_OBJ_BYTECODE);
+
+        if (!JS_IsException(func))
+        {
+            const raii_js_value result{
+                context, JS_EvalFunction(context, func)};
+        }
+
+        return;
+    }
+
+    const file_cache::shared_buffer contents = cache.read(path);
+    if (contents == nullptr)
+    {
+        ::majsdown::error_diagnostic_stream("IO")
+            << "(" << get_diagnostic_line() << ") Failed to open file '"
+            << path << "'\n\n";
+
+        return;
+    }
+
+    // `std::string` storage is null-terminated, as required by `JS_Eval`
+    const JSValue func = JS_Eval(context, contents->data(), contents->size(),
+        "<evalScript>", JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+
+    if (JS_IsException(func))
+    {
+        return;
+    }
+
+    std::size_t size;
+    std::uint8_t* const bytes =
+        JS_WriteObject(context, &size, func, JS_WRITE_OBJ_BYTECODE);
+
+    if (bytes != nullptr)
+    {
+        cache.store_bytecode(path, contents,
+            std::string(reinterpret_cast<const char*>(bytes), size));
+
+        js_free(context, bytes);
+    }
+
+    const raii_js_value result{context, JS_EvalFunction(context, func)};
+}
+
+// Absolute, lexically normal form of `path` resolved against `directory`,
+// identifying a file regardless of how it was spelled.
+[[nodiscard]] static std::string resolve_path(
+    const std::string_view directory, const std::string_view path)
+{
+    const std::filesystem::path joined =
+        std::filesystem::path{directory} / std::filesystem::path{path};
+
+    std::error_code ec;
+    const std::filesystem::path absolute =
+        std::filesystem::absolute(joined, ec);
+
+    return (ec ? joined : absolute).lexically_normal().string();
+}
+
+// With `majsdown_include(path, {once: true})`, files already included by the
+// current context are skipped.
+[[nodiscard]] static bool should_include(
+    JSContext* context, const std::string& path, JSValueConst options)
+{
+    const bool inserted =
+        get_context_data(context)
+            ._included_files.insert(resolve_path({}, path))
+            .second;
+
+    if (inserted || !JS_IsObject(options))
+    {
+        return true;
+    }
+
+    const raii_js_value once{
+        context, JS_GetPropertyStr(context, options, "once")};
+    return JS_ToBool(context, once._value) <= 0;
+}
+
+static void include_file(JSContext* context, JSValueConst* argv)
+{
+    const raii_js_value str_value{context, JS_ToString(context, argv[0])};
+    const char* string_arg{JS_ToCString(context, str_value._value)};
+
+    thread_local std::string tmp_buffer;
+
+    tmp_buffer.clear();
+    tmp_buffer.append(string_arg);
+
+    if (!should_include(context, tmp_buffer, argv[1]))
+    {
+        return;
+    }
+
+    if (file_cache* const cache = get_context_data(context)._file_cache;
+        cache != nullptr)
+    {
+        include_file_cached(context, *cache, tmp_buffer);
+        return;
+    }
+
+    if (!read_file_in_buffer(context, tmp_buffer, tmp_buffer))
+    {
+        return;
+    }
+
+    eval_impl(context, tmp_buffer);
+}
+
+[[nodiscard]] static JSValue embed_file(JSContext* context, JSValueConst* argv)
+{
+    const raii_js_value str_value{context, JS_ToString(context, argv[0])};
+    const char* string_arg{JS_ToCString(context, str_value._value)};
+
+    thread_local std::string tmp_buffer;
+
+    tmp_buffer.clear();
+    tmp_buffer.append(string_arg);
+
+    if (!read_file_in_buffer(context, tmp_buffer, tmp_buffer))
+    {
+        return JS_NewString(
+            context, "((MJSD ERROR)): Failure reading file to be embedded");
+    }
+
+    // Sized, as the contents may contain NUL bytes
+    return JS_NewStringLen(context, tmp_buffer.data(), tmp_buffer.size());
+}
+
+// Deep-freezes its argument, so cached documents cannot be mutated by the
+// directives sharing them.
+static constexpr std::string_view deep_freeze_source = R"((function freeze(v) {
+    if (v !== null && typeof v === 'object' && !Object.isFrozen(v)) {
+        Object.freeze(v);
+        for (const k of Object.keys(v)) freeze(v[k]);
+    }
+    return v;
+}))";
+
+[[nodiscard]] static JSValue throw_io_error(
+    JSContext* context, const std::string& path)
+{
+    ::majsdown::error_diagnostic_stream("IO")
+        << "(" << get_diagnostic_line() << ") Failed to open file '" << path
+        << "'\n\n";
+
+    return JS_ThrowInternalError(
+        context, "Failed to open file '%s'", path.c_str());
+}
+
+// Parses straight from the file's (null-terminated) storage, without
+// creating a JS string first.
+[[nodiscard]] static JSValue parse_json_file(
+    JSContext* context, const std::string& path)
+{
+    if (file_cache* const cache = get_context_data(context)._file_cache;
+        cache != nullptr)
+    {
+        const file_cache::shared_buffer contents = cache->read(path);
+        if (contents == nullptr)
+        {
+            return throw_io_error(context, path);
+        }
+
+        return JS_ParseJSON(
+            context, contents->data(), contents->size(), path.c_str());
+    }
+
+    mapped_file file;
+    if (!file.open(path))
+    {
+        return throw_io_error(context, path);
+    }
+
+    return JS_ParseJSON(context, file.data(), file.size(), path.c_str());
+}
+
+[[nodiscard]] static JSValue load_json_file(
+    JSContext* context, JSValueConst* argv)
+{
+    const char* const string_arg = JS_ToCString(context, argv[0]);
+    if (string_arg == nullptr)
+    {
+        return JS_EXCEPTION;
+    }
+
+    const std::string path{string_arg};
+    JS_FreeCString(context, string_arg);
+
+    record_touched_file(context, path);
+
+    const std::optional<mapped_file::stamp> stamp =
+        mapped_file::get_stamp(path);
+
+    if (!stamp.has_value())
+    {
+        return throw_io_error(context, path);
+    }
+
+    context_data& data = get_context_data(context);
+
+    if (const auto it = data._json_cache.find(path);
+        it != data._json_cache.end() && it->second._stamp == *stamp)
+    {
+        return JS_DupValue(context, it->second._value._value);
+    }
+
+    raii_js_value parsed{context, parse_json_file(context, path)};
+    if (JS_IsException(parsed._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    if (!data._deep_freeze.has_value())
+    {
+        data._deep_freeze.emplace(context,
+            JS_Eval(context, deep_freeze_source.data(),
+                deep_freeze_source.size(), "<freeze>", JS_EVAL_TYPE_GLOBAL));
+    }
+
+    raii_js_value frozen{context,
+        JS_Call(context, data._deep_freeze->_value, JS_UNDEFINED, 1,
+            &parsed._value)};
+
+    if (JS_IsException(frozen._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    const JSValue result = JS_DupValue(context, frozen._value);
+
+    data._json_cache.insert_or_assign(path,
+        json_cache_entry{._stamp = *stamp, ._value = std::move(frozen)});
+
+    return result;
+}
+
+// Serializes a compiled script or module, for the bytecode caches.
+[[nodiscard]] static std::optional<std::string> write_bytecode(
+    JSContext* context, JSValueConst value)
+{
+    std::size_t size;
+    std::uint8_t* const bytes =
+        JS_WriteObject(context, &size, value, JS_WRITE_OBJ_BYTECODE);
+
+    if (bytes == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    std::string result(reinterpret_cast<const char*>(bytes), size);
+    js_free(context, bytes);
+
+    return result;
+}
+
+[[nodiscard]] static JSValue read_bytecode(
+    JSContext* context, const std::string& bytecode)
+{
+    return JS_ReadObject(context,
+        reinterpret_cast<const std::uint8_t*>(bytecode.data()),
+        bytecode.size(), JS_READ_OBJ_BYTECODE);
+}
+
+[[nodiscard]] static JSValue compile_module_source(JSContext* context,
+    const std::string& path, const char* source, const std::size_t size)
+{
+    return JS_Eval(context, source, size, path.c_str(),
+        JS_EVAL_TYPE_MODULE | JS_EVAL_FLAG_COMPILE_ONLY);
+}
+
+// Compiles the module at `path`, reusing its bytecode while the file is
+// unchanged: from the shared cache if there is one, otherwise from the
+// interpreter's own cache, which survives resets.
+[[nodiscard]] static JSValue compile_module(
+    JSContext* context, const std::string& path)
+{
+    context_data& data = get_context_data(context);
+    constexpr auto kind = file_cache::bytecode_kind::module;
+
+    if (file_cache* const cache = data._file_cache; cache != nullptr)
+    {
+        if (const file_cache::shared_buffer bytecode =
+                cache->find_bytecode(path, kind);
+            bytecode != nullptr)
+        {
+            return read_bytecode(context, *bytecode);
+        }
+
+        const file_cache::shared_buffer contents = cache->read(path);
+        if (contents == nullptr)
+        {
+            return throw_io_error(context, path);
+        }
+
+        const JSValue module = compile_module_source(
+            context, path, contents->data(), contents->size());
+
+        if (!JS_IsException(module))
+        {
+            if (std::optional<std::string> bytecode =
+                    write_bytecode(context, module))
+            {
+                cache->store_bytecode(
+                    path, contents, std::move(*bytecode), kind);
+            }
+        }
+
+        return module;
+    }
+
+    const std::optional<mapped_file::stamp> stamp =
+        mapped_file::get_stamp(path);
+
+    if (!stamp.has_value())
+    {
+        return throw_io_error(context, path);
+    }
+
+    if (const auto it = data._module_bytecode.find(path);
+        it != data._module_bytecode.end() && it->second._stamp == *stamp)
+    {
+        return read_bytecode(context, it->second._bytecode);
+    }
+
+    mapped_file file;
+    if (!file.open(path))
+    {
+        return throw_io_error(context, path);
+    }
+
+    const JSValue module =
+        compile_module_source(context, path, file.data(), file.size());
+
+    if (!JS_IsException(module))
+    {
+        if (std::optional<std::string> bytecode =
+                write_bytecode(context, module))
+        {
+            data._module_bytecode.insert_or_assign(path,
+                module_bytecode_entry{
+                    ._stamp = *stamp, ._bytecode = std::move(*bytecode)});
+        }
+    }
+
+    return module;
+}
+
+// Module names are absolute paths. Relative specifiers (`./`, `../`) are
+// resolved against the importing module, anything else against the module
+// directory.
+[[nodiscard]] static char* normalize_module_name(JSContext* context,
+    const char* base_name, const char* name, void* opaque)
+{
+    (void)opaque;
+
+    const std::string_view specifier{name};
+    const std::filesystem::path base_path{base_name};
+
+    const bool relative_to_base = base_path.is_absolute() &&
+                                  (specifier.starts_with("./") ||
+                                      specifier.starts_with("../"));
+
+    const std::string directory =
+        relative_to_base ? base_path.parent_path().string()
+                         : get_context_data(context)._module_directory;
+
+    const std::string path = resolve_path(directory, specifier);
+
+    return js_strdup(context, path.c_str());
+}
+
+[[nodiscard]] static JSModuleDef* load_module(
+    JSContext* context, const char* name, void* opaque)
+{
+    (void)opaque;
+
+    const std::string path{name};
+    record_touched_file(context, path);
+
+    const JSValue module = compile_module(context, path);
+    if (JS_IsException(module))
+    {
+        return nullptr;
+    }
+
+    // Modules are owned by the context, the value is only a reference
+    JSModuleDef* const result =
+        static_cast<JSModuleDef*>(JS_VALUE_GET_PTR(module));
+
+    JS_FreeValue(context, module);
+    return result;
+}
+
+// Returns the namespace object of the module at `path`, evaluating it the
+// first time it is imported by the current context. Only module code can
+// `import`, so a tiny module imports `path` and hands the namespace over.
+[[nodiscard]] static JSValue import_module(
+    JSContext* context, JSValueConst* argv)
+{
+    const char* const string_arg = JS_ToCString(context, argv[0]);
+    if (string_arg == nullptr)
+    {
+        return JS_EXCEPTION;
+    }
+
+    context_data& data = get_context_data(context);
+
+    const std::string path = resolve_path(data._module_directory, string_arg);
+    JS_FreeCString(context, string_arg);
+
+    if (const auto it = data._module_namespaces.find(path);
+        it != data._module_namespaces.end())
+    {
+        return JS_DupValue(context, it->second._value);
+    }
+
+    std::string source = "import * as m from \"";
+    for (const char c : path)
+    {
+        if (c == '"' || c == '\\')
+        {
+            source += '\\';
+        }
+
+        source += c;
+    }
+
+    source += "\";\nglobalThis.__mjsd_module = m;\n";
+
+    const raii_js_value evaluated{context,
+        JS_Eval(context, source.data(), source.size(), "<import>",
+            JS_EVAL_TYPE_MODULE)};
+
+    if (JS_IsException(evaluated._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    const raii_js_value global_obj{context, JS_GetGlobalObject(context)};
+    const JSAtom atom = JS_NewAtom(context, "__mjsd_module");
+
+    raii_js_value ns{context, JS_GetProperty(context, global_obj._value, atom)};
+    JS_DeleteProperty(context, global_obj._value, atom, 0);
+    JS_FreeAtom(context, atom);
+
+    if (!JS_IsObject(ns._value))
+    {
+        return JS_ThrowInternalError(
+            context, "Failed to evaluate module '%s'", path.c_str());
+    }
+
+    const JSValue result = JS_DupValue(context, ns._value);
+    data._module_namespaces.emplace(path, std::move(ns));
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+
+// Thread pool created on first use by each process. A child forked after
+// the parent used it (e.g. by the fork server) gets its own pool: the parent's
+// workers do not run in the child, and its lock may have been copied while
+// held. The parent's pool is leaked there, as destroying it would join them.
+class process_thread_pool
+{
+private:
+    std::mutex _mutex;
+    std::size_t _n_workers;
+    std::unique_ptr<thread_pool> _pool;
+#if !defined(_WIN32)
+    pid_t _owner_pid = 0;
+#endif
+
+public:
+    [[nodiscard]] explicit process_thread_pool(
+        const std::size_t n_workers) noexcept
+        : _n_workers{n_workers}
+    {}
+
+    [[nodiscard]] thread_pool& get()
+    {
+        const std::lock_guard lock{_mutex};
+
+#if !defined(_WIN32)
+        if (_pool != nullptr && _owner_pid != ::getpid())
+        {
+            (void)_pool.release();
+        }
+
+        _owner_pid = ::getpid();
+#endif
+
+        if (_pool == nullptr)
+        {
+            _pool = std::make_unique<thread_pool>(_n_workers);
+        }
+
+        return *_pool;
+    }
+};
+
+// Process-wide pool running the work of native async builtins, created on
+// first use.
+[[nodiscard]] static thread_pool& get_io_pool()
+{
+    static process_thread_pool pool{0};
+    return pool.get();
+}
+
+// Settles promises on the JS thread. Also tells apart promises from other
+// values, which has no dedicated API.
+static constexpr std::string_view async_helpers_source = R"(({
+    isPromise: (v) => v instanceof Promise,
+    watch: (p) => {
+        const s = { settled: false, failed: false };
+        p.then((v) => { s.settled = true; s.value = v; },
+               (e) => { s.settled = true; s.failed = true; s.error = e; });
+        return s;
+    }
+}))";
+
+[[nodiscard]] static JSValue call_async_helper(
+    JSContext* context, const char* name, JSValueConst arg)
+{
+    context_data& data = get_context_data(context);
+
+    if (!data._async_helpers.has_value())
+    {
+        data._async_helpers.emplace(context,
+            JS_Eval(context, async_helpers_source.data(),
+                async_helpers_source.size(), "<async>", JS_EVAL_TYPE_GLOBAL));
+    }
+
+    const raii_js_value func{context,
+        JS_GetPropertyStr(context, data._async_helpers->_value, name)};
+
+    return JS_Call(context, func._value, JS_UNDEFINED, 1, &arg);
+}
+
+// Returns `false` if a job threw, leaving the exception pending.
+[[nodiscard]] static bool run_pending_jobs(JSContext* context)
+{
+    JSRuntime* const runtime = JS_GetRuntime(context);
+
+    JSContext* job_context;
+    int status;
+
+    while ((status = JS_ExecutePendingJob(runtime, &job_context)) > 0)
+    {
+    }
+
+    return status == 0;
+}
+
+// Resolves or rejects the promise of a finished native async operation.
+static void settle(JSContext* context, async_completion& completion)
+{
+    context_data& data = get_context_data(context);
+
+    // Operations started by a context that was reset meanwhile are dropped
+    auto node = data._async_resolvers.extract(completion._id);
+    if (node.empty())
+    {
+        return;
+    }
+
+    raii_js_value value{context, JS_UNDEFINED};
+
+    if (completion._ok)
+    {
+        value = raii_js_value{context,
+            JS_NewStringLen(context, completion._value.data(),
+                completion._value.size())};
+    }
+    else
+    {
+        (void)JS_ThrowInternalError(context, "Failed to open file '%s'",
+            completion._path.c_str());
+
+        value = raii_js_value{context, JS_GetException(context)};
+    }
+
+    const raii_js_value& func = node.mapped()[completion._ok ? 0 : 1];
+
+    const raii_js_value result{context,
+        JS_Call(context, func._value, JS_UNDEFINED, 1, &value._value)};
+}
+
+// Runs the job loop until `promise` settles, settling native async
+// operations as they finish. Returns the fulfilled value, or throws the
+// rejection reason.
+[[nodiscard]] static JSValue await_promise(
+    JSContext* context, JSValueConst promise)
+{
+    context_data& data = get_context_data(context);
+
+    const raii_js_value state{
+        context, call_async_helper(context, "watch", promise)};
+
+    if (JS_IsException(state._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    for (;;)
+    {
+        if (!run_pending_jobs(context))
+        {
+            return JS_EXCEPTION;
+        }
+
+        const raii_js_value settled{
+            context, JS_GetPropertyStr(context, state._value, "settled")};
+
+        if (JS_ToBool(context, settled._value) > 0)
+        {
+            break;
+        }
+
+        if (data._async_resolvers.empty())
+        {
+            return JS_ThrowInternalError(
+                context, "Awaited a Promise that can never settle");
+        }
+
+        async_completion completion = data._async_operations->pop();
+        settle(context, completion);
+    }
+
+    const raii_js_value failed{
+        context, JS_GetPropertyStr(context, state._value, "failed")};
+
+    if (JS_ToBool(context, failed._value) > 0)
+    {
+        return JS_Throw(
+            context, JS_GetPropertyStr(context, state._value, "error"));
+    }
+
+    return JS_GetPropertyStr(context, state._value, "value");
+}
+
+// Awaits `value` if it is a promise, otherwise returns it as is. Promises
+// only exist with the `full` JS profile.
+[[nodiscard]] static JSValue await_if_promise(
+    JSContext* context, JSValueConst value)
+{
+    if (!JS_IsObject(value) ||
+        get_context_data(context)._profile != js_profile::full)
+    {
+        return JS_DupValue(context, value);
+    }
+
+    const raii_js_value is_promise{
+        context, call_async_helper(context, "isPromise", value)};
+
+    if (JS_IsException(is_promise._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    return JS_ToBool(context, is_promise._value) > 0
+               ? await_promise(context, value)
+               : JS_DupValue(context, value);
+}
+
+// Like `majsdown_embed`, but returns a promise, fulfilled once the file has
+// been read on the I/O pool. Many files can be loaded concurrently.
+[[nodiscard]] static JSValue embed_file_async(
+    JSContext* context, JSValueConst* argv)
+{
+    const char* const string_arg = JS_ToCString(context, argv[0]);
+    if (string_arg == nullptr)
+    {
+        return JS_EXCEPTION;
+    }
+
+    std::string path{string_arg};
+    JS_FreeCString(context, string_arg);
+
+    record_touched_file(context, path);
+
+    context_data& data = get_context_data(context);
+
+    if (data._profile != js_profile::full)
+    {
+        return throw_missing_intrinsic(context, "Promise");
+    }
+
+    JSValue resolving_funcs[2];
+    const JSValue promise = JS_NewPromiseCapability(context, resolving_funcs);
+
+    if (JS_IsException(promise))
+    {
+        return JS_EXCEPTION;
+    }
+
+    const std::uint64_t id = data._next_async_id++;
+
+    data._async_resolvers.emplace(id,
+        std::array<raii_js_value, 2>{
+            raii_js_value{context, std::move(resolving_funcs[0])},
+            raii_js_value{context, std::move(resolving_funcs[1])}});
+
+    get_io_pool().post(
+        [operations = data._async_operations, cache = data._file_cache, id,
+            path = std::move(path)]() mutable
+        {
+            async_completion completion{
+                ._id = id, ._ok = false, ._path = std::move(path), ._value{}};
+
+            if (cache != nullptr)
+            {
+                if (const file_cache::shared_buffer contents =
+                        cache->read(completion._path);
+                    contents != nullptr)
+                {
+                    completion._ok = true;
+                    completion._value = *contents;
+                }
+            }
+            else if (std::ifstream ifs{completion._path, std::ios::binary})
+            {
+                completion._value.assign(std::istreambuf_iterator<char>{ifs},
+                    std::istreambuf_iterator<char>{});
+
+                completion._ok = !ifs.bad();
+            }
+
+            operations->push(std::move(completion));
+        });
+
+    return promise;
+}
+
+// Evaluation result of a directive, awaited if it is a promise. Jobs queued
+// by the directive run either way.
+[[nodiscard]] static raii_js_value settle_result(
+    JSContext* context, raii_js_value result)
+{
+    if (JS_IsException(result._value))
+    {
+        return result;
+    }
+
+    raii_js_value awaited{context, await_if_promise(context, result._value)};
+
+    if (!JS_IsException(awaited._value) && !run_pending_jobs(context))
+    {
+        return raii_js_value{context, JS_EXCEPTION};
+    }
+
+    return awaited;
+}
+
+// ----------------------------------------------------------------------------
+
+// Pool running `majsdown_parallel_map` work. The calling thread takes part
+// too, for one runtime per hardware thread overall.
+[[nodiscard]] static thread_pool& get_parallel_map_pool()
+{
+    static process_thread_pool pool{
+        std::max(2u, std::thread::hardware_concurrency()) - 1};
+
+    return pool.get();
+}
+
+// Runtime of a thread taking part in `majsdown_parallel_map`, created on
+// first use. It shares nothing with documents and only has the standard
+// built-ins, so mapped functions must be self-contained.
+struct parallel_map_worker
+{
+    context_data _data; // Only holds the entropy state
+    js_runtime_uptr _runtime{JS_NewRuntime()};
+    js_context_uptr _context{JS_NewContext(_runtime.get())};
+
+    // Compiled from `_source`, reused while the same function is mapped
+    std::string _source;
+    std::optional<raii_js_value> _function;
+
+    parallel_map_worker()
+    {
+        JS_SetContextOpaque(_context.get(), &_data);
+        install_entropy_hooks(_context.get(), true /* has_date */);
+    }
+};
+
+struct parallel_map_item
+{
+    std::string _data; // Serialized input on entry, result on exit
+    std::optional<std::string> _error;
+
+    // `Math.random` sequence of the item, in deterministic mode
+    std::uint64_t _random_state = 0;
+    bool _used_nondeterminism = false;
+};
+
+static void store_exception(JSContext* context, parallel_map_item& item)
+{
+    const raii_js_value exception{context, JS_GetException(context)};
+    const char* const message = JS_ToCString(context, exception._value);
+
+    item._error.emplace(message != nullptr ? message : "unknown error");
+    JS_FreeCString(context, message);
+}
+
+// `source` is a parenthesized, null-terminated function expression.
+static void run_parallel_map_item(const std::string& source,
+    const std::optional<determinism_config>& determinism,
+    parallel_map_item& item)
+{
+    thread_local parallel_map_worker worker;
+    JSContext* const ctx = worker._context.get();
+
+    worker._data._determinism = determinism;
+    worker._data._random_state = item._random_state;
+    worker._data._nondeterminism_flag = &item._used_nondeterminism;
+
+    if (!worker._function.has_value() || worker._source != source)
+    {
+        worker._source = source;
+        worker._function.emplace(ctx, JS_Eval(ctx, source.data(),
+                                          source.size(), "<parallel_map>",
+                                          JS_EVAL_TYPE_GLOBAL));
+    }
+
+    if (JS_IsException(worker._function->_value))
+    {
+        store_exception(ctx, item);
+        worker._function.reset();
+
+        return;
+    }
+
+    raii_js_value input{ctx,
+        JS_ReadObject(ctx,
+            reinterpret_cast<const std::uint8_t*>(item._data.data()),
+            item._data.size(), 0)};
+
+    if (JS_IsException(input._value))
+    {
+        store_exception(ctx, item);
+        return;
+    }
+
+    const raii_js_value output{ctx,
+        JS_Call(ctx, worker._function->_value, JS_UNDEFINED, 1,
+            &input._value)};
+
+    if (JS_IsException(output._value))
+    {
+        store_exception(ctx, item);
+        return;
+    }
+
+    std::size_t size;
+    std::uint8_t* const bytes = JS_WriteObject(ctx, &size, output._value, 0);
+
+    if (bytes == nullptr)
+    {
+        store_exception(ctx, item);
+        return;
+    }
+
+    item._data.assign(reinterpret_cast<const char*>(bytes), size);
+    js_free(ctx, bytes);
+}
+
+// `majsdown_parallel_map(fn, inputs)` returns `inputs.map(fn)`, computed on
+// separate runtimes in parallel. `fn` is passed by source, and inputs and
+// results are copied with QuickJS' structured serialization, so they can be
+// strings, numbers and plain objects or arrays of them.
+[[nodiscard]] static JSValue parallel_map(
+    JSContext* context, JSValueConst* argv)
+{
+    // Workers of `evaluate_pure` already run on the pool
+    if (get_context_data(context)._pure_worker)
+    {
+        return throw_unavailable_on_pure_worker(
+            context, "majsdown_parallel_map");
+    }
+
+    if (JS_IsArray(context, argv[1]) <= 0)
+    {
+        return JS_ThrowTypeError(
+            context, "majsdown_parallel_map expects an array of inputs");
+    }
+
+    const raii_js_value fn_source{context, JS_ToString(context, argv[0])};
+    const char* const fn_source_str = JS_ToCString(context, fn_source._value);
+
+    if (fn_source_str == nullptr)
+    {
+        return JS_EXCEPTION;
+    }
+
+    const std::string source = std::string{"("} + fn_source_str + ")";
+    JS_FreeCString(context, fn_source_str);
+
+    const raii_js_value length_value{
+        context, JS_GetPropertyStr(context, argv[1], "length")};
+
+    std::int64_t length;
+    if (JS_ToInt64(context, &length, length_value._value) != 0)
+    {
+        return JS_EXCEPTION;
+    }
+
+    std::vector<parallel_map_item> items(static_cast<std::size_t>(length));
+
+    // Each item draws from its own sequence, whichever worker runs it
+    context_data& data = get_context_data(context);
+    const std::uint64_t base_seed =
+        data._determinism.has_value() ? next_random(data._random_state) : 0;
+
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        const raii_js_value input{context,
+            JS_GetPropertyUint32(
+                context, argv[1], static_cast<std::uint32_t>(i))};
+
+        std::size_t size;
+        std::uint8_t* const bytes =
+            JS_WriteObject(context, &size, input._value, 0);
+
+        if (bytes == nullptr)
+        {
+            return JS_EXCEPTION;
+        }
+
+        items[i]._data.assign(reinterpret_cast<const char*>(bytes), size);
+        items[i]._random_state = hash_combine(base_seed, i);
+        js_free(context, bytes);
+    }
+
+    get_parallel_map_pool().parallel_for(items.size(),
+        [&](const std::size_t i)
+        { run_parallel_map_item(source, data._determinism, items[i]); });
+
+    if (std::any_of(items.begin(), items.end(),
+            [](const parallel_map_item& item)
+            { return item._used_nondeterminism; }))
+    {
+        record_nondeterminism(data);
+    }
+
+    raii_js_value result{context, JS_NewArray(context)};
+
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        if (items[i]._error.has_value())
+        {
+            return JS_ThrowInternalError(context,
+                "majsdown_parallel_map: input %zu: %s", i,
+                items[i]._error->c_str());
+        }
+
+        const JSValue output = JS_ReadObject(context,
+            reinterpret_cast<const std::uint8_t*>(items[i]._data.data()),
+            items[i]._data.size(), 0);
+
+        if (JS_IsException(output))
+        {
+            return JS_EXCEPTION;
+        }
+
+        // Takes ownership of `output`
+        JS_SetPropertyUint32(
+            context, result._value, static_cast<std::uint32_t>(i), output);
+    }
+
+    return JS_DupValue(context, result._value);
+}
+
+// `majsdown_memo(key, fn, dependencies)`: the string `fn()` evaluates to,
+// reused across conversions and processes while the files in the optional
+// `dependencies` array are unchanged. Without a memo cache, `fn` always runs.
+[[nodiscard]] static JSValue memoize(JSContext* context, JSValueConst* argv)
+{
+    // Whether the document's interpreter called the function depends on the
+    // cache contents at the time
+    if (get_context_data(context)._pure_worker)
+    {
+        return throw_unavailable_on_pure_worker(context, "majsdown_memo");
+    }
+
+    const char* const key_arg = JS_ToCString(context, argv[0]);
+    if (key_arg == nullptr)
+    {
+        return JS_EXCEPTION;
+    }
+
+    std::string key{key_arg};
+    JS_FreeCString(context, key_arg);
+
+    if (!JS_IsFunction(context, argv[1]))
+    {
+        return JS_ThrowTypeError(context, "majsdown_memo expects a function");
+    }
+
+    std::vector<std::string> dependencies;
+
+    if (!JS_IsUndefined(argv[2]))
+    {
+        if (JS_IsArray(context, argv[2]) <= 0)
+        {
+            return JS_ThrowTypeError(
+                context, "majsdown_memo expects an array of dependencies");
+        }
+
+        const raii_js_value length_value{
+            context, JS_GetPropertyStr(context, argv[2], "length")};
+
+        std::int64_t length;
+        if (JS_ToInt64(context, &length, length_value._value) != 0)
+        {
+            return JS_EXCEPTION;
+        }
+
+        for (std::int64_t i = 0; i < length; ++i)
+        {
+            const raii_js_value dependency{context,
+                JS_GetPropertyUint32(
+                    context, argv[2], static_cast<std::uint32_t>(i))};
+
+            const char* const path = JS_ToCString(context, dependency._value);
+            if (path == nullptr)
+            {
+                return JS_EXCEPTION;
+            }
+
+            dependencies.emplace_back(path);
+            JS_FreeCString(context, path);
+
+            // Entries depend on which files are listed, not just on their
+            // contents
+            key.append(1, '\0');
+            key.append(dependencies.back());
+        }
+    }
+
+    for (const std::string& dependency : dependencies)
+    {
+        record_touched_file(context, dependency);
+    }
+
+    result_cache* const cache = get_context_data(context)._memo_cache;
+    const std::uint64_t cache_key = result_cache::compute_memo_key(key);
+
+    if (std::ostringstream oss;
+        cache != nullptr && cache->write_cached_output(cache_key, oss))
+    {
+        const std::string value = oss.str();
+        return JS_NewStringLen(context, value.data(), value.size());
+    }
+
+    const raii_js_value result{
+        context, JS_Call(context, argv[1], JS_UNDEFINED, 0, nullptr)};
+
+    if (JS_IsException(result._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    const raii_js_value awaited{
+        context, await_if_promise(context, result._value)};
+
+    if (JS_IsException(awaited._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    const raii_js_value str_value{
+        context, JS_ToString(context, awaited._value)};
+
+    if (JS_IsException(str_value._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    if (cache != nullptr)
+    {
+        std::size_t size;
+        const char* const value =
+            JS_ToCStringLen(context, &size, str_value._value);
+
+        if (value == nullptr)
+        {
+            return JS_EXCEPTION;
+        }
+
+        cache->store(cache_key, dependencies, std::string_view{value, size});
+        JS_FreeCString(context, value);
+    }
+
+    return JS_DupValue(context, str_value._value);
+}
+
+// ----------------------------------------------------------------------------
+
+// Appends the value of an inline expression to the output buffer.
+[[nodiscard]] static JSValue append_to_tl_buffer(
+    JSContext* context, JSValueConst arg)
+{
+    // E.g. `@@{majsdown_embed_async(path)}` outputs the file contents
+    const raii_js_value value{context, await_if_promise(context, arg)};
+    if (JS_IsException(value._value))
+    {
+        return JS_EXCEPTION;
+    }
+
+    const raii_js_value str_value{context, JS_ToString(context, value._value)};
+    const char* string_arg{JS_ToCString(context, str_value._value)};
+
+    std::string* const buffer_ptr{get_tl_buffer_ptr()};
+    assert(buffer_ptr != nullptr);
+    buffer_ptr->append(string_arg);
+
+    return JS_UNDEFINED;
+}
+
+[[nodiscard]] static JSValue output_to_tl_buffer_pointee(
+    JSContext* context, JSValueConst* argv)
+{
+    return append_to_tl_buffer(context, argv[0]);
+}
+
+static void free_mapped_file(JSRuntime* runtime, void* opaque, void* ptr)
+{
+    (void)runtime;
+    (void)ptr;
+
+    delete static_cast<mapped_file*>(opaque);
+}
+
+// Returns an `ArrayBuffer` backed by a private mapping of the file, which is
+// unmapped when the buffer is collected.
+[[nodiscard]] static JSValue embed_file_bytes(
+    JSContext* context, JSValueConst* argv)
+{
+    const char* const string_arg = JS_ToCString(context, argv[0]);
+    if (string_arg == nullptr)
+    {
+        return JS_EXCEPTION;
+    }
+
+    const std::string path{string_arg};
+    JS_FreeCString(context, string_arg);
+
+    record_touched_file(context, path);
+
+    if (get_context_data(context)._profile == js_profile::strings)
+    {
+        return throw_missing_intrinsic(context, "ArrayBuffer");
+    }
+
+    auto file = std::make_unique<mapped_file>();
+    if (!file->open(path))
+    {
+        return throw_io_error(context, path);
+    }
+
+    const JSValue result = JS_NewArrayBuffer(context,
+        reinterpret_cast<std::uint8_t*>(file->mutable_data()), file->size(),
+        &free_mapped_file, file.get(), false);
+
+    if (!JS_IsException(result))
+    {
+        (void)file.release(); // Now owned by the `ArrayBuffer`
+    }
+
+    return result;
+}
+
+// Views the bytes of an `ArrayBuffer` or a typed array, or the UTF-8
+// encoding of a string. The view is valid until `storage` is destroyed.
+[[nodiscard]] static std::optional<std::span<const std::uint8_t>> get_bytes(
+    JSContext* context, JSValueConst value, std::string& storage)
+{
+    if (JS_IsString(value))
+    {
+        std::size_t size;
+        const char* const str = JS_ToCStringLen(context, &size, value);
+        if (str == nullptr)
+        {
+            return std::nullopt;
+        }
+
+        storage.assign(str, size);
+        JS_FreeCString(context, str);
+
+        return std::span{
+            reinterpret_cast<const std::uint8_t*>(storage.data()), size};
+    }
+
+    std::size_t size;
+    if (const std::uint8_t* const bytes =
+            JS_GetArrayBuffer(context, &size, value);
+        bytes != nullptr)
+    {
+        return std::span{bytes, size};
+    }
+
+    // Not an `ArrayBuffer`, try again as a view over one
+    JS_FreeValue(context, JS_GetException(context));
+
+    std::size_t offset;
+    std::size_t length;
+    std::size_t bytes_per_element;
+
+    const raii_js_value buffer{context,
+        JS_GetTypedArrayBuffer(
+            context, value, &offset, &length, &bytes_per_element)};
+
+    if (JS_IsException(buffer._value))
+    {
+        return std::nullopt;
+    }
+
+    const std::uint8_t* const bytes =
+        JS_GetArrayBuffer(context, &size, buffer._value);
+
+    if (bytes == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    return std::span{bytes + offset, length};
+}
+
+[[nodiscard]] static JSValue to_base64(JSContext* context, JSValueConst* argv)
+{
+    std::string storage;
+    const std::optional<std::span<const std::uint8_t>> bytes =
+        get_bytes(context, argv[0], storage);
+
+    if (!bytes.has_value())
+    {
+        return JS_ThrowTypeError(
+            context, "Expected an ArrayBuffer, a typed array or a string");
+    }
+
+    std::string result;
+    append_base64(result, *bytes);
+
+    return JS_NewStringLen(context, result.data(), result.size());
+}
+
+// `majsdown_data_uri(bytes, mimeType = 'application/octet-stream')`
+[[nodiscard]] static JSValue to_data_uri(JSContext* context, JSValueConst* argv)
+{
+    std::string storage;
+    const std::optional<std::span<const std::uint8_t>> bytes =
+        get_bytes(context, argv[0], storage);
+
+    if (!bytes.has_value())
+    {
+        return JS_ThrowTypeError(
+            context, "Expected an ArrayBuffer, a typed array or a string");
+    }
+
+    std::string result = "data:";
+
+    if (JS_IsUndefined(argv[1]))
+    {
+        result.append("application/octet-stream");
+    }
+    else
+    {
+        const char* const mime_type = JS_ToCString(context, argv[1]);
+        if (mime_type == nullptr)
+        {
+            return JS_EXCEPTION;
+        }
+
+        result.append(mime_type);
+        JS_FreeCString(context, mime_type);
+    }
+
+    result.append(";base64,");
+    append_base64(result, *bytes);
+
+    return JS_NewStringLen(context, result.data(), result.size());
+}
+
+// Called by compiled templates in place of `@@<spec>` directives.
+[[nodiscard]] static JSValue splice_snippet(
+    JSContext* context, JSValueConst* argv)
+{
+    std::size_t size;
+    const char* const spec = JS_ToCStringLen(context, &size, argv[0]);
+    if (spec == nullptr)
+    {
+        return JS_EXCEPTION;
+    }
+
+    context_data& data = get_context_data(context);
+
+    std::string* const buffer_ptr{get_tl_buffer_ptr()};
+    assert(buffer_ptr != nullptr);
+
+    const std::optional<std::string> error = data._snippets.splice(
+        std::string_view{spec, size}, *buffer_ptr, data._touched_files);
+
+    JS_FreeCString(context, spec);
+
+    if (error.has_value())
+    {
+        return JS_ThrowInternalError(context, "%s", error->c_str());
+    }
+
+    return JS_UNDEFINED;
+}
+
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+
+// Most inline expressions are a variable, a literal or a call such as
+// `wePic("we3")`. Those are evaluated natively instead of being compiled.
+
+inline constexpr std::size_t max_trivial_call_args = 8;
+
+enum class trivial_status
+{
+    not_trivial,
+    ok,
+    exception
+};
+
+[[nodiscard]] static bool is_identifier_start(const char c) noexcept
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+           c == '$';
+}
+
+[[nodiscard]] static bool is_identifier_part(const char c) noexcept
+{
+    return is_identifier_start(c) || (c >= '0' && c <= '9');
+}
+
+[[nodiscard]] static std::string_view trim_js_spaces(std::string_view sv)
+{
+    constexpr std::string_view spaces = " \t\r\n";
+
+    const std::size_t begin = sv.find_first_not_of(spaces);
+    if (begin == std::string_view::npos)
+    {
+        return {};
+    }
+
+    sv.remove_prefix(begin);
+    sv.remove_suffix(sv.size() - sv.find_last_not_of(spaces) - 1);
+
+    return sv;
+}
+
+[[nodiscard]] static std::size_t scan_identifier(const std::string_view sv)
+{
+    if (sv.empty() || !is_identifier_start(sv.front()))
+    {
+        return 0;
+    }
+
+    std::size_t i = 1;
+    while (i < sv.size() && is_identifier_part(sv[i]))
+    {
+        ++i;
+    }
+
+    return i;
+}
+
+// Length of the literal `sv` begins with, or `0`. Only ASCII strings without
+// escapes, decimal numbers without exponent, booleans and `null` qualify.
+[[nodiscard]] static std::size_t scan_literal(const std::string_view sv)
+{
+    if (sv.empty())
+    {
+        return 0;
+    }
+
+    if (sv.front() == '"' || sv.front() == '\'')
+    {
+        for (std::size_t i = 1; i < sv.size(); ++i)
+        {
+            const char c = sv[i];
+
+            if (c == sv.front())
+            {
+                return i + 1;
+            }
+
+            if (c == '\\' || c == '\n' || c == '\r' ||
+                static_cast<unsigned char>(c) >= 0x80)
+            {
+                return 0;
+            }
+        }
+
+        return 0;
+    }
+
+    const auto digits_end = [&](std::size_t i)
+    {
+        while (i < sv.size() && sv[i] >= '0' && sv[i] <= '9')
+        {
+            ++i;
+        }
+
+        return i;
+    };
+
+    std::size_t end = scan_identifier(sv);
+    if (end != 0)
+    {
+        const std::string_view word = sv.substr(0, end);
+        return word == "true" || word == "false" || word == "null" ? end : 0;
+    }
+
+    end = digits_end(0);
+    if (end == 0 || (sv[0] == '0' && end > 1))
+    {
+        return 0;
+    }
+
+    if (end < sv.size() && sv[end] == '.')
+    {
+        const std::size_t fraction_end = digits_end(end + 1);
+        if (fraction_end == end + 1)
+        {
+            return 0;
+        }
+
+        end = fraction_end;
+    }
+
+    // E.g. `1e3`, `1n` or `1.5.toFixed()`
+    if (end < sv.size() && (is_identifier_part(sv[end]) || sv[end] == '.'))
+    {
+        return 0;
+    }
+
+    return end;
+}
+
+// Text the literal `literal` converts to, if it can be output as-is.
+[[nodiscard]] static std::optional<std::string_view> literal_output(
+    const std::string_view literal)
+{
+    if (literal.front() == '"' || literal.front() == '\'')
+    {
+        return literal.substr(1, literal.size() - 2);
+    }
+
+    // Integers below 2^53, booleans and `null` print as written
+    if (literal.find('.') == std::string_view::npos && literal.size() <= 15)
+    {
+        return literal;
+    }
+
+    return std::nullopt;
+}
+
+[[nodiscard]] static JSValue make_literal(
+    JSContext* context, const std::string_view literal)
+{
+    if (literal.front() == '"' || literal.front() == '\'')
+    {
+        return JS_NewStringLen(
+            context, literal.data() + 1, literal.size() - 2);
+    }
+
+    if (literal == "null")
+    {
+        return JS_NULL;
+    }
+
+    if (literal == "true" || literal == "false")
+    {
+        return JS_NewBool(context, literal == "true");
+    }
+
+    double value = 0;
+    std::from_chars(literal.data(), literal.data() + literal.size(), value);
+
+    if (literal.find('.') == std::string_view::npos && value <= INT32_MAX)
+    {
+        return JS_NewInt32(context, static_cast<std::int32_t>(value));
+    }
+
+    return JS_NewFloat64(context, value);
+}
+
+// Value of the global `name` if it was declared with `var` or `function`.
+// Such bindings are not configurable, so no top-level lexical binding (which
+// is not reachable through the global object) can shadow them.
+[[nodiscard]] static std::optional<raii_js_value> get_declared_global(
+    JSContext* context, const std::string_view name)
+{
+    const raii_js_value global_obj{context, JS_GetGlobalObject(context)};
+    const JSAtom atom = JS_NewAtomLen(context, name.data(), name.size());
+
+    JSPropertyDescriptor desc;
+    const int found =
+        JS_GetOwnProperty(context, &desc, global_obj._value, atom);
+
+    JS_FreeAtom(context, atom);
+
+    if (found < 0)
+    {
+        const raii_js_value exception{context, JS_GetException(context)};
+        return std::nullopt;
+    }
+
+    if (found == 0)
+    {
+        return std::nullopt;
+    }
+
+    JS_FreeValue(context, desc.getter);
+    JS_FreeValue(context, desc.setter);
+
+    raii_js_value value{context, std::move(desc.value)};
+
+    if ((desc.flags & (JS_PROP_GETSET | JS_PROP_CONFIGURABLE)) != 0)
+    {
+        return std::nullopt;
+    }
+
+    return value;
+}
+
+// Calls the function declared as `name` with the literal arguments in
+// `args`, the text between the parentheses.
+[[nodiscard]] static trivial_status call_trivial(JSContext* context,
+    const std::string_view name, std::string_view args, JSValue& result)
+{
+    std::array<std::string_view, max_trivial_call_args> literals;
+    std::size_t n_literals = 0;
+
+    args = trim_js_spaces(args);
+    while (!args.empty())
+    {
+        const std::size_t n = scan_literal(args);
+        if (n == 0 || n_literals == literals.size())
+        {
+            return trivial_status::not_trivial;
+        }
+
+        literals[n_literals++] = args.substr(0, n);
+        args = trim_js_spaces(args.substr(n));
+
+        if (args.empty())
+        {
+            break;
+        }
+
+        if (args.front() != ',')
+        {
+            return trivial_status::not_trivial;
+        }
+
+        args = trim_js_spaces(args.substr(1));
+
+        // Trailing commas are left to the parser
+        if (args.empty())
+        {
+            return trivial_status::not_trivial;
+        }
+    }
+
+    const std::optional<raii_js_value> func =
+        get_declared_global(context, name);
+
+    if (!func.has_value() || !JS_IsFunction(context, func->_value))
+    {
+        return trivial_status::not_trivial;
+    }
+
+    std::array<JSValue, max_trivial_call_args> argv;
+    for (std::size_t i = 0; i < n_literals; ++i)
+    {
+        argv[i] = make_literal(context, literals[i]);
+    }
+
+    result = JS_Call(context, func->_value, JS_UNDEFINED,
+        static_cast<int>(n_literals), argv.data());
+
+    for (std::size_t i = 0; i < n_literals; ++i)
+    {
+        JS_FreeValue(context, argv[i]);
+    }
+
+    return JS_IsException(result) ? trivial_status::exception
+                                  : trivial_status::ok;
+}
+
+// Computes the value of a trivial inline expression, without side effects
+// unless it is a call.
+[[nodiscard]] static trivial_status eval_trivial(
+    JSContext* context, std::string_view expression, JSValue& result)
+{
+    expression = trim_js_spaces(expression);
+
+    if (const std::size_t n = scan_literal(expression);
+        n != 0 && n == expression.size())
+    {
+        result = make_literal(context, expression);
+        return trivial_status::ok;
+    }
+
+    const std::size_t n = scan_identifier(expression);
+    if (n == 0)
+    {
+        return trivial_status::not_trivial;
+    }
+
+    const std::string_view name = expression.substr(0, n);
+    const std::string_view rest = trim_js_spaces(expression.substr(n));
+
+    if (rest.empty())
+    {
+        std::optional<raii_js_value> value =
+            get_declared_global(context, name);
+
+        if (!value.has_value())
+        {
+            return trivial_status::not_trivial;
+        }
+
+        result = std::exchange(value->_value, JS_UNDEFINED);
+        return trivial_status::ok;
+    }
+
+    if (rest.size() < 2 || rest.front() != '(' || rest.back() != ')')
+    {
+        return trivial_status::not_trivial;
+    }
+
+    return call_trivial(
+        context, name, rest.substr(1, rest.size() - 2), result);
+}
+
+// Outputs a trivial inline expression as `__mjsd(expression);` would.
+[[nodiscard]] static trivial_status output_trivial(
+    JSContext* context, const std::string_view expression)
+{
+    // Literals which print as written need no JS value at all
+    const std::string_view trimmed = trim_js_spaces(expression);
+    if (const std::size_t n = scan_literal(trimmed);
+        n != 0 && n == trimmed.size())
+    {
+        if (const std::optional<std::string_view> output =
+                literal_output(trimmed);
+            output.has_value())
+        {
+            std::string* const buffer_ptr{get_tl_buffer_ptr()};
+            assert(buffer_ptr != nullptr);
+            buffer_ptr->append(*output);
+
+            return trivial_status::ok;
+        }
+    }
+
+    JSValue value;
+    const trivial_status status = eval_trivial(context, expression, value);
+
+    if (status != trivial_status::ok)
+    {
+        return status;
+    }
+
+    const raii_js_value value_guard{context, std::move(value)};
+
+    if (JS_IsException(append_to_tl_buffer(context, value_guard._value)) ||
+        !run_pending_jobs(context))
+    {
+        return trivial_status::exception;
+    }
+
+    return trivial_status::ok;
+}
+
+// ----------------------------------------------------------------------------
+
+template <auto FPtr>
+static void bind_function(
+    JSContext* ctx, const std::string_view name, const int n_args) noexcept
+{
+    auto func = [](JSContext* context, JSValueConst this_val, int argc,
+                    JSValueConst* argv) -> JSValue
+    {
+        (void)this_val;
+        (void)argc;
+
+        if constexpr (std::is_void_v<decltype(FPtr(context, argv))>)
+        {
+            FPtr(context, argv);
+            return JS_UNDEFINED;
+        }
+        else if constexpr (std::is_same_v<decltype(FPtr(context, argv)),
+                               JSValue>)
+        {
+            return FPtr(context, argv);
+        }
+        else
+        {
+            // TODO: does this need to be freed as well?
+            return JS_NewString(context, FPtr(context, argv));
+        }
+    };
+
+    const raii_js_value global_obj{ctx, JS_GetGlobalObject(ctx)};
+
+    const JSValue js_func = JS_NewCFunction(ctx, +func, name.data(), n_args);
+
+    JS_SetPropertyStr(ctx, global_obj._value, name.data(), js_func);
+}
+
+// Sets up a context created by `make_context` for `data._profile`. `data`
+// must outlive the context.
+static void bind_builtins(JSContext* ctx, context_data& data) noexcept
+{
+    JS_SetContextOpaque(ctx, &data);
+
+    if (data._profile != js_profile::full)
+    {
+        define_missing_intrinsics(ctx);
+    }
+
+    define_std_prelude_exports(ctx);
+    install_entropy_hooks(ctx, data._profile != js_profile::strings);
+
+    bind_function<&output_to_tl_buffer_pointee>(ctx, "__mjsd", 1);
+    bind_function<&set_line_adjustment>(ctx, "__mjsd_line", 1);
+    bind_function<&set_current_line>(ctx, "__mjsd_at", 1);
+    bind_function<&include_file>(ctx, "majsdown_include", 2);
+    bind_function<&import_module>(ctx, "majsdown_import", 1);
+    bind_function<&embed_file>(ctx, "majsdown_embed", 1);
+    bind_function<&embed_file_async>(ctx, "majsdown_embed_async", 1);
+    bind_function<&parallel_map>(ctx, "majsdown_parallel_map", 2);
+    bind_function<&memoize>(ctx, "majsdown_memo", 3);
+    bind_function<&load_json_file>(ctx, "majsdown_json", 1);
+    bind_function<&embed_file_bytes>(ctx, "majsdown_embed_bytes", 1);
+    bind_function<&to_base64>(ctx, "majsdown_base64", 1);
+    bind_function<&to_data_uri>(ctx, "majsdown_data_uri", 2);
+    bind_function<&splice_snippet>(ctx, "__mjsd_splice", 1);
+}
+
+// Top-level code run by a `js_interpreter`, or a setting affecting how code
+// runs. The workers of `evaluate_pure` replay it to reproduce the state of
+// the document's interpreter.
+struct logged_execution
+{
+    enum class kind
+    {
+        script,
+        trivial_expression,
+        bytecode,
+        global_json,
+        determinism,
+        module_directory
+    };
+
+    kind _kind;
+    std::string _code; // Source, bytecode, JSON, or module directory
+    std::string _name; // Global bound by `global_json`
+    std::optional<determinism_config> _determinism;
+};
+
+// Everything run since the interpreter last started over, which changes `_id`.
+struct execution_log
+{
+    std::uint64_t _id;
+    js_profile _profile;
+    std::vector<logged_execution> _entries;
+};
+
+[[nodiscard]] static std::uint64_t make_execution_log_id() noexcept
+{
+    static std::atomic<std::uint64_t> next_id{1};
+    return next_id++;
+}
+
+static void discard_pending_exception(JSContext* context) noexcept
+{
+    const raii_js_value exception{context, JS_GetException(context)};
+}
+
+// Runs `entry` like `js_interpreter` did, ignoring errors, which the
+// document's interpreter met as well.
+static void replay(JSContext* ctx, const logged_execution& entry)
+{
+    context_data& data = get_context_data(ctx);
+
+    switch (entry._kind)
+    {
+        case logged_execution::kind::script:
+        {
+            const raii_js_value result =
+                settle_result(ctx, eval_impl(ctx, entry._code));
+
+            if (JS_IsException(result._value))
+            {
+                discard_pending_exception(ctx);
+            }
+
+            break;
+        }
+
+        case logged_execution::kind::trivial_expression:
+        {
+            if (output_trivial(ctx, entry._code) == trivial_status::exception)
+            {
+                discard_pending_exception(ctx);
+            }
+
+            break;
+        }
+
+        case logged_execution::kind::bytecode:
+        {
+            const JSValue func = JS_ReadObject(ctx,
+                reinterpret_cast<const std::uint8_t*>(entry._code.data()),
+                entry._code.size(), JS_READ_OBJ_BYTECODE);
+
+            // Takes ownership of `func`
+            const raii_js_value result = JS_IsException(func)
+                                             ? raii_js_value{ctx, JS_EXCEPTION}
+                                             : settle_result(ctx,
+                                                   raii_js_value{ctx,
+                                                       JS_EvalFunction(
+                                                           ctx, func)});
+
+            if (JS_IsException(result._value))
+            {
+                discard_pending_exception(ctx);
+            }
+
+            break;
+        }
+
+        case logged_execution::kind::global_json:
+        {
+            const JSValue value = JS_ParseJSON(
+                ctx, entry._code.data(), entry._code.size(), "<json>");
+
+            if (JS_IsException(value))
+            {
+                discard_pending_exception(ctx);
+                break;
+            }
+
+            const raii_js_value global_obj{ctx, JS_GetGlobalObject(ctx)};
+
+            // Takes ownership of `value`
+            JS_SetPropertyStr(
+                ctx, global_obj._value, entry._name.data(), value);
+
+            break;
+        }
+
+        case logged_execution::kind::determinism:
+        {
+            data._determinism = entry._determinism;
+
+            if (data._determinism.has_value())
+            {
+                data._random_state = data._determinism->_random_seed;
+            }
+
+            break;
+        }
+
+        case logged_execution::kind::module_directory:
+        {
+            data._module_directory = entry._code;
+            break;
+        }
+    }
+}
+
+// Runtime of a thread taking part in `js_interpreter::evaluate_pure`, whose
+// context replays the execution log of a document's interpreter.
+struct pure_worker
+{
+    js_runtime_uptr _runtime{JS_NewRuntime()};
+    js_context_uptr _context{nullptr, js_context_deleter};
+    context_data _data;
+
+    std::uint64_t _log_id;
+    std::size_t _n_replayed = 0;
+
+    [[nodiscard]] explicit pure_worker(const execution_log& log)
+        : _data{._profile = log._profile, ._pure_worker = true},
+          _log_id{log._id}
+    {
+        JS_SetModuleLoaderFunc(
+            _runtime.get(), &normalize_module_name, &load_module, nullptr);
+
+        _context.reset(make_context(_runtime.get(), log._profile));
+        bind_builtins(_context.get(), _data);
+    }
+};
+
+// Brings `worker` up to date with `log`, whose beginning it may have replayed
+// already. Returns `false` if `worker` cannot reproduce the state.
+[[nodiscard]] static bool catch_up(
+    pure_worker& worker, const execution_log& log)
+{
+    worker._data._replaying = true;
+
+    for (; worker._n_replayed < log._entries.size() && !worker._data._diverged;
+         ++worker._n_replayed)
+    {
+        replay(worker._context.get(), log._entries[worker._n_replayed]);
+    }
+
+    worker._data._replaying = false;
+    return !worker._data._diverged;
+}
+
+// Returns `std::nullopt` if the expression cannot be evaluated on a worker,
+// or if its value is an object, which only the document's interpreter can
+// output faithfully (e.g. promises).
+[[nodiscard]] static std::optional<std::string> evaluate_pure_on_worker(
+    const execution_log& log, file_cache* cache, const std::string& source)
+{
+    thread_local std::optional<pure_worker> worker;
+
+    if (!worker.has_value() || worker->_log_id != log._id)
+    {
+        worker.reset();
+        worker.emplace(log);
+    }
+
+    // Replayed code outputs and reports nothing, and leaves the diagnostics
+    // of the calling thread alone
+    thread_local std::ostream discarded_diagnostics{nullptr};
+    std::string discarded_output;
+
+    const tl_guard<&get_tl_buffer_ptr> buffer_ptr_guard{&discarded_output};
+    const tl_guard<&get_tl_err_stream> err_stream_guard{
+        &discarded_diagnostics};
+    const tl_guard<&get_tl_diagnostics_line> line_guard{
+        get_tl_diagnostics_line()};
+    const tl_guard<&get_tl_diagnostics_line_adjustment> adjustment_guard{
+        get_tl_diagnostics_line_adjustment()};
+
+    worker->_data._file_cache = cache;
+
+    if (!catch_up(*worker, log))
+    {
+        return std::nullopt;
+    }
+
+    JSContext* const ctx = worker->_context.get();
+
+    // Like `__mjsd`, outputs the first value of a comma-separated list
+    const std::string js = "((v) => v)(" + source + "\n)";
+
+    const raii_js_value value{ctx,
+        JS_Eval(ctx, js.data(), js.size(), "<pure>", JS_EVAL_TYPE_GLOBAL)};
+
+    if (worker->_data._diverged)
+    {
+        // Even if the expression caught the error, its value is unreliable.
+        // The worker starts over next time, as ids start at 1.
+        worker->_log_id = 0;
+        discard_pending_exception(ctx);
+
+        return std::nullopt;
+    }
+
+    if (JS_IsException(value._value))
+    {
+        discard_pending_exception(ctx);
+        return std::nullopt;
+    }
+
+    if (JS_IsObject(value._value))
+    {
+        return std::nullopt;
+    }
+
+    const char* const str = JS_ToCString(ctx, value._value);
+    if (str == nullptr)
+    {
+        discard_pending_exception(ctx);
+        return std::nullopt;
+    }
+
+    std::string result{str};
+    JS_FreeCString(ctx, str);
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+
+struct js_interpreter::impl
+{
+private:
+    tl_guard<&get_tl_err_stream> _err_stream_tl_guard;
+    js_runtime_uptr _runtime;
+    js_context_uptr _context;
+    std::size_t _curr_diagnostics_line;
+    context_data _context_data;
+
+    // See `js_interpreter::get_execution_hash`
+    std::uint64_t _execution_hash = hash_seed;
+
+    // Replayed by the workers of `evaluate_pure`
+    execution_log _execution_log;
+
+    void restart_random_sequence() noexcept
+    {
+        if (_context_data._determinism.has_value())
+        {
+            _context_data._random_state =
+                _context_data._determinism->_random_seed;
+        }
+    }
+
+    // Logs `entry`, about to run, and folds its code into `_execution_hash`.
+    // Settings are logged for the workers only.
+    void record_execution(logged_execution entry) noexcept
+    {
+        if (entry._kind != logged_execution::kind::determinism &&
+            entry._kind != logged_execution::kind::module_directory)
+        {
+            _execution_hash = hash_combine(
+                _execution_hash, static_cast<std::uint64_t>(entry._kind));
+
+            _execution_hash = hash_bytes(entry._name,
+                hash_combine(_execution_hash, entry._name.size()));
+
+            _execution_hash = hash_bytes(entry._code,
+                hash_combine(_execution_hash, entry._code.size()));
+        }
+
+        _execution_log._entries.push_back(std::move(entry));
+    }
+
+    void record_execution(
+        const logged_execution::kind kind, const std::string_view code) noexcept
+    {
+        record_execution(logged_execution{._kind = kind,
+            ._code = std::string{code},
+            ._name = {},
+            ._determinism = std::nullopt});
+    }
+
+    // Logs the settings workers do not start with.
+    void record_settings() noexcept
+    {
+        if (_context_data._determinism.has_value())
+        {
+            record_execution(
+                logged_execution{._kind = logged_execution::kind::determinism,
+                    ._code = {},
+                    ._name = {},
+                    ._determinism = _context_data._determinism});
+        }
+
+        if (!_context_data._module_directory.empty())
+        {
+            record_execution(logged_execution::kind::module_directory,
+                _context_data._module_directory);
+        }
+    }
+
+    [[nodiscard]] std::optional<error> check_js_errors(const JSValue& js_value)
+    {
+        JSContext* ctx = _context.get();
+
+        if (JS_IsException(js_value) || JS_IsError(ctx, js_value))
+        {
+            const raii_js_value js_exception{ctx, JS_GetException(ctx)};
+
+            const raii_js_value js_stack_trace{
+                ctx, JS_GetPropertyStr(ctx, js_exception._value, "stack")};
+
+            const std::string_view js_stack_trace_sv =
+                JS_ToCString(ctx, js_stack_trace._value);
+
+            const auto js_stack_trace_line_num =
+                [&]() -> std::optional<std::size_t>
+            {
+                using namespace std::string_view_literals;
+
+                const auto needle = "(<evalScript>:"sv;
+                const auto n_begin = js_stack_trace_sv.find(needle);
+
+                if (n_begin == std::string_view::npos)
+                {
+                    return std::nullopt;
+                }
+
+                const auto n_end = js_stack_trace_sv.find(")", n_begin);
+
+                if (n_end == std::string_view::npos)
+                {
+                    return std::nullopt;
+                }
+
+                const auto extr_begin = n_begin + needle.size();
+                const auto extr_len = n_end - extr_begin;
+
+                const std::string_view extr =
+                    js_stack_trace_sv.substr(extr_begin, extr_len);
+
+                return std::stoi(std::string(extr));
+            }();
+
+            // TODO: deal with number extraction for nicer diagnostics
+            error_diagnostic_stream("JS")
+                << JS_ToCString(ctx, js_exception._value) << "\n\n"
+                << js_stack_trace_sv << "\n\n"
+                << "Interpreter line: '" << js_stack_trace_line_num.value_or(1) << "'\n";
+
+            return error{._line = js_stack_trace_line_num.value_or(1)};
+        }
+
+        return std::nullopt;
+    }
+
+public:
+    [[nodiscard]] explicit impl(
+        std::ostream& err_stream, const js_profile profile) noexcept
+        : _err_stream_tl_guard{&err_stream},
+          _runtime{JS_NewRuntime()},
+          _context{make_context(_runtime.get(), profile)},
+          _curr_diagnostics_line{0},
+          _context_data{._profile = profile},
+          _execution_log{._id = make_execution_log_id(),
+              ._profile = profile,
+              ._entries = {}}
+    {
+        JS_SetModuleLoaderFunc(
+            _runtime.get(), &normalize_module_name, &load_module, nullptr);
+
+        bind_builtins(_context.get(), _context_data);
+    }
+
+    [[nodiscard]] std::optional<error> interpret(
+        std::string& output_buffer, const std::string_view source) noexcept
+    {
+        tl_guard<&get_tl_buffer_ptr> buffer_ptr_guard{&output_buffer};
+        record_execution(logged_execution::kind::script, source);
+
+        return check_js_errors(settle_result(
+            _context.get(), eval_impl(_context.get(), source))._value);
+    }
+
+    [[nodiscard]] std::optional<error> interpret_discard(
+        const std::string_view source) noexcept
+    {
+        record_execution(logged_execution::kind::script, source);
+
+        return check_js_errors(settle_result(
+            _context.get(), eval_impl(_context.get(), source))._value);
+    }
+
+    [[nodiscard]] bool interpret_trivial(std::string& output_buffer,
+        const std::string_view expression,
+        std::optional<error>& result) noexcept
+    {
+        tl_guard<&get_tl_buffer_ptr> buffer_ptr_guard{&output_buffer};
+
+        const trivial_status status =
+            output_trivial(_context.get(), expression);
+
+        if (status == trivial_status::not_trivial)
+        {
+            return false;
+        }
+
+        record_execution(
+            logged_execution::kind::trivial_expression, expression);
+        result = status == trivial_status::ok ? std::nullopt
+                                              : check_js_errors(JS_EXCEPTION);
+
+        return true;
+    }
+
+    [[nodiscard]] std::optional<error> compile(
+        const std::string_view source, std::string& bytecode) noexcept
+    {
+        JSContext* ctx = _context.get();
+
+        const raii_js_value func{ctx,
+            JS_Eval(ctx, source.data(), source.size(), "<evalScript>",
+                JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY)};
+
+        if (JS_IsException(func._value))
+        {
+            return check_js_errors(func._value);
+        }
+
+        std::size_t size;
+        std::uint8_t* const bytes =
+            JS_WriteObject(ctx, &size, func._value, JS_WRITE_OBJ_BYTECODE);
+
+        if (bytes == nullptr)
+        {
+            return check_js_errors(JS_EXCEPTION);
+        }
+
+        bytecode.assign(reinterpret_cast<const char*>(bytes), size);
+        js_free(ctx, bytes);
+
+        return std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<error> run_bytecode(
+        std::string& output_buffer, const std::string_view bytecode) noexcept
+    {
+        JSContext* ctx = _context.get();
+        tl_guard<&get_tl_buffer_ptr> buffer_ptr_guard{&output_buffer};
+
+        record_execution(logged_execution::kind::bytecode, bytecode);
+
+        const JSValue func = JS_ReadObject(ctx,
+            reinterpret_cast<const std::uint8_t*>(bytecode.data()),
+            bytecode.size(), JS_READ_OBJ_BYTECODE);
+
+        if (JS_IsException(func))
+        {
+            return check_js_errors(func);
+        }
+
+        // Takes ownership of `func`
+        return check_js_errors(settle_result(
+            ctx, raii_js_value{ctx, JS_EvalFunction(ctx, func)})._value);
+    }
+
+    [[nodiscard]] std::optional<error> set_global_json(
+        const std::string_view name, const std::string_view json) noexcept
+    {
+        JSContext* ctx = _context.get();
+
+        record_execution(logged_execution{
+            ._kind = logged_execution::kind::global_json,
+            ._code = std::string{json},
+            ._name = std::string{name},
+            ._determinism = std::nullopt});
+
+        const JSValue value =
+            JS_ParseJSON(ctx, json.data(), json.size(), "<json>");
+
+        if (JS_IsException(value))
+        {
+            return check_js_errors(value);
+        }
+
+        const raii_js_value global_obj{ctx, JS_GetGlobalObject(ctx)};
+
+        // Takes ownership of `value`
+        JS_SetPropertyStr(ctx, global_obj._value, name.data(), value);
+        return std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<std::string> splice(
+        std::string& output_buffer, const std::string_view spec) noexcept
+    {
+        return _context_data._snippets.splice(
+            spec, output_buffer, _context_data._touched_files);
+    }
+
+    void set_current_diagnostics_line(const std::size_t line) noexcept
+    {
+        get_tl_diagnostics_line() = _curr_diagnostics_line = line;
+    }
+
+    [[nodiscard]] std::size_t get_current_diagnostics_line_adjustment() noexcept
+    {
+        return get_tl_diagnostics_line_adjustment();
+    }
+
+    void set_file_cache(file_cache* cache) noexcept
+    {
+        _context_data._file_cache = cache;
+    }
+
+    void set_memo_cache(result_cache* cache) noexcept
+    {
+        _context_data._memo_cache = cache;
+    }
+
+    void set_touched_files_sink(std::vector<std::string>* sink) noexcept
+    {
+        _context_data._touched_files = sink;
+    }
+
+    void set_determinism(
+        const std::optional<determinism_config>& config) noexcept
+    {
+        _context_data._determinism = config;
+        restart_random_sequence();
+
+        record_execution(
+            logged_execution{._kind = logged_execution::kind::determinism,
+                ._code = {},
+                ._name = {},
+                ._determinism = config});
+    }
+
+    void set_nondeterminism_flag(bool* flag) noexcept
+    {
+        _context_data._nondeterminism_flag = flag;
+    }
+
+    void set_module_directory(const std::string_view directory) noexcept
+    {
+        _context_data._module_directory = directory;
+
+        record_execution(
+            logged_execution::kind::module_directory, directory);
+    }
+
+    void reset() noexcept
+    {
+        _context_data.release_js_values();
+        _context_data._included_files.clear();
+        _context.reset(make_context(_runtime.get(), _context_data._profile));
+        get_tl_diagnostics_line_adjustment() = 0;
+        restart_random_sequence();
+
+        _execution_hash = hash_seed;
+        _execution_log._id = make_execution_log_id();
+        _execution_log._entries.clear();
+        record_settings();
+
+        bind_builtins(_context.get(), _context_data);
+    }
+
+    [[nodiscard]] std::uint64_t get_execution_hash() const noexcept
+    {
+        return _execution_hash;
+    }
+
+    void evaluate_pure(const std::span<const std::string> sources,
+        std::vector<std::optional<std::string>>& results) noexcept
+    {
+        results.assign(sources.size(), std::nullopt);
+
+        get_parallel_map_pool().parallel_for(sources.size(),
+            [&](const std::size_t i)
+            {
+                results[i] = evaluate_pure_on_worker(
+                    _execution_log, _context_data._file_cache, sources[i]);
+            });
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+js_interpreter::js_interpreter(
+    std::ostream& err_stream, const js_profile profile)
+    : _impl{std::make_unique<impl>(err_stream, profile)}
+{}
+
+js_interpreter::~js_interpreter() = default;
+
+std::optional<js_interpreter::error> js_interpreter::interpret(
+    std::string& output_buffer, const std::string_view source) noexcept
+{
+    return _impl->interpret(output_buffer, source);
+}
+
+std::optional<js_interpreter::error> js_interpreter::interpret_discard(
+    const std::string_view source) noexcept
+{
+    return _impl->interpret_discard(source);
+}
+
+bool js_interpreter::interpret_trivial(std::string& output_buffer,
+    const std::string_view expression, std::optional<error>& result) noexcept
+{
+    return _impl->interpret_trivial(output_buffer, expression, result);
+}
+
+std::optional<js_interpreter::error> js_interpreter::compile(
+    const std::string_view source, std::string& bytecode) noexcept
+{
+    return _impl->compile(source, bytecode);
+}
+
+std::optional<js_interpreter::error> js_interpreter::run_bytecode(
+    std::string& output_buffer, const std::string_view bytecode) noexcept
+{
+    return _impl->run_bytecode(output_buffer, bytecode);
+}
+
+std::optional<js_interpreter::error> js_interpreter::set_global_json(
+    const std::string_view name, const std::string_view json) noexcept
+{
+    return _impl->set_global_json(name, json);
+}
+
+std::optional<std::string> js_interpreter::splice(
+    std::string& output_buffer, const std::string_view spec) noexcept
+{
+    return _impl->splice(output_buffer, spec);
+}
+
+void js_interpreter::set_current_diagnostics_line(
+    const std::size_t line) noexcept
+{
+    _impl->set_current_diagnostics_line(line);
+}
+
+[[nodiscard]] std::size_t
+js_interpreter::get_current_diagnostics_line_adjustment() noexcept
+{
+    return _impl->get_current_diagnostics_line_adjustment();
+}
+
+void js_interpreter::set_file_cache(file_cache* cache) noexcept
+{
+    _impl->set_file_cache(cache);
+}
+
+void js_interpreter::set_memo_cache(result_cache* cache) noexcept
+{
+    _impl->set_memo_cache(cache);
+}
+
+void js_interpreter::set_touched_files_sink(
+    std::vector<std::string>* sink) noexcept
+{
+    _impl->set_touched_files_sink(sink);
+}
+
+void js_interpreter::set_determinism(
+    const std::optional<determinism_config>& config) noexcept
+{
+    _impl->set_determinism(config);
+}
+
+void js_interpreter::set_nondeterminism_flag(bool* flag) noexcept
+{
+    _impl->set_nondeterminism_flag(flag);
+}
+
+void js_interpreter::set_module_directory(
+    const std::string_view directory) noexcept
+{
+    _impl->set_module_directory(directory);
+}
+
+void js_interpreter::reset() noexcept
+{
+    _impl->reset();
+}
+
+std::uint64_t js_interpreter::get_execution_hash() const noexcept
+{
+    return _impl->get_execution_hash();
+}
+
+void js_interpreter::evaluate_pure(const std::span<const std::string> sources,
+    std::vector<std::optional<std::string>>& results) noexcept
+{
+    _impl->evaluate_pure(sources, results);
 }
 
 } // namespace majsdown
@@ -1,12 +1,23 @@
 #pragma once
 
+#include "majsdown/determinism.hpp"
+#include "majsdown/js_profile.hpp"
+
 #include <iosfwd>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
+
+#include <cstdint>
 
 namespace majsdown {
 
+class file_cache;
+class result_cache;
+
 class js_interpreter
 {
 private:
@@ -19,7 +30,8 @@ public:
         std::size_t _line;
     };
 
-    [[nodiscard]] explicit js_interpreter(std::ostream& err_stream);
+    [[nodiscard]] explicit js_interpreter(
+        std::ostream& err_stream, const js_profile profile = js_profile::full);
     ~js_interpreter();
 
     [[nodiscard]] std::optional<error> interpret(
@@ -28,10 +40,89 @@ public:
     [[nodiscard]] std::optional<error> interpret_discard(
         const std::string_view source) noexcept;
 
+    // Like `interpret` with `__mjsd(<expression>);`, but without compiling
+    // anything, for the most common shapes of inline expressions: globals
+    // declared with `var` or `function`, literals, and calls of such
+    // functions with literal arguments. Returns `false`, having done nothing,
+    // for any other shape, otherwise stores the outcome in `result`.
+    [[nodiscard]] bool interpret_trivial(std::string& output_buffer,
+        const std::string_view expression,
+        std::optional<error>& result) noexcept;
+
+    // Compiles `source` (null-terminated) as a global script, without running
+    // it, and stores its bytecode in `bytecode`.
+    [[nodiscard]] std::optional<error> compile(
+        const std::string_view source, std::string& bytecode) noexcept;
+
+    // Runs bytecode produced by `compile`, possibly by another interpreter.
+    [[nodiscard]] std::optional<error> run_bytecode(
+        std::string& output_buffer, const std::string_view bytecode) noexcept;
+
+    // Parses `json` (null-terminated) and binds the result to the global
+    // `name` (null-terminated).
+    [[nodiscard]] std::optional<error> set_global_json(
+        const std::string_view name, const std::string_view json) noexcept;
+
+    // Appends the file contents selected by `spec` (see `snippet_cache`) to
+    // `output_buffer`, without going through JS. Returns the reason on
+    // failure.
+    [[nodiscard]] std::optional<std::string> splice(
+        std::string& output_buffer, const std::string_view spec) noexcept;
+
     void set_current_diagnostics_line(const std::size_t line) noexcept;
 
     [[nodiscard]] std::size_t
     get_current_diagnostics_line_adjustment() noexcept;
+
+    // Serves `majsdown_include`, `majsdown_embed` and modules from `cache`,
+    // which must outlive the interpreter. Pass `nullptr` to always read from
+    // disk.
+    void set_file_cache(file_cache* cache) noexcept;
+
+    // Persists the values of `majsdown_memo` in `cache`, which must outlive
+    // the interpreter. Pass `nullptr` to always recompute them.
+    void set_memo_cache(result_cache* cache) noexcept;
+
+    // Appends the path of every file read by `majsdown_include` and
+    // `majsdown_embed` to `sink`, which must outlive the interpreter. Pass
+    // `nullptr` to stop recording.
+    void set_touched_files_sink(std::vector<std::string>* sink) noexcept;
+
+    // Freezes the clock and seeds `Math.random` with `config`, and restarts
+    // the random sequence. Pass `std::nullopt`, the default, to use the real
+    // clock and random numbers. `reset` also restarts the sequence.
+    void set_determinism(
+        const std::optional<determinism_config>& config) noexcept;
+
+    // Sets `*flag` to `true` whenever JS reads the real clock or random
+    // numbers, i.e. when the output must not be cached. `flag` must outlive
+    // the interpreter. Pass `nullptr` to stop.
+    void set_nondeterminism_flag(bool* flag) noexcept;
+
+    // Directory against which `majsdown_import` paths and non-relative
+    // `import` specifiers are resolved, e.g. the document's. Defaults to the
+    // working directory.
+    void set_module_directory(const std::string_view directory) noexcept;
+
+    // Discards all JS state, as if the interpreter had just been created.
+    void reset() noexcept;
+
+    // Hash of everything run since the last reset, in order. Interpreters
+    // with the same hash hold the same JS state, provided that the files read
+    // by JS did not change and that JS did not read the real clock or random
+    // numbers (see `set_nondeterminism_flag`).
+    [[nodiscard]] std::uint64_t get_execution_hash() const noexcept;
+
+    // Evaluates the expressions `sources`, which must not modify the JS state,
+    // concurrently on worker runtimes. Workers reproduce the interpreter's
+    // state by replaying everything it ran since the last reset, with the
+    // same profile and determinism settings. The values are stored in
+    // `results` as strings, or as `std::nullopt` for the expressions that
+    // need the interpreter itself: those reading the clock or random numbers,
+    // calling `majsdown_parallel_map` or `majsdown_memo`, following code a
+    // worker could not reproduce, or evaluating to objects.
+    void evaluate_pure(const std::span<const std::string> sources,
+        std::vector<std::optional<std::string>>& results) noexcept;
 };
 
 } // namespace majsdown
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+namespace majsdown {
+
+// Which JS built-ins a context is created with. Smaller profiles create
+// contexts faster and use less memory per context. Using a built-in that the
+// profile leaves out throws a `ReferenceError` naming the profile.
+enum class js_profile
+{
+    // Objects, functions, arrays, strings, numbers, `Math` and `JSON`
+    strings,
+
+    // Plus `Date`, `RegExp`, `Map`, `Set` and typed arrays
+    standard,
+
+    // Everything QuickJS provides, including `Proxy` and `Promise`
+    full
+};
+
+[[nodiscard]] inline constexpr std::string_view to_string(
+    const js_profile profile) noexcept
+{
+    switch (profile)
+    {
+        case js_profile::strings: return "strings";
+        case js_profile::standard: return "standard";
+        case js_profile::full: return "full";
+    }
+
+    return "full";
+}
+
+[[nodiscard]] inline constexpr std::optional<js_profile> parse_js_profile(
+    const std::string_view name) noexcept
+{
+    for (const js_profile profile :
+        {js_profile::strings, js_profile::standard, js_profile::full})
+    {
+        if (name == to_string(profile))
+        {
+            return profile;
+        }
+    }
+
+    return std::nullopt;
+}
+
+} // namespace majsdown
@@ -0,0 +1,480 @@
+#include "json.hpp"
+
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace majsdown {
+
+const json_value* json_value::find(const std::string_view key) const noexcept
+{
+    for (const auto& [k, v] : _object)
+    {
+        if (k == key)
+        {
+            return &v;
+        }
+    }
+
+    return nullptr;
+}
+
+bool json_value::is_null() const noexcept
+{
+    return _kind == kind::null;
+}
+
+bool json_value::is_boolean() const noexcept
+{
+    return _kind == kind::boolean;
+}
+
+bool json_value::is_string() const noexcept
+{
+    return _kind == kind::string;
+}
+
+bool json_value::is_object() const noexcept
+{
+    return _kind == kind::object;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace {
+
+class json_parser
+{
+private:
+    const std::string_view _source;
+    std::size_t _curr_idx;
+    std::size_t _depth;
+
+    static constexpr std::size_t max_depth = 256;
+
+    [[nodiscard]] bool is_done() const noexcept
+    {
+        return _curr_idx >= _source.size();
+    }
+
+    [[nodiscard]] char get_curr_char() const noexcept
+    {
+        assert(!is_done());
+        return _source[_curr_idx];
+    }
+
+    void skip_whitespace() noexcept
+    {
+        while (!is_done())
+        {
+            const char c = get_curr_char();
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            {
+                return;
+            }
+
+            ++_curr_idx;
+        }
+    }
+
+    [[nodiscard]] bool consume(const char c) noexcept
+    {
+        skip_whitespace();
+
+        if (is_done() || get_curr_char() != c)
+        {
+            return false;
+        }
+
+        ++_curr_idx;
+        return true;
+    }
+
+    [[nodiscard]] bool consume_literal(const std::string_view literal) noexcept
+    {
+        if (_source.substr(_curr_idx, literal.size()) != literal)
+        {
+            return false;
+        }
+
+        _curr_idx += literal.size();
+        return true;
+    }
+
+    [[nodiscard]] std::optional<std::uint32_t> parse_hex4() noexcept
+    {
+        if (_curr_idx + 4 > _source.size())
+        {
+            return std::nullopt;
+        }
+
+        std::uint32_t result = 0;
+        const char* const begin = _source.data() + _curr_idx;
+        const auto [ptr, ec] = std::from_chars(begin, begin + 4, result, 16);
+
+        if (ec != std::errc{} || ptr != begin + 4)
+        {
+            return std::nullopt;
+        }
+
+        _curr_idx += 4;
+        return result;
+    }
+
+    static void append_utf8(std::string& output, const std::uint32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            output.append(1, static_cast<char>(cp));
+        }
+        else if (cp < 0x800)
+        {
+            output.append(1, static_cast<char>(0xC0 | (cp >> 6)));
+            output.append(1, static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000)
+        {
+            output.append(1, static_cast<char>(0xE0 | (cp >> 12)));
+            output.append(1, static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            output.append(1, static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            output.append(1, static_cast<char>(0xF0 | (cp >> 18)));
+            output.append(1, static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            output.append(1, static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            output.append(1, static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    [[nodiscard]] bool parse_string(std::string& output)
+    {
+        if (!consume('"'))
+        {
+            return false;
+        }
+
+        while (!is_done())
+        {
+            const char c = get_curr_char();
+            ++_curr_idx;
+
+            if (c == '"')
+            {
+                return true;
+            }
+
+            if (c != '\\')
+            {
+                output.append(1, c);
+                continue;
+            }
+
+            if (is_done())
+            {
+                return false;
+            }
+
+            const char escaped = get_curr_char();
+            ++_curr_idx;
+
+            switch (escaped)
+            {
+                case '"': output.append(1, '"'); break;
+                case '\\': output.append(1, '\\'); break;
+                case '/': output.append(1, '/'); break;
+                case 'b': output.append(1, '\b'); break;
+                case 'f': output.append(1, '\f'); break;
+                case 'n': output.append(1, '\n'); break;
+                case 'r': output.append(1, '\r'); break;
+                case 't': output.append(1, '\t'); break;
+                case 'u':
+                {
+                    std::optional<std::uint32_t> cp = parse_hex4();
+                    if (!cp.has_value())
+                    {
+                        return false;
+                    }
+
+                    // Combine UTF-16 surrogate pairs
+                    if (*cp >= 0xD800 && *cp < 0xDC00 &&
+                        consume_literal("\\u"))
+                    {
+                        const std::optional<std::uint32_t> low = parse_hex4();
+                        if (!low.has_value())
+                        {
+                            return false;
+                        }
+
+                        *cp = 0x10000 + ((*cp - 0xD800) << 10) +
+                              (*low - 0xDC00);
+                    }
+
+                    append_utf8(output, *cp);
+                    break;
+                }
+                default: return false;
+            }
+        }
+
+        return false;
+    }
+
+    [[nodiscard]] bool parse_number(double& output) noexcept
+    {
+        const std::size_t start_idx = _curr_idx;
+
+        while (!is_done())
+        {
+            const char c = get_curr_char();
+            if ((c < '0' || c > '9') && c != '-' && c != '+' && c != '.' &&
+                c != 'e' && c != 'E')
+            {
+                break;
+            }
+
+            ++_curr_idx;
+        }
+
+        const char* const begin = _source.data() + start_idx;
+        const char* const end = _source.data() + _curr_idx;
+
+        const auto [ptr, ec] = std::from_chars(begin, end, output);
+        return ec == std::errc{} && ptr == end;
+    }
+
+    [[nodiscard]] bool parse_array(json_value& output)
+    {
+        output._kind = json_value::kind::array;
+
+        if (consume(']'))
+        {
+            return true;
+        }
+
+        do
+        {
+            if (!parse_value(output._array.emplace_back()))
+            {
+                return false;
+            }
+        }
+        while (consume(','));
+
+        return consume(']');
+    }
+
+    [[nodiscard]] bool parse_object(json_value& output)
+    {
+        output._kind = json_value::kind::object;
+
+        if (consume('}'))
+        {
+            return true;
+        }
+
+        do
+        {
+            auto& [key, value] = output._object.emplace_back();
+
+            if (!parse_string(key) || !consume(':') || !parse_value(value))
+            {
+                return false;
+            }
+        }
+        while (consume(','));
+
+        return consume('}');
+    }
+
+    [[nodiscard]] bool parse_value(json_value& output)
+    {
+        skip_whitespace();
+
+        if (is_done() || _depth >= max_depth)
+        {
+            return false;
+        }
+
+        const char c = get_curr_char();
+
+        if (c == '"')
+        {
+            output._kind = json_value::kind::string;
+            return parse_string(output._string);
+        }
+
+        if (c == '{' || c == '[')
+        {
+            ++_curr_idx;
+            ++_depth;
+
+            const bool ok =
+                c == '{' ? parse_object(output) : parse_array(output);
+
+            --_depth;
+            return ok;
+        }
+
+        if (consume_literal("true") || consume_literal("false"))
+        {
+            output._kind = json_value::kind::boolean;
+            output._boolean = c == 't';
+            return true;
+        }
+
+        if (consume_literal("null"))
+        {
+            output._kind = json_value::kind::null;
+            return true;
+        }
+
+        output._kind = json_value::kind::number;
+        return parse_number(output._number);
+    }
+
+public:
+    [[nodiscard]] explicit json_parser(const std::string_view source) noexcept
+        : _source{source}, _curr_idx{0}, _depth{0}
+    {}
+
+    [[nodiscard]] std::optional<json_value> parse()
+    {
+        json_value result;
+
+        if (!parse_value(result))
+        {
+            return std::nullopt;
+        }
+
+        skip_whitespace();
+
+        if (!is_done())
+        {
+            return std::nullopt;
+        }
+
+        return result;
+    }
+};
+
+} // namespace
+
+std::optional<json_value> parse_json(const std::string_view source) noexcept
+{
+    try
+    {
+        return json_parser{source}.parse();
+    }
+    catch (...)
+    {
+        return std::nullopt;
+    }
+}
+
+void append_json_string(std::string& output, const std::string_view value)
+{
+    output.append(1, '"');
+
+    for (const char c : value)
+    {
+        switch (c)
+        {
+            case '"': output.append("\\\""); break;
+            case '\\': output.append("\\\\"); break;
+            case '\b': output.append("\\b"); break;
+            case '\f': output.append("\\f"); break;
+            case '\n': output.append("\\n"); break;
+            case '\r': output.append("\\r"); break;
+            case '\t': output.append("\\t"); break;
+            default:
+            {
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x",
+                        static_cast<unsigned int>(c));
+
+                    output.append(buf);
+                    break;
+                }
+
+                output.append(1, c);
+            }
+        }
+    }
+
+    output.append(1, '"');
+}
+
+void append_json(std::string& output, const json_value& value)
+{
+    switch (value._kind)
+    {
+        case json_value::kind::null: output.append("null"); return;
+
+        case json_value::kind::boolean:
+            output.append(value._boolean ? "true" : "false");
+            return;
+
+        case json_value::kind::number:
+        {
+            char buf[32];
+            const auto [ptr, ec] =
+                std::to_chars(buf, buf + sizeof(buf), value._number);
+
+            output.append(buf, ec == std::errc{} ? ptr : buf);
+            return;
+        }
+
+        case json_value::kind::string:
+            append_json_string(output, value._string);
+            return;
+
+        case json_value::kind::array:
+        {
+            output.append(1, '[');
+
+            for (std::size_t i = 0; i < value._array.size(); ++i)
+            {
+                if (i != 0)
+                {
+                    output.append(1, ',');
+                }
+
+                append_json(output, value._array[i]);
+            }
+
+            output.append(1, ']');
+            return;
+        }
+
+        case json_value::kind::object:
+        {
+            output.append(1, '{');
+
+            for (std::size_t i = 0; i < value._object.size(); ++i)
+            {
+                if (i != 0)
+                {
+                    output.append(1, ',');
+                }
+
+                append_json_string(output, value._object[i].first);
+                output.append(1, ':');
+                append_json(output, value._object[i].second);
+            }
+
+            output.append(1, '}');
+            return;
+        }
+    }
+}
+
+} // namespace majsdown
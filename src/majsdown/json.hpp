@@ -0,0 +1,50 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace majsdown {
+
+// Minimal JSON document model, used by the daemon protocol. Documents handed
+// to JavaScript are parsed by the interpreter itself.
+struct json_value
+{
+    enum class kind
+    {
+        null,
+        boolean,
+        number,
+        string,
+        array,
+        object
+    };
+
+    kind _kind = kind::null;
+    bool _boolean = false;
+    double _number = 0.0;
+    std::string _string;
+    std::vector<json_value> _array;
+    std::vector<std::pair<std::string, json_value>> _object;
+
+    [[nodiscard]] const json_value* find(
+        const std::string_view key) const noexcept;
+
+    [[nodiscard]] bool is_null() const noexcept;
+    [[nodiscard]] bool is_boolean() const noexcept;
+    [[nodiscard]] bool is_string() const noexcept;
+    [[nodiscard]] bool is_object() const noexcept;
+};
+
+[[nodiscard]] std::optional<json_value> parse_json(
+    const std::string_view source) noexcept;
+
+// Appends `value` as a quoted and escaped JSON string literal.
+void append_json_string(std::string& output, const std::string_view value);
+
+// Appends `value` serialized as compact JSON.
+void append_json(std::string& output, const json_value& value);
+
+} // namespace majsdown
@@ -0,0 +1,210 @@
+#include "mapped_file.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace majsdown {
+
+mapped_file::mapped_file() noexcept : _mapping{nullptr}, _size{0}
+{}
+
+mapped_file::~mapped_file()
+{
+#if !defined(_WIN32)
+    if (_mapping != nullptr)
+    {
+        ::munmap(_mapping, _size + 1);
+    }
+#endif
+}
+
+#if !defined(_WIN32)
+
+// Below this size, copying is cheaper than setting up a mapping, and the
+// copy is immune to later changes to the file.
+static constexpr std::size_t min_mapped_size = 64 * 1024;
+
+// Maps the first `size` bytes of `fd` into a private region one byte larger,
+// and writes the terminating null byte there. The byte past the contents is
+// never read from the file, whose last page may change or hold more data.
+[[nodiscard]] static void* map_with_terminator(
+    const int fd, const std::size_t size) noexcept
+{
+    void* const region = ::mmap(nullptr, size + 1, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (region == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    if (::mmap(region, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+            fd, 0) == MAP_FAILED)
+    {
+        ::munmap(region, size + 1);
+        return nullptr;
+    }
+
+    static_cast<char*>(region)[size] = '\0';
+    return region;
+}
+
+[[nodiscard]] static bool same_version(
+    const struct stat& lhs, const struct stat& rhs) noexcept
+{
+    return lhs.st_size == rhs.st_size && lhs.st_mtime == rhs.st_mtime;
+}
+
+[[nodiscard]] static bool read_all(const int fd, std::string& result) noexcept
+{
+    char chunk[64 * 1024];
+
+    while (true)
+    {
+        const ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n == 0)
+        {
+            return true;
+        }
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        try
+        {
+            result.append(chunk, static_cast<std::size_t>(n));
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+}
+
+bool mapped_file::open(const std::string& path) noexcept
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat before;
+    if (::fstat(fd, &before) == 0 && S_ISREG(before.st_mode) &&
+        static_cast<std::uintmax_t>(before.st_size) >= min_mapped_size)
+    {
+        const auto size = static_cast<std::size_t>(before.st_size);
+        void* const mapping = map_with_terminator(fd, size);
+
+        // A file written to meanwhile is copied instead, up to its end
+        struct stat after;
+        if (mapping != nullptr && ::fstat(fd, &after) == 0 &&
+            same_version(before, after))
+        {
+            ::close(fd);
+
+            _mapping = mapping;
+            _size = size;
+            return true;
+        }
+
+        if (mapping != nullptr)
+        {
+            ::munmap(mapping, size + 1);
+        }
+    }
+
+    _copy.clear();
+    const bool success = read_all(fd, _copy);
+    ::close(fd);
+
+    _size = _copy.size();
+    return success;
+}
+
+#else
+
+bool mapped_file::open(const std::string& path) noexcept
+{
+    std::ifstream ifs{path, std::ios::binary};
+    if (!ifs)
+    {
+        return false;
+    }
+
+    _copy.assign(
+        std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{});
+
+    _size = _copy.size();
+    return !ifs.bad();
+}
+
+#endif
+
+const char* mapped_file::data() const noexcept
+{
+    return _mapping != nullptr ? static_cast<const char*>(_mapping)
+                               : _copy.data();
+}
+
+char* mapped_file::mutable_data() noexcept
+{
+    return _mapping != nullptr ? static_cast<char*>(_mapping) : _copy.data();
+}
+
+std::size_t mapped_file::size() const noexcept
+{
+    return _size;
+}
+
+std::string_view mapped_file::view() const noexcept
+{
+    return {data(), _size};
+}
+
+std::optional<mapped_file::stamp> mapped_file::get_stamp(
+    const std::string& path) noexcept
+{
+    std::error_code ec;
+
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+    {
+        return std::nullopt;
+    }
+
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec)
+    {
+        return std::nullopt;
+    }
+
+    return stamp{
+        ._mtime = static_cast<std::int64_t>(mtime.time_since_epoch().count()),
+        ._size = size};
+}
+
+} // namespace majsdown
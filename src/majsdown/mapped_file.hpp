@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace majsdown {
+
+// Read-only contents of a whole file. Large files are memory-mapped so that
+// they are not copied, small ones and files changing while being opened are
+// read into memory. The contents are always followed by a null byte, as
+// required by the QuickJS parsers, which is never read from the file.
+//
+// As with any mapping, truncating a mapped file in place makes accesses past
+// its new end raise `SIGBUS`. Long-lived holders (e.g. `snippet_cache`) check
+// the file's stamp before each use and reopen changed files, which narrows
+// that window to concurrent truncations; files replaced by a rename, as most
+// editors and build tools do, are never affected.
+class mapped_file
+{
+public:
+    // Identifies a version of a file, to revalidate data derived from it.
+    struct stamp
+    {
+        std::int64_t _mtime;
+        std::uintmax_t _size;
+
+        [[nodiscard]] bool operator==(const stamp&) const = default;
+    };
+
+private:
+    void* _mapping;
+    std::size_t _size;
+    std::string _copy; // Used when the file is not mapped
+
+public:
+    [[nodiscard]] mapped_file() noexcept;
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    // Returns `false` if the file cannot be read.
+    [[nodiscard]] bool open(const std::string& path) noexcept;
+
+    [[nodiscard]] const char* data() const noexcept;
+
+    // Writes are private to this object, mappings are copy-on-write.
+    [[nodiscard]] char* mutable_data() noexcept;
+
+    [[nodiscard]] std::size_t size() const noexcept;
+    [[nodiscard]] std::string_view view() const noexcept;
+
+    // Returns `std::nullopt` if the file does not exist.
+    [[nodiscard]] static std::optional<stamp> get_stamp(
+        const std::string& path) noexcept;
+};
+
+} // namespace majsdown
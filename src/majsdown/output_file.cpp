@@ -0,0 +1,83 @@
+#include "output_file.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <cstdint>
+
+namespace majsdown {
+
+namespace fs = std::filesystem;
+
+[[nodiscard]] static std::ostream& error_diagnostic_stream(std::ostream& os)
+{
+    return os << "((MJSD ERROR))(OUTPUT): ";
+}
+
+bool write_file(const std::string_view path, const std::string_view contents,
+    std::ostream& err_stream) noexcept
+{
+    const std::string tmp_path = std::string{path} + ".tmp";
+
+    {
+        std::ofstream ofs{tmp_path, std::ios::binary | std::ios::trunc};
+        ofs.write(
+            contents.data(), static_cast<std::streamsize>(contents.size()));
+        ofs.close();
+
+        if (!ofs)
+        {
+            error_diagnostic_stream(err_stream)
+                << "Failed to write file '" << tmp_path << "'\n\n";
+
+            std::error_code ec;
+            fs::remove(tmp_path, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp_path, std::string{path}, ec);
+
+    if (ec)
+    {
+        error_diagnostic_stream(err_stream)
+            << "Failed to replace file '" << path << "' (" << ec.message()
+            << ")\n\n";
+
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+
+    return true;
+}
+
+bool write_file_if_changed(const std::string_view path,
+    const std::string_view contents, std::ostream& err_stream) noexcept
+{
+    const std::string path_str{path};
+
+    std::error_code ec;
+    const std::uintmax_t existing_size = fs::file_size(path_str, ec);
+
+    if (!ec && existing_size == contents.size())
+    {
+        std::ifstream ifs{path_str, std::ios::binary};
+        std::string existing(contents.size(), '\0');
+
+        if (ifs.read(existing.data(),
+                static_cast<std::streamsize>(existing.size())) &&
+            existing == contents)
+        {
+            return true;
+        }
+    }
+
+    return write_file(path, contents, err_stream);
+}
+
+} // namespace majsdown
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <iosfwd>
+#include <string_view>
+
+namespace majsdown {
+
+// Replaces the contents of `path` atomically, so that readers never observe
+// a partially written file. Returns `false` on I/O errors, which are reported
+// to `err_stream`.
+[[nodiscard]] bool write_file(const std::string_view path,
+    const std::string_view contents, std::ostream& err_stream) noexcept;
+
+// Like `write_file`, but leaves `path` (and its modification time) untouched
+// if it already holds `contents`.
+[[nodiscard]] bool write_file_if_changed(const std::string_view path,
+    const std::string_view contents, std::ostream& err_stream) noexcept;
+
+} // namespace majsdown
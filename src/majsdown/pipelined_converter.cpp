@@ -0,0 +1,162 @@
+#include "pipelined_converter.hpp"
+
+#include "majsdown/converter.hpp"
+#include "majsdown/spsc_queue.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace majsdown {
+
+namespace {
+
+// Unit of work handed from the first pass to the second one.
+struct chunk
+{
+    std::string _text;
+    std::string _statements; // Executed by the first pass up to `_text`'s end
+    bool _last = false;
+};
+
+// Enough to absorb bursts without letting the first pass run far ahead
+constexpr std::size_t queue_capacity = 16;
+
+} // namespace
+
+int convert_all_passes_pipelined(std::string& buffer,
+    std::ostream& err_stream, const converter_setup& setup,
+    const std::size_t chunk_size) noexcept
+{
+    spsc_queue<chunk> queue{queue_capacity};
+
+    std::ostringstream first_diagnostics;
+    bool first_ok = false;
+
+    std::thread first_thread{[&]
+        {
+            // The interpreter must be created on the thread using it
+            converter cnvtr{first_diagnostics};
+
+            std::string statements;
+            cnvtr.set_statement_sink(&statements);
+
+            first_ok = setup(cnvtr, 1) &&
+                       cnvtr.convert_chunked(first_pass_config, buffer,
+                           chunk_size,
+                           [&](std::string& text)
+                           {
+                               chunk c;
+                               c._text = std::move(text);
+                               c._statements = std::move(statements);
+                               statements.clear();
+
+                               queue.push(std::move(c));
+                           });
+
+            chunk last;
+            last._last = true;
+            queue.push(std::move(last));
+        }};
+
+    std::ostringstream second_diagnostics;
+    converter cnvtr{second_diagnostics};
+    bool second_ok = setup(cnvtr, 2);
+
+    std::string output;
+    output.reserve(buffer.size() + 1024);
+
+    // Text received but not converted yet, as a directive may continue in
+    // the next chunk
+    std::string pending;
+    std::string pending_statements;
+    std::size_t n_converted_lines = 0;
+    std::vector<converter::segment> discarded_segments;
+
+    const auto convert_pending = [&]
+    {
+        if (!pending_statements.empty())
+        {
+            second_ok = cnvtr.evaluate(pending_statements);
+            pending_statements.clear();
+        }
+
+        second_ok = second_ok && cnvtr.convert(second_pass_config, output,
+                                     pending, n_converted_lines);
+
+        n_converted_lines += static_cast<std::size_t>(
+            std::count(pending.begin(), pending.end(), '\n'));
+
+        pending.clear();
+    };
+
+    while (true)
+    {
+        chunk c = queue.pop();
+
+        // Keep draining so that the first pass never blocks forever
+        if (!second_ok)
+        {
+            if (c._last)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        // The pending text can be converted on its own if it ends on a line
+        // boundary, does not end inside a directive, and the next chunk does
+        // not continue a run of statements
+        if (!pending.empty() && pending.back() == '\n' &&
+            !c._text.starts_with("@@$"))
+        {
+            discarded_segments.clear();
+
+            if (cnvtr.find_segments(
+                    second_pass_config, pending, discarded_segments))
+            {
+                convert_pending();
+            }
+        }
+
+        pending.append(c._text);
+        pending_statements.append(c._statements);
+
+        if (c._last)
+        {
+            if (second_ok)
+            {
+                convert_pending();
+            }
+
+            break;
+        }
+    }
+
+    first_thread.join();
+
+    err_stream << first_diagnostics.str();
+
+    if (!first_ok)
+    {
+        return 1;
+    }
+
+    err_stream << second_diagnostics.str();
+
+    if (!second_ok)
+    {
+        return 2;
+    }
+
+    buffer.swap(output);
+    return 0;
+}
+
+} // namespace majsdown
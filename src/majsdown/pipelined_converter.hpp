@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace majsdown {
+
+class converter;
+
+// Prepares the converter dedicated to pass `pass_index` (`1` or `2`), e.g. by
+// evaluating a prelude. Called concurrently from both pass threads. Returning
+// `false` fails that pass.
+using converter_setup = std::function<bool(converter&, int pass_index)>;
+
+// Runs the two standard passes concurrently: the first pass runs on its own
+// thread and hands its output over in chunks of about `chunk_size` bytes as
+// soon as they are final, while the calling thread runs the second pass over
+// them. Each pass has its own interpreter.
+//
+// The statements executed by the first pass are replayed in the second pass'
+// interpreter before it converts the corresponding chunk, so decorators can
+// still use helpers defined by the document. Unlike `convert_all_passes`,
+// the second pass does not observe later redefinitions or state mutated by
+// expressions.
+//
+// Same contract as `converter::convert_all_passes` otherwise. Diagnostics of
+// both passes are written to `err_stream` once both have finished.
+[[nodiscard]] int convert_all_passes_pipelined(std::string& buffer,
+    std::ostream& err_stream, const converter_setup& setup,
+    const std::size_t chunk_size = 64 * 1024) noexcept;
+
+} // namespace majsdown
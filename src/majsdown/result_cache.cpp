@@ -0,0 +1,393 @@
+#include "result_cache.hpp"
+
+#include "majsdown/converter.hpp"
+#include "majsdown/hash.hpp"
+#include "majsdown/version.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <cstdint>
+
+namespace majsdown {
+
+namespace fs = std::filesystem;
+
+static constexpr std::string_view entry_magic = "majsdown-result-cache 1";
+static constexpr std::string_view memo_magic = "majsdown-memo 1";
+static constexpr std::string_view entry_extension = ".entry";
+static constexpr std::string_view tmp_prefix = "tmp-";
+
+[[nodiscard]] static std::ostream& error_diagnostic_stream(std::ostream& os)
+{
+    return os << "((MJSD ERROR))(CACHE): ";
+}
+
+[[nodiscard]] static std::string to_hex(const std::uint64_t value)
+{
+    char buffer[16];
+    const auto [ptr, ec] = std::to_chars(buffer, buffer + 16, value, 16);
+
+    std::string result(16 - (ptr - buffer), '0');
+    result.append(buffer, ptr);
+    return result;
+}
+
+[[nodiscard]] static std::optional<std::uint64_t> parse_u64(
+    const std::string_view sv, const int base)
+{
+    std::uint64_t result;
+    const auto [ptr, ec] =
+        std::from_chars(sv.data(), sv.data() + sv.size(), result, base);
+
+    if (ec != std::errc{} || ptr != sv.data() + sv.size())
+    {
+        return std::nullopt;
+    }
+
+    return result;
+}
+
+[[nodiscard]] static std::optional<std::uint64_t> hash_file(
+    const std::string& path)
+{
+    std::ifstream ifs{path, std::ios::binary};
+    if (!ifs)
+    {
+        return std::nullopt;
+    }
+
+    const std::string contents{
+        std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    return hash_combine(hash_bytes(contents), contents.size());
+}
+
+[[nodiscard]] static std::uint64_t hash_config(
+    std::uint64_t seed, const converter::config& cfg) noexcept
+{
+    const std::uint64_t bits =
+        (std::uint64_t{cfg.skip_escaped_symbols} << 0) |
+        (std::uint64_t{cfg.skip_inline_expressions} << 1) |
+        (std::uint64_t{cfg.skip_inline_statements} << 2) |
+        (std::uint64_t{cfg.skip_block_statements} << 3) |
+        (std::uint64_t{cfg.skip_code_block_decorators} << 4) |
+        (std::uint64_t{cfg.skip_splice_directives} << 5);
+
+    return hash_combine(seed, bits);
+}
+
+// ----------------------------------------------------------------------------
+
+result_cache::result_cache(const std::string_view directory,
+    const std::uintmax_t max_size_bytes, std::ostream& err_stream)
+    : _directory{directory},
+      _max_size_bytes{max_size_bytes},
+      _err_stream{err_stream},
+      _valid{true}
+{
+    std::error_code ec;
+    fs::create_directories(_directory, ec);
+
+    if (ec)
+    {
+        error_diagnostic_stream(_err_stream)
+            << "Cannot create cache directory '" << _directory
+            << "' (" << ec.message() << "), caching disabled\n\n";
+
+        _valid = false;
+    }
+}
+
+std::string result_cache::get_entry_path(const std::uint64_t key) const
+{
+    return (fs::path{_directory} /
+            (to_hex(key) + std::string{entry_extension}))
+        .string();
+}
+
+std::uint64_t result_cache::compute_key(const std::string_view source,
+    const std::string_view prelude, const std::uint64_t variant) noexcept
+{
+    std::uint64_t result = hash_bytes(entry_magic);
+    result = hash_bytes(build_id, result);
+    result = hash_config(result, first_pass_config);
+    result = hash_config(result, second_pass_config);
+    result = hash_combine(result, source.size());
+    result = hash_bytes(source, result);
+    result = hash_combine(result, prelude.size());
+    result = hash_bytes(prelude, result);
+    result = hash_combine(result, variant);
+
+    return result;
+}
+
+std::uint64_t result_cache::compute_memo_key(
+    const std::string_view key) noexcept
+{
+    std::uint64_t result = hash_bytes(memo_magic);
+    result = hash_bytes(build_id, result);
+    result = hash_combine(result, key.size());
+    result = hash_bytes(key, result);
+
+    return result;
+}
+
+bool result_cache::write_cached_output(const std::uint64_t key,
+    std::ostream& os, std::vector<std::string>* touched_files) noexcept
+{
+    if (!_valid)
+    {
+        return false;
+    }
+
+    const std::string path = get_entry_path(key);
+
+    std::ifstream ifs{path, std::ios::binary};
+    if (!ifs)
+    {
+        return false;
+    }
+
+    std::string line;
+
+    if (!std::getline(ifs, line) || line != entry_magic ||
+        !std::getline(ifs, line) || line != to_hex(key) ||
+        !std::getline(ifs, line))
+    {
+        return false;
+    }
+
+    const std::optional<std::uint64_t> n_dependencies = parse_u64(line, 10);
+    if (!n_dependencies.has_value())
+    {
+        return false;
+    }
+
+    std::vector<std::string> dependencies;
+
+    // Every touched file must still have the same contents
+    for (std::uint64_t i = 0; i < *n_dependencies; ++i)
+    {
+        if (!std::getline(ifs, line))
+        {
+            return false;
+        }
+
+        const std::size_t separator = line.find(' ');
+        if (separator == std::string::npos)
+        {
+            return false;
+        }
+
+        const std::optional<std::uint64_t> expected_hash =
+            parse_u64(std::string_view{line}.substr(0, separator), 16);
+
+        if (!expected_hash.has_value() ||
+            hash_file(line.substr(separator + 1)) != expected_hash)
+        {
+            return false;
+        }
+
+        dependencies.push_back(line.substr(separator + 1));
+    }
+
+    if (!std::getline(ifs, line))
+    {
+        return false;
+    }
+
+    const std::optional<std::uint64_t> output_size = parse_u64(line, 10);
+    const std::streamoff output_begin = ifs.tellg();
+
+    std::error_code ec;
+    const std::uintmax_t file_size = fs::file_size(path, ec);
+
+    if (!output_size.has_value() || output_begin < 0 || ec ||
+        file_size - static_cast<std::uintmax_t>(output_begin) != *output_size)
+    {
+        return false;
+    }
+
+    if (*output_size > 0)
+    {
+        os << ifs.rdbuf();
+    }
+
+    // Mark as recently used for eviction purposes
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+    if (touched_files != nullptr)
+    {
+        touched_files->insert(touched_files->end(),
+            std::make_move_iterator(dependencies.begin()),
+            std::make_move_iterator(dependencies.end()));
+    }
+
+    return true;
+}
+
+void result_cache::store(const std::uint64_t key,
+    const std::vector<std::string>& touched_files,
+    const std::string_view output) noexcept
+{
+    if (!_valid)
+    {
+        return;
+    }
+
+    std::vector<std::string> dependencies = touched_files;
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()),
+        dependencies.end());
+
+    std::string header;
+    header.append(entry_magic);
+    header.append(1, '\n');
+    header.append(to_hex(key));
+    header.append(1, '\n');
+    header.append(std::to_string(dependencies.size()));
+    header.append(1, '\n');
+
+    for (const std::string& dependency : dependencies)
+    {
+        const std::optional<std::uint64_t> hash = hash_file(dependency);
+
+        if (!hash.has_value() || dependency.find('\n') != std::string::npos)
+        {
+            return;
+        }
+
+        header.append(to_hex(*hash));
+        header.append(1, ' ');
+        header.append(dependency);
+        header.append(1, '\n');
+    }
+
+    header.append(std::to_string(output.size()));
+    header.append(1, '\n');
+
+    // Write to a unique temporary file, then publish it atomically
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+
+    const std::string tmp_path =
+        (fs::path{_directory} /
+            (std::string{tmp_prefix} + to_hex(rng()) + '-' + to_hex(key)))
+            .string();
+
+    {
+        std::ofstream ofs{tmp_path, std::ios::binary | std::ios::trunc};
+        ofs.write(header.data(), static_cast<std::streamsize>(header.size()));
+        ofs.write(output.data(), static_cast<std::streamsize>(output.size()));
+        ofs.close();
+
+        std::error_code ec;
+
+        if (!ofs)
+        {
+            fs::remove(tmp_path, ec);
+            return;
+        }
+
+        fs::rename(tmp_path, get_entry_path(key), ec);
+
+        if (ec)
+        {
+            fs::remove(tmp_path, ec);
+            return;
+        }
+    }
+
+    evict_if_needed();
+}
+
+void result_cache::evict_if_needed() noexcept
+{
+    struct entry_info
+    {
+        fs::path _path;
+        fs::file_time_type _mtime;
+        std::uintmax_t _size;
+    };
+
+    std::vector<entry_info> entries;
+    std::uintmax_t total_size = 0;
+
+    const auto now = fs::file_time_type::clock::now();
+    std::error_code ec;
+
+    for (fs::directory_iterator it{_directory, ec}, end; !ec && it != end;
+         it.increment(ec))
+    {
+        const fs::path& path = it->path();
+        const std::string filename = path.filename().string();
+
+        std::error_code entry_ec;
+        const fs::file_time_type mtime = it->last_write_time(entry_ec);
+        const std::uintmax_t size = it->file_size(entry_ec);
+
+        if (entry_ec)
+        {
+            continue; // Removed by a concurrent process
+        }
+
+        // Leftovers of writers that died before publishing their entry
+        if (filename.starts_with(tmp_prefix))
+        {
+            if (now - mtime > std::chrono::hours{1})
+            {
+                fs::remove(path, entry_ec);
+            }
+
+            continue;
+        }
+
+        if (!filename.ends_with(entry_extension))
+        {
+            continue;
+        }
+
+        entries.push_back(
+            entry_info{._path = path, ._mtime = mtime, ._size = size});
+
+        total_size += size;
+    }
+
+    if (total_size <= _max_size_bytes)
+    {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(),
+        [](const entry_info& a, const entry_info& b)
+        { return a._mtime < b._mtime; });
+
+    // Leave some headroom to avoid rescanning on every store
+    const std::uintmax_t target_size = _max_size_bytes / 10 * 9;
+
+    for (const entry_info& entry : entries)
+    {
+        if (total_size <= target_size)
+        {
+            break;
+        }
+
+        if (fs::remove(entry._path, ec))
+        {
+            total_size -= entry._size;
+        }
+    }
+}
+
+} // namespace majsdown
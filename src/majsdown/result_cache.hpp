@@ -0,0 +1,67 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+namespace majsdown {
+
+// On-disk cache of whole-document conversion results, shared by concurrent
+// converter processes.
+//
+// An entry is keyed on the source, the prelude, the pass configuration and
+// the build (see `build_id`), and records the contents hash of every file read
+// through `majsdown_include` or `majsdown_embed`. A lookup only hits if all
+// those files are unchanged.
+//
+// Entries are published with an atomic rename, so readers never observe a
+// partially written entry. Hits refresh the entry's modification time, and
+// the least recently used entries are evicted once the directory grows past
+// `max_size_bytes`.
+//
+// The same directory also holds the values memoized by `majsdown_memo`.
+class result_cache
+{
+private:
+    std::string _directory;
+    std::uintmax_t _max_size_bytes;
+    std::ostream& _err_stream;
+    bool _valid;
+
+    [[nodiscard]] std::string get_entry_path(const std::uint64_t key) const;
+
+    void evict_if_needed() noexcept;
+
+public:
+    [[nodiscard]] explicit result_cache(const std::string_view directory,
+        const std::uintmax_t max_size_bytes, std::ostream& err_stream);
+
+    // `variant` identifies other options affecting the output (e.g. HTML
+    // rendering flags).
+    [[nodiscard]] static std::uint64_t compute_key(
+        const std::string_view source, const std::string_view prelude,
+        const std::uint64_t variant = 0) noexcept;
+
+    // Key of the value memoized by `majsdown_memo` under `key`, which never
+    // matches a document's.
+    [[nodiscard]] static std::uint64_t compute_memo_key(
+        const std::string_view key) noexcept;
+
+    // Streams the cached output for `key` to `os`. Returns `false` on a miss,
+    // in which case nothing is written. On hits, the files touched by the
+    // original conversion are appended to `touched_files` if not null.
+    [[nodiscard]] bool write_cached_output(const std::uint64_t key,
+        std::ostream& os,
+        std::vector<std::string>* touched_files = nullptr) noexcept;
+
+    // Stores `output` for `key`. Silently does nothing if some touched file
+    // cannot be read anymore.
+    void store(const std::uint64_t key,
+        const std::vector<std::string>& touched_files,
+        const std::string_view output) noexcept;
+};
+
+} // namespace majsdown
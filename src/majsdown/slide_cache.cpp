@@ -0,0 +1,75 @@
+#include "slide_cache.hpp"
+
+#include "majsdown/hash.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace majsdown {
+
+slide_cache::slide_cache(const std::size_t max_idle_renders) noexcept
+    : _max_idle_renders{max_idle_renders}, _n_renders{0}, _stats{}
+{}
+
+std::uint64_t slide_cache::compute_key(
+    const std::string_view markdown, const unsigned int flags) noexcept
+{
+    return hash_combine(hash_bytes(markdown), flags);
+}
+
+slide_cache::shared_html slide_cache::find(
+    const std::uint64_t key, const std::string_view markdown)
+{
+    const auto it = _entries.find(key);
+
+    if (it == _entries.end() || it->second._markdown != markdown)
+    {
+        ++_stats._misses;
+        return nullptr;
+    }
+
+    ++_stats._hits;
+    it->second._last_used = _n_renders;
+    return it->second._html;
+}
+
+void slide_cache::store(const std::uint64_t key,
+    const std::string_view markdown, shared_html html)
+{
+    entry& e = _entries[key];
+    e._markdown.assign(markdown);
+    e._html = std::move(html);
+    e._last_used = _n_renders;
+}
+
+void slide_cache::end_render()
+{
+    for (auto it = _entries.begin(); it != _entries.end();)
+    {
+        if (_n_renders - it->second._last_used >= _max_idle_renders)
+        {
+            it = _entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    ++_n_renders;
+}
+
+std::size_t slide_cache::get_n_entries() const noexcept
+{
+    return _entries.size();
+}
+
+slide_cache::stats slide_cache::get_stats() const noexcept
+{
+    return _stats;
+}
+
+} // namespace majsdown
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace majsdown {
+
+// In-memory cache of rendered slides, kept by long-lived processes so that
+// re-rendering an edited deck only renders the slides that changed.
+//
+// Entries are keyed on a hash of the slide's Markdown and of the Discount
+// flags, and keep the Markdown itself to rule out collisions. Entries unused
+// by the last `max_idle_renders` decks are dropped. Not thread-safe: lookups
+// and stores happen on the thread that splits the deck.
+class slide_cache
+{
+public:
+    using shared_html = std::shared_ptr<const std::string>;
+
+    struct stats
+    {
+        std::size_t _hits;
+        std::size_t _misses;
+    };
+
+private:
+    struct entry
+    {
+        std::string _markdown;
+        shared_html _html;
+        std::size_t _last_used;
+    };
+
+    std::unordered_map<std::uint64_t, entry> _entries;
+    std::size_t _max_idle_renders;
+    std::size_t _n_renders;
+    stats _stats;
+
+public:
+    [[nodiscard]] explicit slide_cache(
+        const std::size_t max_idle_renders = 8) noexcept;
+
+    [[nodiscard]] static std::uint64_t compute_key(
+        const std::string_view markdown, const unsigned int flags) noexcept;
+
+    // Returns `nullptr` on a miss.
+    [[nodiscard]] shared_html find(
+        const std::uint64_t key, const std::string_view markdown);
+
+    void store(const std::uint64_t key, const std::string_view markdown,
+        shared_html html);
+
+    // Marks the end of a deck render, evicting idle entries.
+    void end_render();
+
+    [[nodiscard]] std::size_t get_n_entries() const noexcept;
+    [[nodiscard]] stats get_stats() const noexcept;
+};
+
+} // namespace majsdown
@@ -0,0 +1,129 @@
+#include "slides.hpp"
+
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+
+namespace majsdown {
+
+[[nodiscard]] static std::string_view trim_line_end(std::string_view line)
+{
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r' ||
+                                line.back() == ' ' || line.back() == '\t'))
+    {
+        line.remove_suffix(1);
+    }
+
+    return line;
+}
+
+[[nodiscard]] static std::string_view strip_fence_indentation(
+    std::string_view line)
+{
+    // Up to three spaces of indentation, otherwise it is an indented block
+    for (int i = 0; i < 3 && line.starts_with(' '); ++i)
+    {
+        line.remove_prefix(1);
+    }
+
+    return line;
+}
+
+[[nodiscard]] static std::size_t count_leading(
+    const std::string_view line, const char c)
+{
+    std::size_t result = 0;
+    while (result < line.size() && line[result] == c)
+    {
+        ++result;
+    }
+
+    return result;
+}
+
+slide_deck split_slides(const std::string_view markdown)
+{
+    slide_deck result;
+
+    const auto next_line = [&](const std::size_t begin)
+    {
+        const std::size_t newline = markdown.find('\n', begin);
+        return newline == std::string_view::npos ? markdown.size()
+                                                 : newline + 1;
+    };
+
+    const auto get_line = [&](const std::size_t begin, const std::size_t end)
+    { return trim_line_end(markdown.substr(begin, end - begin)); };
+
+    std::size_t pos = 0;
+
+    // Front matter
+    if (get_line(0, next_line(0)) == "---")
+    {
+        for (std::size_t curr = next_line(0); curr < markdown.size();)
+        {
+            const std::size_t end = next_line(curr);
+            const std::string_view line = get_line(curr, end);
+
+            if (line == "---" || line == "...")
+            {
+                result._front_matter = markdown.substr(0, end);
+                pos = end;
+                break;
+            }
+
+            curr = end;
+        }
+    }
+
+    std::size_t slide_begin = pos;
+    char fence_char = '\0';
+    std::size_t fence_length = 0;
+
+    // A `---` line right after text underlines a setext heading
+    bool after_blank_line = true;
+
+    while (pos < markdown.size())
+    {
+        const std::size_t end = next_line(pos);
+        const std::string_view line = get_line(pos, end);
+        const std::string_view stripped = strip_fence_indentation(line);
+
+        if (fence_length != 0)
+        {
+            // Inside a fenced code block: only look for its closing fence
+            const std::size_t n = count_leading(stripped, fence_char);
+            if (n >= fence_length && n == stripped.size())
+            {
+                fence_length = 0;
+            }
+
+            after_blank_line = false;
+        }
+        else if (line == "---" && after_blank_line)
+        {
+            result._slides.push_back(
+                markdown.substr(slide_begin, pos - slide_begin));
+
+            slide_begin = end;
+        }
+        else
+        {
+            if (stripped.starts_with("```") || stripped.starts_with("~~~"))
+            {
+                fence_char = stripped[0];
+                fence_length = count_leading(stripped, fence_char);
+            }
+
+            after_blank_line = line.empty();
+        }
+
+        pos = end;
+    }
+
+    result._slides.push_back(markdown.substr(slide_begin));
+    return result;
+}
+
+} // namespace majsdown
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace majsdown {
+
+struct slide_deck
+{
+    // Leading YAML block delimited by `---` lines, including the delimiters.
+    // Empty if the document has none.
+    std::string_view _front_matter;
+
+    // Contents between `---` slide breaks, excluding the breaks themselves.
+    std::vector<std::string_view> _slides;
+};
+
+// Splits a Reveal-style Markdown deck at `---` lines that start the deck or
+// a slide, or follow a blank line: right after text, `---` underlines a
+// setext heading instead. Lines inside fenced code blocks never act as slide
+// breaks. The returned views point into `markdown`.
+[[nodiscard]] slide_deck split_slides(const std::string_view markdown);
+
+} // namespace majsdown
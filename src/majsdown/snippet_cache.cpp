@@ -0,0 +1,278 @@
+#include "snippet_cache.hpp"
+
+#include "majsdown/mapped_file.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cctype>
+#include <cstddef>
+
+namespace majsdown {
+
+namespace {
+
+struct line_range
+{
+    std::size_t _first;
+    std::optional<std::size_t> _last; // Up to the end if missing
+};
+
+[[nodiscard]] std::optional<std::size_t> parse_line_number(
+    const std::string_view sv)
+{
+    std::size_t result;
+    const auto [ptr, ec] =
+        std::from_chars(sv.data(), sv.data() + sv.size(), result);
+
+    if (ec != std::errc{} || ptr != sv.data() + sv.size() || result == 0)
+    {
+        return std::nullopt;
+    }
+
+    return result;
+}
+
+// Parses `a-b`, `a-` or `a`.
+[[nodiscard]] std::optional<line_range> parse_line_range(
+    const std::string_view sv)
+{
+    const std::size_t dash = sv.find('-');
+
+    const std::optional<std::size_t> first =
+        parse_line_number(sv.substr(0, dash));
+    if (!first.has_value())
+    {
+        return std::nullopt;
+    }
+
+    if (dash == std::string_view::npos)
+    {
+        return line_range{._first = *first, ._last = *first};
+    }
+
+    if (dash + 1 == sv.size())
+    {
+        return line_range{._first = *first, ._last = std::nullopt};
+    }
+
+    const std::optional<std::size_t> last =
+        parse_line_number(sv.substr(dash + 1));
+    if (!last.has_value() || *last < *first)
+    {
+        return std::nullopt;
+    }
+
+    return line_range{._first = *first, ._last = *last};
+}
+
+[[nodiscard]] bool is_anchor_name_char(const char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-';
+}
+
+// Returns the name following `marker` in `line`, if any.
+[[nodiscard]] std::optional<std::string_view> find_marker_name(
+    const std::string_view line, const std::string_view marker)
+{
+    const std::size_t pos = line.find(marker);
+    if (pos == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+
+    std::size_t begin = pos + marker.size();
+    while (begin < line.size() && line[begin] == ' ')
+    {
+        ++begin;
+    }
+
+    std::size_t end = begin;
+    while (end < line.size() && is_anchor_name_char(line[end]))
+    {
+        ++end;
+    }
+
+    if (end == begin)
+    {
+        return std::nullopt;
+    }
+
+    return line.substr(begin, end - begin);
+}
+
+} // namespace
+
+void snippet_cache::indexed_file::build_index()
+{
+    using namespace std::string_view_literals;
+
+    const std::string_view contents = _file.view();
+
+    // Open anchors, by name, with the byte offset their contents begin at
+    std::unordered_map<std::string_view, std::size_t> open_anchors;
+
+    for (std::size_t begin = 0; begin < contents.size();)
+    {
+        const std::size_t newline = contents.find('\n', begin);
+        const std::size_t end =
+            newline == std::string_view::npos ? contents.size() : newline + 1;
+
+        _line_starts.push_back(begin);
+
+        const std::string_view line = contents.substr(begin, end - begin);
+
+        // `ANCHOR_END: ` contains no `ANCHOR: `, check the longer one first
+        if (const std::optional<std::string_view> name =
+                find_marker_name(line, "ANCHOR_END:"sv);
+            name.has_value())
+        {
+            if (const auto it = open_anchors.find(*name);
+                it != open_anchors.end())
+            {
+                _anchors.insert_or_assign(
+                    std::string{*name}, std::pair{it->second, begin});
+
+                open_anchors.erase(it);
+            }
+        }
+        else if (const std::optional<std::string_view> name =
+                     find_marker_name(line, "ANCHOR:"sv);
+                 name.has_value())
+        {
+            open_anchors.insert_or_assign(*name, end);
+        }
+
+        begin = end;
+    }
+
+    _line_starts.push_back(contents.size());
+    _indexed = true;
+}
+
+snippet_cache::indexed_file* snippet_cache::get_file(const std::string& path)
+{
+    const std::optional<mapped_file::stamp> stamp =
+        mapped_file::get_stamp(path);
+
+    if (!stamp.has_value())
+    {
+        _files.erase(path);
+        return nullptr;
+    }
+
+    std::unique_ptr<indexed_file>& file = _files[path];
+
+    if (file == nullptr || file->_stamp != *stamp)
+    {
+        file = std::make_unique<indexed_file>();
+        file->_stamp = *stamp;
+
+        if (!file->_file.open(path))
+        {
+            _files.erase(path);
+            return nullptr;
+        }
+    }
+
+    return file.get();
+}
+
+std::optional<std::string> snippet_cache::splice(const std::string_view spec,
+    std::string& output, std::vector<std::string>* touched_files)
+{
+    std::string_view path = spec;
+    std::optional<std::string_view> anchor;
+    std::optional<line_range> range;
+
+    if (const std::size_t hash = spec.rfind('#');
+        hash != std::string_view::npos)
+    {
+        path = spec.substr(0, hash);
+        anchor = spec.substr(hash + 1);
+    }
+    else if (const std::size_t colon = spec.rfind(':');
+             colon != std::string_view::npos)
+    {
+        // Only a suffix made of digits and dashes is a range
+        const std::string_view suffix = spec.substr(colon + 1);
+
+        if (!suffix.empty() &&
+            std::all_of(suffix.begin(), suffix.end(), [](const char c)
+                { return std::isdigit(static_cast<unsigned char>(c)) ||
+                         c == '-'; }))
+        {
+            range = parse_line_range(suffix);
+            if (!range.has_value())
+            {
+                return "invalid line range '" + std::string{suffix} + "'";
+            }
+
+            path = spec.substr(0, colon);
+        }
+    }
+
+    const std::string path_str{path};
+
+    if (touched_files != nullptr)
+    {
+        touched_files->push_back(path_str);
+    }
+
+    indexed_file* const file = get_file(path_str);
+    if (file == nullptr)
+    {
+        return "failed to open file '" + path_str + "'";
+    }
+
+    const std::string_view contents = file->_file.view();
+
+    if (!anchor.has_value() && !range.has_value())
+    {
+        output.append(contents);
+        return std::nullopt;
+    }
+
+    if (!file->_indexed)
+    {
+        file->build_index();
+    }
+
+    if (anchor.has_value())
+    {
+        const auto it = file->_anchors.find(std::string{*anchor});
+        if (it == file->_anchors.end())
+        {
+            return "no snippet named '" + std::string{*anchor} + "' in '" +
+                   path_str + "'";
+        }
+
+        const auto [begin, end] = it->second;
+        output.append(contents.substr(begin, end - begin));
+        return std::nullopt;
+    }
+
+    const std::size_t n_lines = file->_line_starts.size() - 1;
+    const std::size_t last = std::min(range->_last.value_or(n_lines), n_lines);
+
+    if (range->_first > n_lines)
+    {
+        return "line " + std::to_string(range->_first) +
+               " is past the end of '" + path_str + "'";
+    }
+
+    const std::size_t begin = file->_line_starts[range->_first - 1];
+    const std::size_t end = file->_line_starts[last];
+
+    output.append(contents.substr(begin, end - begin));
+    return std::nullopt;
+}
+
+} // namespace majsdown
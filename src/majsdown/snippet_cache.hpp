@@ -0,0 +1,53 @@
+#pragma once
+
+#include "majsdown/mapped_file.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace majsdown {
+
+// Files spliced verbatim into the output by `@@<spec>` directives, kept
+// memory-mapped and indexed once per version of the file. `spec` is one of:
+// - `path`: the whole file
+// - `path:a-b`, `path:a-`, `path:a`: lines `a` to `b` (1-based, inclusive)
+// - `path#name`: the lines between the marker lines `ANCHOR: name` and
+//   `ANCHOR_END: name`, which usually sit in comments
+//
+// Selections are made of whole lines, including their newline.
+class snippet_cache
+{
+private:
+    struct indexed_file
+    {
+        mapped_file::stamp _stamp;
+        mapped_file _file;
+
+        // Built on the first partial selection
+        bool _indexed = false;
+        std::vector<std::size_t> _line_starts; // Plus one past the end
+        std::unordered_map<std::string, std::pair<std::size_t, std::size_t>>
+            _anchors; // Byte ranges
+
+        void build_index();
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<indexed_file>> _files;
+
+    [[nodiscard]] indexed_file* get_file(const std::string& path);
+
+public:
+    // Appends the selection described by `spec` to `output`. On failure,
+    // returns the reason and leaves `output` untouched. The path is recorded
+    // in `touched_files` if not null.
+    [[nodiscard]] std::optional<std::string> splice(const std::string_view spec,
+        std::string& output, std::vector<std::string>* touched_files);
+};
+
+} // namespace majsdown
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace majsdown {
+
+// Bounded lock-free queue connecting exactly one producer thread to exactly
+// one consumer thread. Blocking operations sleep on the indices with
+// `std::atomic::wait` rather than spinning.
+template <typename T>
+class spsc_queue
+{
+private:
+    // Avoids false sharing between the producer's and the consumer's index
+    static constexpr std::size_t cache_line_size = 64;
+
+    const std::size_t _capacity;
+    const std::unique_ptr<T[]> _slots;
+
+    // Both indices only ever grow, slots are addressed modulo `_capacity`
+    alignas(cache_line_size) std::atomic<std::size_t> _head; // Next to pop
+    alignas(cache_line_size) std::atomic<std::size_t> _tail; // Next to push
+
+public:
+    [[nodiscard]] explicit spsc_queue(const std::size_t capacity)
+        : _capacity{capacity},
+          _slots{std::make_unique<T[]>(capacity)},
+          _head{0},
+          _tail{0}
+    {
+        assert(capacity > 0);
+    }
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    // Producer only. Leaves `value` untouched and returns `false` if full.
+    [[nodiscard]] bool try_push(T& value)
+    {
+        const std::size_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail - _head.load(std::memory_order_acquire) == _capacity)
+        {
+            return false;
+        }
+
+        _slots[tail % _capacity] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+        _tail.notify_one();
+
+        return true;
+    }
+
+    // Producer only. Blocks while the queue is full.
+    void push(T value)
+    {
+        while (true)
+        {
+            const std::size_t head = _head.load(std::memory_order_acquire);
+
+            if (try_push(value))
+            {
+                return;
+            }
+
+            _head.wait(head, std::memory_order_acquire);
+        }
+    }
+
+    // Consumer only. Returns `false` if empty.
+    [[nodiscard]] bool try_pop(T& result)
+    {
+        const std::size_t head = _head.load(std::memory_order_relaxed);
+
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        result = std::move(_slots[head % _capacity]);
+        _head.store(head + 1, std::memory_order_release);
+        _head.notify_one();
+
+        return true;
+    }
+
+    // Consumer only. Blocks while the queue is empty.
+    [[nodiscard]] T pop()
+    {
+        T result;
+
+        while (true)
+        {
+            const std::size_t tail = _tail.load(std::memory_order_acquire);
+
+            if (try_pop(result))
+            {
+                return result;
+            }
+
+            _tail.wait(tail, std::memory_order_acquire);
+        }
+    }
+};
+
+} // namespace majsdown
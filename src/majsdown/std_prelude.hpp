@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace majsdown {
+
+// Bytecode of `std_prelude.js`, generated at build time. Running it yields an
+// object whose properties are the library's exports.
+extern const std::span<const std::uint8_t> std_prelude_bytecode;
+
+// Names of the exports, in definition order.
+extern const std::span<const char* const> std_prelude_names;
+
+} // namespace majsdown
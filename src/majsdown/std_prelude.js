@@ -0,0 +1,118 @@
+// Built-in library of helpers available to every document.
+//
+// Compiled to bytecode at build time and embedded in the `majsdown` library.
+// The script evaluates to an object whose properties become globals, loaded
+// on first use of any of them. Documents can redefine any of these names.
+//
+// Only use built-ins available with the `strings` JS profile, and no regular
+// expression literals.
+
+(() => {
+    // Longest run of consecutive backticks in `text`
+    const longestBacktickRun = (text) => {
+        let longest = 0;
+        let current = 0;
+
+        for (const c of text) {
+            current = c === '`' ? current + 1 : 0;
+            longest = Math.max(longest, current);
+        }
+
+        return longest;
+    };
+
+    // Wraps `code` in a fenced code block, whose fence is longer than any
+    // backtick run inside `code`.
+    const wrapInCodeBlock = (code, lang = '') => {
+        const fence = '`'.repeat(Math.max(3, longestBacktickRun(code) + 1));
+        return fence + lang + '\n' + code + '\n' + fence;
+    };
+
+    // Language of a code block, guessed from a file extension
+    const languageOfPath = (path) => {
+        const languages = {
+            c: 'c', h: 'c', cc: 'cpp', cpp: 'cpp', cxx: 'cpp', hpp: 'cpp',
+            hxx: 'cpp', js: 'js', mjs: 'js', ts: 'ts', py: 'python',
+            rs: 'rust', go: 'go', java: 'java', sh: 'bash', json: 'json',
+            md: 'markdown', cmake: 'cmake', txt: ''
+        };
+
+        const dot = path.lastIndexOf('.');
+        const extension = dot < 0 ? '' : path.slice(dot + 1).toLowerCase();
+
+        return Object.prototype.hasOwnProperty.call(languages, extension)
+            ? languages[extension]
+            : '';
+    };
+
+    // Embeds the file at `path` as a fenced code block, trailing whitespace
+    // removed.
+    const embedCodeBlock = (path, lang = languageOfPath(path)) =>
+        wrapInCodeBlock(majsdown_embed(path).trimEnd(), lang);
+
+    const base64Alphabet =
+        'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/';
+
+    // UTF-8 aware Base64, encoding natively
+    const Base64 = {
+        encode: (text) => majsdown_base64(text),
+
+        decode: (encoded) => {
+            const bytes = [];
+            let bits = 0;
+            let nBits = 0;
+
+            for (const c of encoded) {
+                const value = base64Alphabet.indexOf(c);
+                if (value < 0) continue; // Padding and whitespace
+
+                bits = (bits << 6) | value;
+                nBits += 6;
+
+                if (nBits >= 8) {
+                    nBits -= 8;
+                    bytes.push((bits >> nBits) & 0xff);
+                }
+            }
+
+            let result = '';
+            for (let i = 0; i < bytes.length; ++i) {
+                result += '%' + (bytes[i] < 16 ? '0' : '') +
+                    bytes[i].toString(16);
+            }
+
+            return decodeURIComponent(result);
+        }
+    };
+
+    // Compiler Explorer client state for a single C++ source
+    const godboltJson = (source, options = {}) => JSON.stringify({
+        sessions: [{
+            id: 1,
+            language: options.language ?? 'c++',
+            source,
+            compilers: [],
+            executors: [{
+                compiler: {
+                    id: options.compiler ?? 'clang_trunk',
+                    libs: [],
+                    options: options.flags ?? '-std=c++20'
+                }
+            }]
+        }]
+    });
+
+    const godboltUrl = (source, options = {}) =>
+        'https://godbolt.org/clientstate/' +
+        Base64.encode(godboltJson(source, options));
+
+    // Markdown link opening `source` on Compiler Explorer
+    const godboltLink = (source, options = {}) =>
+        '[' + (options.text ?? 'on godbolt') + '](' +
+        godboltUrl(source, options) + ')';
+
+    return {
+        wrapInCodeBlock, languageOfPath, embedCodeBlock, Base64, godboltJson,
+        godboltUrl, godboltLink
+    };
+})();
@@ -0,0 +1,124 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace majsdown {
+
+thread_pool::thread_pool(std::size_t n_workers) : _stopping{false}
+{
+    if (n_workers == 0)
+    {
+        n_workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _workers.reserve(n_workers);
+
+    for (std::size_t i = 0; i < n_workers; ++i)
+    {
+        _workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        const std::lock_guard lock{_mutex};
+        _stopping = true;
+    }
+
+    _cv.notify_all();
+
+    for (std::thread& worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+void thread_pool::worker_loop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock lock{_mutex};
+            _cv.wait(lock, [&] { return _stopping || !_tasks.empty(); });
+
+            if (_tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+void thread_pool::post(std::function<void()> task)
+{
+    {
+        const std::lock_guard lock{_mutex};
+        _tasks.push_back(std::move(task));
+    }
+
+    _cv.notify_one();
+}
+
+void thread_pool::parallel_for(
+    const std::size_t n, const std::function<void(std::size_t)>& f)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    std::atomic<std::size_t> next_index{0};
+
+    const auto work = [&]
+    {
+        for (std::size_t i; (i = next_index.fetch_add(1)) < n;)
+        {
+            f(i);
+        }
+    };
+
+    std::mutex helpers_mutex;
+    std::condition_variable helpers_cv;
+    std::size_t n_pending_helpers = std::min(_workers.size(), n - 1);
+
+    for (std::size_t i = n_pending_helpers; i > 0; --i)
+    {
+        post(
+            [&]
+            {
+                work();
+
+                // Notify under the lock, as the waiter owns `helpers_cv`
+                const std::lock_guard lock{helpers_mutex};
+                --n_pending_helpers;
+                helpers_cv.notify_one();
+            });
+    }
+
+    work();
+
+    std::unique_lock lock{helpers_mutex};
+    helpers_cv.wait(lock, [&] { return n_pending_helpers == 0; });
+}
+
+std::size_t thread_pool::get_n_workers() const noexcept
+{
+    return _workers.size();
+}
+
+} // namespace majsdown
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace majsdown {
+
+// Fixed-size pool of worker threads consuming a FIFO queue of tasks.
+class thread_pool
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::thread> _workers;
+    bool _stopping;
+
+    void worker_loop();
+
+public:
+    // Uses one worker per hardware thread if `n_workers` is `0`.
+    [[nodiscard]] explicit thread_pool(std::size_t n_workers = 0);
+
+    // Finishes the queued tasks, then joins the workers.
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    void post(std::function<void()> task);
+
+    // Calls `f(i)` for every `i` in `[0, n)`, returning once all calls have
+    // completed. The calling thread takes part in the work. Must not be
+    // called from a task running on the same pool.
+    void parallel_for(
+        const std::size_t n, const std::function<void(std::size_t)>& f);
+
+    [[nodiscard]] std::size_t get_n_workers() const noexcept;
+};
+
+} // namespace majsdown
@@ -0,0 +1,375 @@
+#include "unix_socket.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace majsdown {
+
+[[nodiscard]] static std::ostream& error_diagnostic_stream(std::ostream& os)
+{
+    return os << "((MJSD ERROR))(SOCKET): ";
+}
+
+unix_socket::unix_socket(const int fd) noexcept : _fd{fd}
+{}
+
+unix_socket::~unix_socket()
+{
+    close();
+}
+
+unix_socket::unix_socket(unix_socket&& rhs) noexcept
+    : _fd{std::exchange(rhs._fd, -1)}
+{}
+
+unix_socket& unix_socket::operator=(unix_socket&& rhs) noexcept
+{
+    close();
+    _fd = std::exchange(rhs._fd, -1);
+    return *this;
+}
+
+bool unix_socket::is_valid() const noexcept
+{
+    return _fd >= 0;
+}
+
+#if !defined(_WIN32)
+
+// Writing to a socket whose peer is gone must fail with `EPIPE` rather than
+// kill the process with `SIGPIPE`.
+#if defined(MSG_NOSIGNAL)
+static constexpr int send_flags = MSG_NOSIGNAL;
+#else
+static constexpr int send_flags = 0;
+#endif
+
+[[nodiscard]] static int prepare_socket(const int fd) noexcept
+{
+#if defined(SO_NOSIGPIPE)
+    if (fd >= 0)
+    {
+        const int enabled = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+    }
+#endif
+
+    return fd;
+}
+
+[[nodiscard]] static bool make_socket_address(const std::string_view path,
+    sockaddr_un& addr, std::ostream& err_stream)
+{
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        error_diagnostic_stream(err_stream)
+            << "Socket path '" << path << "' is too long\n\n";
+
+        return false;
+    }
+
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    return true;
+}
+
+// Removes a socket left behind by a previous run at `addr`. Fails, leaving
+// the path alone, if it is not a socket or if a server still answers there.
+[[nodiscard]] static bool remove_stale_socket(const std::string_view path,
+    const sockaddr_un& addr, std::ostream& err_stream)
+{
+    struct stat st;
+    if (::lstat(addr.sun_path, &st) != 0)
+    {
+        if (errno == ENOENT)
+        {
+            return true;
+        }
+
+        error_diagnostic_stream(err_stream)
+            << "Failed to inspect '" << path << "' (" << std::strerror(errno)
+            << ")\n\n";
+
+        return false;
+    }
+
+    if (!S_ISSOCK(st.st_mode))
+    {
+        error_diagnostic_stream(err_stream)
+            << "'" << path << "' exists and is not a socket\n\n";
+
+        return false;
+    }
+
+    const int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    const bool live =
+        probe >= 0 && ::connect(probe, reinterpret_cast<const sockaddr*>(&addr),
+                          sizeof(addr)) == 0;
+
+    if (probe >= 0)
+    {
+        ::close(probe);
+    }
+
+    if (live)
+    {
+        error_diagnostic_stream(err_stream)
+            << "A server is already listening on '" << path << "'\n\n";
+
+        return false;
+    }
+
+    return ::unlink(addr.sun_path) == 0 || errno == ENOENT;
+}
+
+unix_socket unix_socket::listen(
+    const std::string_view path, std::ostream& err_stream) noexcept
+{
+    sockaddr_un addr;
+    if (!make_socket_address(path, addr, err_stream) ||
+        !remove_stale_socket(path, addr, err_stream))
+    {
+        return unix_socket{};
+    }
+
+    unix_socket result{prepare_socket(::socket(AF_UNIX, SOCK_STREAM, 0))};
+    if (!result.is_valid())
+    {
+        error_diagnostic_stream(err_stream)
+            << "Failed to create socket (" << std::strerror(errno) << ")\n\n";
+
+        return result;
+    }
+
+    if (::bind(result._fd, reinterpret_cast<const sockaddr*>(&addr),
+            sizeof(addr)) != 0 ||
+        ::listen(result._fd, SOMAXCONN) != 0)
+    {
+        error_diagnostic_stream(err_stream)
+            << "Failed to listen on '" << path << "' ("
+            << std::strerror(errno) << ")\n\n";
+
+        result.close();
+    }
+
+    return result;
+}
+
+unix_socket unix_socket::connect(
+    const std::string_view path, std::ostream& err_stream) noexcept
+{
+    sockaddr_un addr;
+    if (!make_socket_address(path, addr, err_stream))
+    {
+        return unix_socket{};
+    }
+
+    unix_socket result{prepare_socket(::socket(AF_UNIX, SOCK_STREAM, 0))};
+
+    if (!result.is_valid() ||
+        ::connect(result._fd, reinterpret_cast<const sockaddr*>(&addr),
+            sizeof(addr)) != 0)
+    {
+        error_diagnostic_stream(err_stream)
+            << "Failed to connect to '" << path << "' ("
+            << std::strerror(errno) << ")\n\n";
+
+        result.close();
+    }
+
+    return result;
+}
+
+unix_socket unix_socket::accept(std::ostream& err_stream) noexcept
+{
+    while (true)
+    {
+        const int fd = ::accept(_fd, nullptr, nullptr);
+        if (fd >= 0)
+        {
+            return unix_socket{prepare_socket(fd)};
+        }
+
+        const int error = errno;
+        if (error == EINTR || error == ECONNABORTED)
+        {
+            continue;
+        }
+
+        error_diagnostic_stream(err_stream)
+            << "Failed to accept connection (" << std::strerror(error)
+            << ")\n\n";
+
+        if (error == EBADF || error == EINVAL || error == ENOTSOCK ||
+            error == EOPNOTSUPP || error == EFAULT)
+        {
+            return unix_socket{};
+        }
+
+        // Out of descriptors or memory: give in-flight work a chance to
+        // release some, rather than spinning
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    }
+}
+
+void unix_socket::close() noexcept
+{
+    if (_fd >= 0)
+    {
+        ::close(std::exchange(_fd, -1));
+    }
+}
+
+bool unix_socket::write_all(const std::string_view data) noexcept
+{
+    const char* ptr = data.data();
+    std::size_t size = data.size();
+
+    while (size > 0)
+    {
+        const ssize_t n = ::send(_fd, ptr, size, send_flags);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        ptr += n;
+        size -= static_cast<std::size_t>(n);
+    }
+
+    return true;
+}
+
+bool unix_socket::read_all(char* data, std::size_t size) noexcept
+{
+    while (size > 0)
+    {
+        const std::size_t n = read_some(data, size);
+        if (n == 0)
+        {
+            return false;
+        }
+
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+std::size_t unix_socket::read_some(char* data, std::size_t size) noexcept
+{
+    while (true)
+    {
+        const ssize_t n = ::read(_fd, data, size);
+        if (n >= 0)
+        {
+            return static_cast<std::size_t>(n);
+        }
+
+        if (errno != EINTR)
+        {
+            return 0;
+        }
+    }
+}
+
+#else
+
+unix_socket unix_socket::listen(
+    const std::string_view, std::ostream& err_stream) noexcept
+{
+    error_diagnostic_stream(err_stream)
+        << "Unix domain sockets are not supported on this platform\n\n";
+
+    return unix_socket{};
+}
+
+unix_socket unix_socket::connect(
+    const std::string_view, std::ostream& err_stream) noexcept
+{
+    error_diagnostic_stream(err_stream)
+        << "Unix domain sockets are not supported on this platform\n\n";
+
+    return unix_socket{};
+}
+
+unix_socket unix_socket::accept(std::ostream&) noexcept
+{
+    return unix_socket{};
+}
+
+void unix_socket::close() noexcept
+{
+    _fd = -1;
+}
+
+bool unix_socket::write_all(const std::string_view) noexcept
+{
+    return false;
+}
+
+bool unix_socket::read_all(char*, std::size_t) noexcept
+{
+    return false;
+}
+
+std::size_t unix_socket::read_some(char*, std::size_t) noexcept
+{
+    return 0;
+}
+
+#endif
+
+bool unix_socket::write_message(const std::string_view data) noexcept
+{
+    const std::uint64_t size = data.size();
+
+    return write_all({reinterpret_cast<const char*>(&size), sizeof(size)}) &&
+           write_all(data);
+}
+
+bool unix_socket::read_message(std::string& data) noexcept
+{
+    std::uint64_t size;
+    if (!read_all(reinterpret_cast<char*>(&size), sizeof(size)))
+    {
+        return false;
+    }
+
+    try
+    {
+        data.resize(size);
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    return read_all(data.data(), size);
+}
+
+} // namespace majsdown
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+
+namespace majsdown {
+
+// Owning wrapper around a Unix domain stream socket, shared by the server
+// modes of the converter. All operations retry on `EINTR`, and writes to a
+// disconnected peer fail instead of raising `SIGPIPE`.
+class unix_socket
+{
+private:
+    int _fd;
+
+public:
+    [[nodiscard]] explicit unix_socket(const int fd = -1) noexcept;
+    ~unix_socket();
+
+    unix_socket(const unix_socket&) = delete;
+    unix_socket& operator=(const unix_socket&) = delete;
+
+    unix_socket(unix_socket&& rhs) noexcept;
+    unix_socket& operator=(unix_socket&& rhs) noexcept;
+
+    [[nodiscard]] static unix_socket listen(
+        const std::string_view path, std::ostream& err_stream) noexcept;
+
+    [[nodiscard]] static unix_socket connect(
+        const std::string_view path, std::ostream& err_stream) noexcept;
+
+    // Logs and retries transient errors (e.g. `EMFILE`). Returns an invalid
+    // socket only if the listening socket itself is unusable.
+    [[nodiscard]] unix_socket accept(std::ostream& err_stream) noexcept;
+
+    [[nodiscard]] bool is_valid() const noexcept;
+    void close() noexcept;
+
+    [[nodiscard]] bool write_all(const std::string_view data) noexcept;
+    [[nodiscard]] bool read_all(char* data, std::size_t size) noexcept;
+
+    // Returns `0` on end of stream or error.
+    [[nodiscard]] std::size_t read_some(char* data, std::size_t size) noexcept;
+
+    // Length-prefixed messages. Both endpoints live on the same machine, so
+    // the prefix is in host byte order.
+    [[nodiscard]] bool write_message(const std::string_view data) noexcept;
+    [[nodiscard]] bool read_message(std::string& data) noexcept;
+};
+
+} // namespace majsdown
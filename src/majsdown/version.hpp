@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string_view>
+
+namespace majsdown {
+
+// Identifies the build, generated at configure time from the project version,
+// a hash of the library's sources and the versions of Discount and QuickJS.
+// Part of the result cache key, so that no build reuses another's results.
+extern const std::string_view build_id;
+
+} // namespace majsdown
@@ -0,0 +1,44 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/base64.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+[[nodiscard]] std::string encode(const std::string_view sv)
+{
+    const std::vector<std::uint8_t> bytes(sv.begin(), sv.end());
+
+    std::string result;
+    majsdown::append_base64(result, bytes);
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("base64 #0")
+{
+    // RFC 4648 test vectors
+    REQUIRE(encode("") == "");
+    REQUIRE(encode("f") == "Zg==");
+    REQUIRE(encode("fo") == "Zm8=");
+    REQUIRE(encode("foo") == "Zm9v");
+    REQUIRE(encode("foob") == "Zm9vYg==");
+    REQUIRE(encode("fooba") == "Zm9vYmE=");
+    REQUIRE(encode("foobar") == "Zm9vYmFy");
+}
+
+TEST_CASE("base64 #1")
+{
+    // Appends, and handles NUL and high bytes
+    std::string result = "data:,";
+    const std::vector<std::uint8_t> bytes{0x00, 0xFF, 0xFE};
+    majsdown::append_base64(result, bytes);
+
+    REQUIRE(result == "data:,AP/+");
+}
@@ -0,0 +1,55 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/batch_renderer.hpp>
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+TEST_CASE("batch_renderer #0")
+{
+    std::map<std::size_t, majsdown::batch_renderer::result> results;
+
+    majsdown::batch_renderer renderer{3,
+        [&](majsdown::batch_renderer::result& r)
+        { results.emplace(r._index, std::move(r)); }};
+
+    REQUIRE(renderer.load_template(
+        "@@$ var seen = (typeof seen === 'undefined') ? 0 : seen + 1;\n"
+        "Dear @@{greet(majsdown_record.name)}, @@{seen}\n",
+        "function greet(name) { return 'Mx. ' + name; }", nullptr,
+        std::cerr));
+
+    for (int i = 0; i < 40; ++i)
+    {
+        renderer.submit("{\"name\": \"N" + std::to_string(i) + "\"}");
+    }
+
+    renderer.submit("{not json");
+    renderer.finish();
+
+    REQUIRE(results.size() == 41);
+
+    // Records never observe each other's globals
+    for (std::size_t i = 0; i < 40; ++i)
+    {
+        REQUIRE(results[i]._status == 0);
+        REQUIRE(results[i]._output ==
+                "Dear Mx. N" + std::to_string(i) + ", 0\n");
+    }
+
+    REQUIRE(results[40]._status == 1);
+    REQUIRE(!results[40]._diagnostics.empty());
+}
+
+TEST_CASE("batch_renderer #1")
+{
+    std::ostringstream oss;
+    majsdown::batch_renderer renderer{1, [](auto&) {}};
+
+    // Syntax errors are reported once, before any record is rendered
+    REQUIRE(!renderer.load_template("@@{(}\n", "", nullptr, oss));
+    REQUIRE(oss.str().find("((MJSD ERROR))(1):") != std::string::npos);
+}
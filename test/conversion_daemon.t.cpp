@@ -0,0 +1,303 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/conversion_daemon.hpp>
+#include <majsdown/unix_socket.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void make_tmp_file(const std::string_view path, const std::string_view contents)
+{
+    std::ofstream ofs(std::string{path});
+    REQUIRE(ofs);
+
+    ofs << contents;
+    ofs.flush();
+
+    REQUIRE(ofs);
+}
+
+[[nodiscard]] bool contains(
+    const std::string_view sv, const std::string_view needle)
+{
+    if (sv.find(needle) == std::string_view::npos)
+    {
+        std::cerr << "OUTPUT:\n" << sv << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("conversion_daemon convert #0")
+{
+    majsdown::conversion_daemon daemon{std::cerr};
+
+    std::string response;
+    REQUIRE(daemon.handle_request(
+        R"({"jsonrpc":"2.0","id":1,"method":"convert",)"
+        R"("params":{"source":"@@{20 + 7}"}})",
+        response));
+
+    REQUIRE(contains(response, R"("id":1)"));
+    REQUIRE(contains(response, R"("success":true)"));
+    REQUIRE(contains(response, R"("output":"27\n")"));
+    REQUIRE(contains(response, R"("diagnostics":[])"));
+}
+
+TEST_CASE("conversion_daemon convert #1")
+{
+    majsdown::conversion_daemon daemon{std::cerr};
+    REQUIRE(daemon.load_prelude("var greeting = 'hello';"));
+
+    // Globals from one request are not visible to the next one
+    for (int i = 0; i < 2; ++i)
+    {
+        std::string response;
+        REQUIRE(daemon.handle_request(
+            R"({"id":"x","method":"convert","params":{"source":)"
+            R"("@@$ let n = 1;\n@@{greeting + n}"}})",
+            response));
+
+        REQUIRE(contains(response, R"("id":"x")"));
+        REQUIRE(contains(response, R"("output":"hello1\n")"));
+    }
+}
+
+TEST_CASE("conversion_daemon convert #2")
+{
+    majsdown::conversion_daemon daemon{std::cerr};
+
+    std::string response;
+    REQUIRE(daemon.handle_request(
+        R"({"id":2,"method":"convert","params":{"source":"a\n@@{x}"}})",
+        response));
+
+    REQUIRE(contains(response, R"("success":false)"));
+    REQUIRE(contains(response, R"("failedPass":1)"));
+    REQUIRE(contains(response, R"("line":2)"));
+    REQUIRE(contains(response, "ReferenceError"));
+}
+
+TEST_CASE("conversion_daemon convert #3")
+{
+    make_tmp_file("./daemon_i.js", "var i = 10;");
+
+    majsdown::conversion_daemon daemon{std::cerr};
+
+    for (int i = 0; i < 2; ++i)
+    {
+        std::string response;
+        REQUIRE(daemon.handle_request(
+            R"({"id":3,"method":"convert","params":{"source":)"
+            R"("@@$ majsdown_include('./daemon_i.js');\n@@{i + 5}"}})",
+            response));
+
+        REQUIRE(contains(response, R"("output":"15\n")"));
+    }
+
+    std::string response;
+    REQUIRE(daemon.handle_request(R"({"id":4,"method":"stats"})", response));
+    REQUIRE(contains(response, R"("fileCacheHits":1)"));
+    REQUIRE(contains(response, R"("fileCacheMisses":1)"));
+}
+
+TEST_CASE("conversion_daemon errors #0")
+{
+    majsdown::conversion_daemon daemon{std::cerr};
+
+    std::string response;
+    REQUIRE(daemon.handle_request("{", response));
+    REQUIRE(contains(response, "-32700"));
+
+    response.clear();
+    REQUIRE(daemon.handle_request(R"({"id":1,"method":"nope"})", response));
+    REQUIRE(contains(response, "-32601"));
+
+    response.clear();
+    REQUIRE(daemon.handle_request(R"({"id":1,"method":"convert"})", response));
+    REQUIRE(contains(response, "-32602"));
+
+    // Notifications do not get a response
+    response.clear();
+    REQUIRE(daemon.handle_request(R"({"method":"stats"})", response));
+    REQUIRE(response.empty());
+}
+
+TEST_CASE("conversion_daemon serve #0")
+{
+    majsdown::conversion_daemon daemon{std::cerr};
+
+    std::istringstream iss{
+        R"({"id":1,"method":"convert","params":{"source":"@@{1}"}})"
+        "\n\n"
+        R"({"id":2,"method":"shutdown"})"
+        "\n"
+        R"({"id":3,"method":"convert","params":{"source":"@@{1}"}})"
+        "\n"};
+
+    std::ostringstream oss;
+    REQUIRE(daemon.serve(iss, oss));
+
+    REQUIRE(contains(oss.str(), R"("id":1)"));
+    REQUIRE(contains(oss.str(), R"("id":2,"result":null)"));
+    REQUIRE(oss.str().find(R"("id":3)") == std::string::npos);
+}
+
+TEST_CASE("conversion_daemon convert document #0")
+{
+    majsdown::conversion_daemon daemon{std::cerr};
+
+    const auto convert = [&](const std::string_view source)
+    {
+        std::string response;
+        REQUIRE(daemon.handle_request(
+            std::string{R"({"id":1,"method":"convert","params":{"document":)"
+                        R"("a.md","source":")"} +
+                std::string{source} + "\"}}",
+            response));
+
+        return response;
+    };
+
+    REQUIRE(contains(convert(R"(@@$ let x = 1;\nA@@{x}\n@@$ x += 1;\nB@@{x})"),
+        R"("output":"A1\nB2\n")"));
+
+    REQUIRE(contains(convert(R"(@@$ let x = 1;\nA@@{x}\n@@$ x += 2;\nB@@{x})"),
+        R"("output":"A1\nB3\n")"));
+
+    std::string response;
+    REQUIRE(daemon.handle_request(R"({"id":2,"method":"stats"})", response));
+    REQUIRE(contains(response, R"("documents":1)"));
+    REQUIRE(contains(response, R"("segmentsExecuted":3)"));
+    REQUIRE(contains(response, R"("segmentsReused":1)"));
+
+    response.clear();
+    REQUIRE(daemon.handle_request(
+        R"({"id":3,"method":"closeDocument","params":{"document":"a.md"}})",
+        response));
+
+    REQUIRE(contains(response, R"("result":true)"));
+}
+
+TEST_CASE("conversion_daemon convert slides #0")
+{
+    majsdown::conversion_daemon daemon{std::cerr};
+
+    const auto convert = [&](const std::string_view source)
+    {
+        std::string response;
+        REQUIRE(daemon.handle_request(
+            std::string{R"({"id":1,"method":"convert","params":{"html":true,)"
+                        R"("slides":true,"source":")"} +
+                std::string{source} + "\"}}",
+            response));
+
+        return response;
+    };
+
+    REQUIRE(contains(convert(R"(# A\n\n---\n# B)"), "<section>"));
+    REQUIRE(contains(convert(R"(# A\n\n---\n# C)"), "C</h1>"));
+
+    // Only the edited slide is rendered again
+    std::string response;
+    REQUIRE(daemon.handle_request(R"({"id":2,"method":"stats"})", response));
+    REQUIRE(contains(response, R"("slideCacheHits":1)"));
+    REQUIRE(contains(response, R"("slideCacheMisses":3)"));
+    REQUIRE(contains(response, R"("slideCacheHitRate":0.25)"));
+
+    response.clear();
+    REQUIRE(daemon.handle_request(
+        R"({"id":3,"method":"convert","params":{"slides":true,"source":""}})",
+        response));
+
+    REQUIRE(contains(response, R"("code":-32602)"));
+}
+
+#if !defined(_WIN32)
+
+TEST_CASE("conversion_daemon serve socket #0")
+{
+    const std::string_view socket_path = "./conversion_daemon_test_0.sock";
+
+    const pid_t pid = ::fork();
+    REQUIRE(pid >= 0);
+
+    if (pid == 0)
+    {
+        majsdown::conversion_daemon daemon{std::cerr};
+        ::_exit(daemon.serve_socket(socket_path) ? 0 : 1);
+    }
+
+    const auto connect = [&]
+    {
+        std::ostringstream oss;
+
+        for (int i = 0; i < 100; ++i)
+        {
+            majsdown::unix_socket conn =
+                majsdown::unix_socket::connect(socket_path, oss);
+
+            if (conn.is_valid())
+            {
+                return conn;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        }
+
+        std::cerr << oss.str();
+        return majsdown::unix_socket{};
+    };
+
+    // A client leaving before its responses must not take the daemon down
+    {
+        majsdown::unix_socket conn = connect();
+        REQUIRE(conn.is_valid());
+        REQUIRE(conn.write_all(
+            R"({"id":1,"method":"convert","params":{"source":"@@{1}"}})"
+            "\n"
+            R"({"id":2,"method":"convert","params":{"source":"@@{2}"}})"
+            "\n"));
+    }
+
+    majsdown::unix_socket conn = connect();
+    REQUIRE(conn.is_valid());
+    REQUIRE(conn.write_all(R"({"id":3,"method":"shutdown"})"
+                           "\n"));
+
+    std::string response;
+    char chunk[256];
+
+    while (response.find('\n') == std::string::npos)
+    {
+        const std::size_t n = conn.read_some(chunk, sizeof(chunk));
+        REQUIRE(n > 0);
+
+        response.append(chunk, n);
+    }
+
+    REQUIRE(contains(response, R"("id":3,"result":null)"));
+
+    int status = 0;
+    REQUIRE(::waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+}
+
+#endif
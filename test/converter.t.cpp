@@ -6,6 +6,7 @@
 
 #include <array>
 #include <fstream>
+#include <optional>
 #include <string_view>
 
 #include <cassert>
@@ -1809,3 +1810,487 @@ x
     REQUIRE(has_js_line_diagnostic(oss, 2));
     REQUIRE(has_final_line_diagnostic(oss, 1));
 }
+
+TEST_CASE("converter convert #89")
+{
+    make_tmp_file("./splice.cpp",
+        "#include <x>\n// ANCHOR: main\nint main() {}\n"
+        "// ANCHOR_END: main\nlast");
+
+    const std::string_view source = R"(
+@@<./splice.cpp:1>@@<./splice.cpp:4->
+@@<./splice.cpp#main>@@<./splice.cpp:2-3>
+)"sv;
+
+    const std::string_view expected = R"(
+#include <x>
+// ANCHOR_END: main
+last
+int main() {}
+// ANCHOR: main
+int main() {}
+
+)"sv;
+
+    do_test_one_pass(source, expected);
+    do_test_one_pass(source, source, {.skip_splice_directives = true});
+}
+
+TEST_CASE("converter convert #90")
+{
+    make_tmp_file("./splice.cpp", "a\nb\n");
+
+    for (const std::string_view source :
+        {"@@<./splice.cpp#nope>"sv, "@@<./splice.cpp:3>"sv,
+            "@@<./splice.cpp:2-1>"sv, "@@<./splice_missing.cpp>"sv})
+    {
+        std::ostringstream oss;
+        do_test_one_pass_error(source, {}, oss);
+
+        REQUIRE(diagnostic_contains(oss.str(), "Error in '@@<' directive"));
+    }
+}
+
+TEST_CASE("converter convert #91")
+{
+    make_tmp_file("./splice.cpp", "a\nb\n");
+
+    // Without a path and a `>` on the same line, `@@<` is plain text
+    for (const std::string_view source :
+        {"@@<./splice.cpp\n>"sv, "@@<>"sv, "@@<"sv, "x @@< y\n"sv})
+    {
+        do_test_one_pass(source, source);
+    }
+
+    do_test_one_pass("a @@< b\n@@<./splice.cpp:2>"sv, "a @@< b\nb\n"sv);
+}
+
+TEST_CASE("converter pure expression #0")
+{
+    const std::string_view source = R"(
+@@$ function square(x) { return x * x; }
+@@$ const offset = 10;
+@@={square(2)} @@={square(3) + offset} @@{'-'} @@={'a' + 'b'}
+@@={[1, 2].length} @@={majsdown_base64('a')}
+)"sv;
+
+    const std::string_view expected = R"(
+4 19 - ab
+2 YQ==
+)"sv;
+
+    do_test_one_pass(source, expected);
+    do_test_one_pass(source, source,
+        {.skip_inline_expressions = true, .skip_inline_statements = true});
+}
+
+TEST_CASE("converter pure expression #1")
+{
+    // Statements between pure expressions are honored, and object values
+    // fall back to the interpreter
+    const std::string_view source = R"(
+@@$ var n = 1;
+@@={n} @@={n + 1} @@={[n, n]}
+@@$ n = 5;
+@@={n} @@={({a: n}).a} @@={[n]}
+)"sv;
+
+    const std::string_view expected = R"(
+1 2 1,1
+5 5 5
+)"sv;
+
+    do_test_one_pass(source, expected);
+}
+
+TEST_CASE("converter pure expression #2")
+{
+    for (const std::string_view source : {"@@={1"sv, "@@={}"sv, "@@={y}"sv})
+    {
+        std::ostringstream oss;
+        do_test_one_pass_error(source, {}, oss);
+
+        REQUIRE(!oss.str().empty());
+    }
+
+    // Without a following `{`, `@@=` is plain text
+    do_test_one_pass("@@=x"sv, "@@=x"sv);
+    do_test_one_pass("a @@= b @@=\n@@={1}"sv, "a @@= b @@=\n1"sv);
+    do_test_one_pass("@@="sv, "@@="sv);
+}
+
+TEST_CASE("converter pure expression #3")
+{
+    // Workers hold the same state as the interpreter, closures included
+    const std::string_view source = R"(
+@@$ var prefix = 'a';
+@@$ const f = ((prefix) => (n) => prefix + n)('b');
+@@$ var sym = Symbol('s');
+@@$ var g = 0; function outer() { let g = 1; globalThis.h = () => g; }
+@@$ if (true) /'/.test("a"); outer(); // '
+@@={f(1)} @@={f(2)} @@={prefix} @@={typeof sym} @@={h()} @@={g}
+)"sv;
+
+    const std::string_view expected = R"(
+b1 b2 a symbol 1 0
+)"sv;
+
+    do_test_one_pass(source, expected);
+}
+
+TEST_CASE("converter pure expression #4")
+{
+    // Workers use the document's JS profile
+    std::ostringstream oss;
+    majsdown::converter cnvtr{oss};
+    cnvtr.set_js_profile(majsdown::js_profile::strings);
+
+    std::string output_buffer;
+    REQUIRE(!cnvtr.convert({}, output_buffer, "@@={new Map().size} @@={1}"sv));
+    REQUIRE(diagnostic_contains(oss.str(), "'Map' is not available"));
+}
+
+TEST_CASE("converter trivial inline expression #0")
+{
+    const std::string_view source = R"(
+@@$ var count = 24;
+@@$ function pic(name, n) { return name + ':' + n; }
+@@$ const lexical = 'lex';
+@@$ globalThis.shadowed = 'global'; let shadowed = 'lexical';
+@@{count} @@{'a'} @@{"b"} @@{1.50} @@{null} @@{pic("we3", 2)}
+@@{ pic( 'x,y' , true ) } @@{lexical} @@{shadowed} @@{count + 1}
+)"sv;
+
+    const std::string_view expected = R"(
+24 a b 1.5 null we3:2
+x,y:true lex lexical 25
+)"sv;
+
+    majsdown::converter cnvtr{std::cerr};
+    do_test_impl(cnvtr, 0, source, expected, {});
+
+    const majsdown::converter::inline_expression_stats stats =
+        cnvtr.get_inline_expression_stats();
+
+    REQUIRE(stats._n_evaluated == 10);
+    REQUIRE(stats._n_trivial == 7);
+}
+
+TEST_CASE("converter trivial inline expression #1")
+{
+    // Errors raised by calls are reported, without calling again
+    const std::string_view source = R"(
+@@$ var n = 0;
+@@$ function fail(what) { ++n; throw new Error(what); }
+@@{fail('boom')}
+)"sv;
+
+    std::ostringstream oss;
+    majsdown::converter cnvtr{oss};
+
+    std::string output_buffer;
+    REQUIRE(!cnvtr.convert({}, output_buffer, source));
+    REQUIRE(diagnostic_contains(oss.str(), "boom"));
+
+    output_buffer.clear();
+    REQUIRE(cnvtr.convert({}, output_buffer, "@@{n}"));
+    REQUIRE(output_buffer == "1");
+}
+
+TEST_CASE("converter determinism #0")
+{
+    const majsdown::determinism_config determinism{
+        ._now_ms = 1000, ._random_seed = 7};
+
+    const auto convert = [&](const std::string_view source, bool& flag)
+    {
+        majsdown::converter cnvtr{std::cerr};
+        cnvtr.set_determinism(determinism);
+        cnvtr.set_nondeterminism_flag(&flag);
+
+        std::string output_buffer;
+        REQUIRE(cnvtr.convert({}, output_buffer, source));
+
+        return output_buffer;
+    };
+
+    // Pure expressions reading the clock or random numbers fall back to the
+    // interpreter, so they draw from the same sequence
+    bool nondeterministic = false;
+
+    const std::string impure = convert(
+        "@@{Date.now()} @@{Math.random()} @@{Math.random()} @@{1}"sv,
+        nondeterministic);
+
+    const std::string pure = convert(
+        "@@={Date.now()} @@={Math.random()} @@={Math.random()} @@={1}"sv,
+        nondeterministic);
+
+    REQUIRE(impure.starts_with("1000 0."));
+    REQUIRE(impure == pure);
+    REQUIRE(!nondeterministic);
+
+    majsdown::converter cnvtr{std::cerr};
+    cnvtr.set_nondeterminism_flag(&nondeterministic);
+
+    do_test_impl(cnvtr, 0, "@@{typeof Math.random()}"sv, "number"sv, {});
+    REQUIRE(nondeterministic);
+}
+
+TEST_CASE("converter determinism #1")
+{
+    const auto convert = [](const std::string_view source)
+    {
+        majsdown::converter cnvtr{std::cerr};
+        cnvtr.set_determinism(
+            majsdown::determinism_config{._now_ms = 0, ._random_seed = 3});
+
+        std::string output_buffer;
+        REQUIRE(cnvtr.convert({}, output_buffer, source));
+
+        return output_buffer;
+    };
+
+    // Workers replay the random numbers drawn by statements
+    const std::string impure =
+        convert("@@$ var r = Math.random();\n@@{r} @@{r + 1}"sv);
+
+    const std::string pure =
+        convert("@@$ var r = Math.random();\n@@={r} @@={r + 1}"sv);
+
+    REQUIRE(impure.starts_with("0."));
+    REQUIRE(impure == pure);
+}
+
+TEST_CASE("converter convert_all_passes #0")
+{
+    majsdown::converter cnvtr{std::cerr};
+
+    std::string buffer = R"(
+@@${
+function wrap(code, lang) { return "```" + lang + "\n" + code + "\n```"; }
+}$
+\@@{not JS}
+@@_{wrap(code, "js")}_
+```cpp
+@@{1 + 1}
+```
+)";
+
+    std::string scratch_buffer;
+    REQUIRE(cnvtr.convert_all_passes(buffer, scratch_buffer) == 0);
+
+    REQUIRE(buffer == R"(
+@@{not JS}
+```js
+2
+```
+)");
+}
+
+TEST_CASE("converter convert_all_passes #1")
+{
+    std::ostringstream oss;
+    majsdown::converter cnvtr{oss};
+
+    std::string buffer = "@@{x}\n";
+    std::string scratch_buffer;
+
+    REQUIRE(cnvtr.convert_all_passes(buffer, scratch_buffer) == 1);
+}
+
+TEST_CASE("converter run_until_fixed_point #0")
+{
+    majsdown::converter cnvtr{std::cerr};
+
+    // Directives emitted by a pass are processed by the next one
+    std::string buffer = "text\n@@{'@@' + '{1 + 1}'}\n";
+    std::string scratch_buffer;
+    std::size_t n_passes_run = 0;
+
+    const std::array passes{majsdown::second_pass_config};
+    REQUIRE(cnvtr.run_until_fixed_point(
+                passes, buffer, scratch_buffer, 4, &n_passes_run) == 0);
+
+    REQUIRE(buffer == "text\n2\n");
+    REQUIRE(n_passes_run == 2);
+}
+
+TEST_CASE("converter run_until_fixed_point #1")
+{
+    majsdown::converter cnvtr{std::cerr};
+
+    // Sources without directives or escapes are not scanned again
+    const std::string source = "# Title\n\nsome text... test@mail.com\n";
+    std::string buffer = source;
+    std::string scratch_buffer;
+    std::size_t n_passes_run = 0;
+
+    const std::array passes{
+        majsdown::first_pass_config, majsdown::second_pass_config};
+
+    REQUIRE(cnvtr.run_until_fixed_point(
+                passes, buffer, scratch_buffer, 2, &n_passes_run) == 0);
+
+    REQUIRE(buffer == source);
+    REQUIRE(n_passes_run == 0);
+
+    // The second pass is skipped if the first one emits no directives
+    buffer = "@@{1 + 1}\n";
+    REQUIRE(cnvtr.run_until_fixed_point(
+                passes, buffer, scratch_buffer, 2, &n_passes_run) == 0);
+
+    REQUIRE(buffer == "2\n");
+    REQUIRE(n_passes_run == 1);
+}
+
+TEST_CASE("converter run_until_fixed_point #2")
+{
+    std::ostringstream oss;
+    majsdown::converter cnvtr{oss};
+
+    // Skipped lines still count towards diagnostics
+    std::string buffer = "a\nb\n@@{x}\n";
+    std::string scratch_buffer;
+
+    const std::array passes{majsdown::second_pass_config};
+    REQUIRE(cnvtr.run_until_fixed_point(passes, buffer, scratch_buffer, 4) ==
+            1);
+
+    REQUIRE(has_final_line_diagnostic(oss, 3));
+}
+
+TEST_CASE("converter compile_template #0")
+{
+    const std::string_view source = R"(
+# Title
+@@$ var i = 10;
+@@$ function f(x) {
+@@$     return x * 2;
+@@$ }
+@@{f(i)} and @@{"\"quoted\""} \@@{kept}
+@@$ let s = `x`;
+@@{s}
+)"sv;
+
+    majsdown::converter expected_cnvtr{std::cerr};
+    std::string expected = std::string{source};
+    std::string scratch_buffer;
+    REQUIRE(expected_cnvtr.convert_all_passes(expected, scratch_buffer) == 0);
+
+    majsdown::converter cnvtr{std::cerr};
+    majsdown::converter::compiled_template tmpl;
+    REQUIRE(cnvtr.compile_template(majsdown::first_pass_config, source, tmpl));
+
+    // Templates can be run by other converters, after a round-trip
+    const std::optional<majsdown::converter::compiled_template> loaded =
+        majsdown::converter::compiled_template::deserialize(tmpl.serialize());
+
+    REQUIRE(loaded.has_value());
+    REQUIRE(loaded->_line_map == tmpl._line_map);
+
+    majsdown::converter runner{std::cerr};
+    std::string buffer;
+    REQUIRE(runner.convert_all_passes_compiled(
+                *loaded, buffer, scratch_buffer) == 0);
+
+    REQUIRE(buffer == expected);
+}
+
+TEST_CASE("converter compile_template #1")
+{
+    const std::string_view source = R"(
+a
+@@{10}
+@@$ var i = 1;
+@@$ var j = i;
+@@$ var l = k;
+
+)"sv;
+
+    std::ostringstream oss;
+    majsdown::converter cnvtr{oss};
+
+    majsdown::converter::compiled_template tmpl;
+    REQUIRE(cnvtr.compile_template(majsdown::first_pass_config, source, tmpl));
+
+    // Runtime errors are reported at their source line
+    std::string buffer;
+    REQUIRE(!cnvtr.run_template(tmpl, buffer));
+    REQUIRE(has_final_line_diagnostic(oss, 6));
+}
+
+TEST_CASE("converter compile_template #2")
+{
+    const std::string_view source = R"(
+a
+@@{10}
+@@{(}
+
+)"sv;
+
+    std::ostringstream oss;
+    majsdown::converter cnvtr{oss};
+
+    // Syntax errors fail the whole template upfront
+    majsdown::converter::compiled_template tmpl;
+    REQUIRE(
+        !cnvtr.compile_template(majsdown::first_pass_config, source, tmpl));
+
+    REQUIRE(has_final_line_diagnostic(oss, 4));
+}
+
+TEST_CASE("converter evaluate #0")
+{
+    majsdown::converter cnvtr{std::cerr};
+    REQUIRE(cnvtr.evaluate("var greeting = 'hello';"));
+
+    do_test_impl(cnvtr, 0, "@@{greeting} world", "hello world", {});
+}
+
+TEST_CASE("converter evaluate #1")
+{
+    std::ostringstream oss;
+    majsdown::converter cnvtr{oss};
+
+    REQUIRE(!cnvtr.evaluate("x"));
+    REQUIRE(!oss.str().empty());
+}
+
+TEST_CASE("converter lazy interpreter #0")
+{
+    majsdown::converter cnvtr{std::cerr};
+
+    // Plain Markdown and escapes never need the interpreter
+    std::string buffer = "# Title\n\nplain \\@@{text}\n";
+    std::string scratch_buffer;
+
+    REQUIRE(cnvtr.convert_all_passes(buffer, scratch_buffer) == 0);
+    REQUIRE(buffer == "# Title\n\nplain @@{text}\n");
+    REQUIRE(!cnvtr.has_js_interpreter());
+
+    buffer = "a\n@@$ var i = 1;\n@@{i + 1}\n";
+    REQUIRE(cnvtr.convert_all_passes(buffer, scratch_buffer) == 0);
+    REQUIRE(buffer == "a\n2\n");
+    REQUIRE(cnvtr.has_js_interpreter());
+}
+
+TEST_CASE("converter lazy interpreter #1")
+{
+    // Errors raised by the first directive still report the right line
+    const std::string_view source = R"(
+a
+b
+@@$ var i = j;
+)"sv;
+
+    std::ostringstream oss;
+    do_test_one_pass_error(source, {}, oss);
+
+    REQUIRE(has_js_line_diagnostic(oss, 1));
+    REQUIRE(has_final_line_diagnostic(oss, 4));
+
+    majsdown::converter cnvtr{std::cerr};
+    cnvtr.warm_up();
+    REQUIRE(cnvtr.has_js_interpreter());
+}
@@ -0,0 +1,65 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/depfile.hpp>
+#include <majsdown/output_file.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace {
+
+[[nodiscard]] std::string read_tmp_file(const std::string_view path)
+{
+    std::ifstream ifs{std::string{path}, std::ios::binary};
+    REQUIRE(ifs);
+
+    return std::string{
+        std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+}
+
+} // namespace
+
+TEST_CASE("depfile #0")
+{
+    REQUIRE(majsdown::make_depfile("out.md", {}, false) == "out.md:\n");
+
+    REQUIRE(majsdown::make_depfile("out.md", {"a.mjsd", "b.js", "a.mjsd"},
+                false) == "out.md: \\\n  a.mjsd \\\n  b.js\n");
+}
+
+TEST_CASE("depfile #1")
+{
+    REQUIRE(majsdown::make_depfile("my out.md", {"$x#.js"}, true) ==
+            "my\\ out.md: \\\n  $$x\\#.js\n\n$$x\\#.js:\n");
+}
+
+TEST_CASE("output_file #0")
+{
+    constexpr std::string_view path = "./output_file_0.md";
+    std::filesystem::remove(path);
+
+    REQUIRE(majsdown::write_file_if_changed(path, "hello\n", std::cerr));
+    REQUIRE(read_tmp_file(path) == "hello\n");
+
+    // Unchanged contents leave the file untouched
+    const auto old_time = std::filesystem::file_time_type::clock::now() -
+                          std::chrono::hours{1};
+
+    std::filesystem::last_write_time(path, old_time);
+
+    REQUIRE(majsdown::write_file_if_changed(path, "hello\n", std::cerr));
+    REQUIRE(std::filesystem::last_write_time(path) == old_time);
+
+    REQUIRE(majsdown::write_file_if_changed(path, "world\n", std::cerr));
+    REQUIRE(read_tmp_file(path) == "world\n");
+    REQUIRE(std::filesystem::last_write_time(path) != old_time);
+
+    REQUIRE(majsdown::write_file(path, "", std::cerr));
+    REQUIRE(read_tmp_file(path).empty());
+}
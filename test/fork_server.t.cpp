@@ -0,0 +1,175 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/fork_server.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct server_process
+{
+    pid_t _pid;
+
+    explicit server_process(const std::string_view socket_path,
+        const std::string_view prelude)
+        : _pid{::fork()}
+    {
+        REQUIRE(_pid >= 0);
+
+        if (_pid == 0)
+        {
+            majsdown::fork_server server{std::cerr};
+
+            if (!server.load_prelude(prelude))
+            {
+                ::_exit(1);
+            }
+
+            ::_exit(server.run(socket_path) ? 0 : 1);
+        }
+    }
+
+    ~server_process()
+    {
+        ::kill(_pid, SIGTERM);
+        ::waitpid(_pid, nullptr, 0);
+    }
+};
+
+[[nodiscard]] bool request_with_retries(const std::string_view socket_path,
+    const std::string_view source, majsdown::fork_server_response& response)
+{
+    std::ostringstream oss;
+
+    for (int i = 0; i < 100; ++i)
+    {
+        if (majsdown::request_fork_server_conversion(
+                socket_path, source, response, oss))
+        {
+            return true;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    }
+
+    std::cerr << oss.str();
+    return false;
+}
+
+} // namespace
+
+TEST_CASE("fork_server request #0")
+{
+    const std::string_view socket_path = "./fork_server_test_0.sock";
+    const server_process server{socket_path, "var greeting = 'hello';"};
+
+    majsdown::fork_server_response response;
+    REQUIRE(request_with_retries(socket_path, "@@{greeting} world\n", response));
+
+    REQUIRE(response._status == 0);
+    REQUIRE(response._output == "hello world\n");
+}
+
+TEST_CASE("fork_server request #1")
+{
+    const std::string_view socket_path = "./fork_server_test_1.sock";
+    const server_process server{socket_path, "var counter = 0;"};
+
+    // Every request starts from the parent's state, mutations do not leak
+    for (int i = 0; i < 3; ++i)
+    {
+        majsdown::fork_server_response response;
+        REQUIRE(request_with_retries(
+            socket_path, "@@{++counter}\n", response));
+
+        REQUIRE(response._status == 0);
+        REQUIRE(response._output == "1\n");
+    }
+}
+
+TEST_CASE("fork_server request #2")
+{
+    const std::string_view socket_path = "./fork_server_test_2.sock";
+    const server_process server{socket_path, ""};
+
+    majsdown::fork_server_response response;
+    REQUIRE(request_with_retries(socket_path, "@@{x}\n", response));
+
+    REQUIRE(response._status == 1);
+    REQUIRE(!response._diagnostics.empty());
+}
+
+TEST_CASE("fork_server request #3")
+{
+    const std::string_view socket_path = "./fork_server_test_3.sock";
+    const server_process server{socket_path,
+        "var squares = majsdown_parallel_map("
+        "function (x) { return x * x; }, [1, 2, 3]);"};
+
+    // Children run their own workers, not the parent's
+    constexpr std::string_view source =
+        "@@{squares.join(',')} @@{majsdown_parallel_map("
+        "function (x) { return x + 1; }, [1, 2, 3, 4]).join(',')}\n";
+
+    for (int i = 0; i < 2; ++i)
+    {
+        majsdown::fork_server_response response;
+        REQUIRE(request_with_retries(socket_path, source, response));
+
+        REQUIRE(response._status == 0);
+        REQUIRE(response._output == "1,4,9 2,3,4,5\n");
+    }
+}
+
+TEST_CASE("fork_server listen #0")
+{
+    // Files that are not sockets are left alone
+    const std::string socket_path = "./fork_server_test_listen_0.md";
+    {
+        std::ofstream ofs{socket_path};
+        ofs << "notes";
+    }
+
+    std::ostringstream oss;
+    majsdown::fork_server server{oss};
+
+    REQUIRE(!server.run(socket_path));
+    REQUIRE(oss.str().find("is not a socket") != std::string::npos);
+    REQUIRE(std::filesystem::is_regular_file(socket_path));
+
+    std::filesystem::remove(socket_path);
+}
+
+TEST_CASE("fork_server listen #1")
+{
+    // A live server keeps its socket
+    const std::string_view socket_path = "./fork_server_test_listen_1.sock";
+    const server_process server{socket_path, ""};
+
+    majsdown::fork_server_response response;
+    REQUIRE(request_with_retries(socket_path, "@@{1}\n", response));
+
+    std::ostringstream oss;
+    majsdown::fork_server second{oss};
+
+    REQUIRE(!second.run(socket_path));
+    REQUIRE(oss.str().find("already listening") != std::string::npos);
+
+    REQUIRE(request_with_retries(socket_path, "@@{2}\n", response));
+    REQUIRE(response._output == "2\n");
+}
+
+#endif
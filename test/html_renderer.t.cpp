@@ -0,0 +1,132 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/converter.hpp>
+#include <majsdown/html_renderer.hpp>
+#include <majsdown/slide_cache.hpp>
+#include <majsdown/thread_pool.hpp>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+[[nodiscard]] bool contains(
+    const std::string_view sv, const std::string_view needle)
+{
+    if (sv.find(needle) == std::string_view::npos)
+    {
+        std::cerr << "OUTPUT:\n" << sv << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("html_renderer options #0")
+{
+    majsdown::html_config cfg;
+    REQUIRE(cfg.fenced_code);
+    REQUIRE(!cfg.footnotes);
+
+    REQUIRE(majsdown::parse_html_options("", cfg));
+    REQUIRE(majsdown::parse_html_options("footnotes,no-fenced-code", cfg));
+    REQUIRE(cfg.footnotes);
+    REQUIRE(!cfg.fenced_code);
+
+    REQUIRE(!majsdown::parse_html_options("bogus", cfg));
+
+    REQUIRE(majsdown::get_discount_flags(majsdown::html_config{}) !=
+            majsdown::get_discount_flags(cfg));
+}
+
+TEST_CASE("html_renderer render #0")
+{
+    std::string output;
+    REQUIRE(majsdown::render_html(
+        "# Title\n\nSome *text*.\n", output, {}, std::cerr));
+
+    REQUIRE(contains(output, "Title</h1>"));
+    REQUIRE(contains(output, "<em>text</em>"));
+}
+
+TEST_CASE("html_renderer render #1")
+{
+    std::string output;
+    REQUIRE(majsdown::render_html(
+        "```cpp\nint x;\n```\n", output, {}, std::cerr));
+
+    REQUIRE(contains(output, "<pre><code"));
+    REQUIRE(contains(output, "int x;"));
+}
+
+TEST_CASE("converter render_html #0")
+{
+    majsdown::converter cnvtr{std::cerr};
+
+    std::string buffer = "Hello @@{'**' + 'world' + '**'}!\n";
+    std::string scratch_buffer;
+
+    REQUIRE(cnvtr.convert_all_passes(buffer, scratch_buffer) == 0);
+    REQUIRE(cnvtr.render_html(buffer, scratch_buffer, {}));
+    REQUIRE(contains(buffer, "<strong>world</strong>"));
+}
+
+TEST_CASE("html_renderer slides #0")
+{
+    majsdown::thread_pool pool{2};
+
+    std::string output;
+    REQUIRE(majsdown::render_html_slides(
+        "---\ntitle: deck\n---\n# One\n\n---\n# Two\n\n---\n# Three\n",
+        output, {}, pool, std::cerr));
+
+    // Front matter is left out
+    REQUIRE(output.starts_with("<section>\n"));
+    REQUIRE(output.find("title") == std::string::npos);
+
+    const std::size_t one = output.find("One</h1>");
+    const std::size_t two = output.find("Two</h1>");
+    const std::size_t three = output.find("Three</h1>");
+
+    REQUIRE(contains(output, "One</h1>"));
+    REQUIRE(one < two);
+    REQUIRE(two < three);
+    REQUIRE(three != std::string::npos);
+
+    REQUIRE(output.ends_with("</section>\n"));
+}
+
+TEST_CASE("html_renderer slides #1")
+{
+    majsdown::thread_pool pool{2};
+    majsdown::slide_cache cache;
+
+    std::string first;
+    REQUIRE(majsdown::render_html_slides(
+        "# One\n\n---\n# Two\n", first, {}, pool, std::cerr, &cache));
+
+    REQUIRE(cache.get_stats()._misses == 2);
+    REQUIRE(cache.get_n_entries() == 2);
+
+    std::string second;
+    REQUIRE(majsdown::render_html_slides(
+        "# One\n\n---\n# Two\n", second, {}, pool, std::cerr, &cache));
+
+    REQUIRE(second == first);
+    REQUIRE(cache.get_stats()._hits == 2);
+
+    // Different flags do not share entries
+    majsdown::html_config cfg;
+    cfg.smartypants = false;
+
+    std::string third;
+    REQUIRE(majsdown::render_html_slides(
+        "# One\n\n---\n# Two\n", third, cfg, pool, std::cerr, &cache));
+
+    REQUIRE(cache.get_stats()._hits == 2);
+    REQUIRE(cache.get_stats()._misses == 4);
+}
@@ -0,0 +1,273 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/converter.hpp>
+#include <majsdown/incremental_converter.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+void make_tmp_file(const std::string_view path, const std::string_view contents)
+{
+    std::ofstream ofs(std::string{path});
+    REQUIRE(ofs);
+
+    ofs << contents;
+    ofs.flush();
+
+    REQUIRE(ofs);
+}
+
+[[nodiscard]] std::string convert_full(
+    const std::string_view source, const std::string_view prelude = {})
+{
+    std::ostringstream diagnostics;
+    majsdown::converter cnvtr{diagnostics};
+
+    if (!prelude.empty())
+    {
+        REQUIRE(cnvtr.evaluate(prelude));
+    }
+
+    std::string buffer{source};
+    std::string scratch_buffer;
+
+    REQUIRE(cnvtr.convert_all_passes(buffer, scratch_buffer) == 0);
+    return buffer;
+}
+
+// Converts `source` incrementally, checking that the result matches a
+// conversion from scratch with the same prelude as `ic`.
+[[nodiscard]] majsdown::incremental_converter::stats do_test(
+    majsdown::incremental_converter& ic, const std::string_view source,
+    const std::string_view prelude = {})
+{
+    std::string buffer{source};
+    std::string scratch_buffer;
+
+    REQUIRE(ic.convert_all_passes(buffer, scratch_buffer) == 0);
+    REQUIRE(buffer == convert_full(source, prelude));
+
+    return ic.get_last_stats();
+}
+
+constexpr std::string_view doc_v0 = R"(# Title
+@@$ let total = 0;
+@@$ const add = (x) => { total += x; return total; };
+A @@{add(1)}
+@@$ var label = 'first';
+B @@{add(2)} @@{label}
+@@${
+    class Point { constructor(x) { this.x = x; } }
+}$
+C @@{new Point(total).x}
+@@$ var items = [1, 2, 3];
+D @@{items.join(',')}
+)";
+
+} // namespace
+
+TEST_CASE("incremental_converter #0")
+{
+    majsdown::incremental_converter ic{std::cerr};
+
+    const auto stats0 = do_test(ic, doc_v0);
+    REQUIRE(stats0._n_segments == 5);
+    REQUIRE(stats0._n_executed == 5);
+    REQUIRE(stats0._n_reused == 0);
+
+    // Unchanged document: nothing is executed
+    const auto stats1 = do_test(ic, doc_v0);
+    REQUIRE(stats1._n_executed == 0);
+    REQUIRE(stats1._n_reused == 5);
+}
+
+TEST_CASE("incremental_converter #1")
+{
+    majsdown::incremental_converter ic{std::cerr};
+    (void)do_test(ic, doc_v0);
+
+    // Editing the last segment executes everything before it again, which
+    // rebuilds the state it needs
+    std::string doc_v1{doc_v0};
+    doc_v1.replace(doc_v1.find("D @@"), 1, "Z");
+
+    const auto stats = do_test(ic, doc_v1);
+    REQUIRE(stats._n_executed == 5);
+    REQUIRE(stats._n_reused == 0);
+}
+
+TEST_CASE("incremental_converter #2")
+{
+    majsdown::incremental_converter ic{std::cerr};
+    (void)do_test(ic, doc_v0);
+
+    // Edits that leave the JS state unchanged do not propagate to the tail
+    std::string doc_v1{doc_v0};
+    doc_v1.replace(doc_v1.find("B @@"), 1, "Z");
+
+    const auto stats = do_test(ic, doc_v1);
+    REQUIRE(stats._n_executed == 3);
+    REQUIRE(stats._n_reused == 2);
+}
+
+TEST_CASE("incremental_converter #3")
+{
+    majsdown::incremental_converter ic{std::cerr};
+    (void)do_test(ic, doc_v0);
+
+    // Edits that change the JS state re-execute everything after them
+    std::string doc_v1{doc_v0};
+    doc_v1.replace(doc_v1.find("add(2)"), 6, "add(5)");
+
+    const auto stats = do_test(ic, doc_v1);
+    REQUIRE(stats._n_executed == 5);
+    REQUIRE(stats._n_reused == 0);
+}
+
+TEST_CASE("incremental_converter #4")
+{
+    make_tmp_file("./incremental_dep.js", "var dep = 'one';");
+
+    constexpr std::string_view source = R"(A
+@@$ majsdown_include('./incremental_dep.js');
+B @@{dep}
+@@$ var other = 1;
+C @@{other}
+)";
+
+    majsdown::incremental_converter ic{std::cerr};
+    (void)do_test(ic, source);
+
+    // Changing an included file re-executes the segments that read it
+    make_tmp_file("./incremental_dep.js", "var dep = 'twelve';");
+
+    std::string buffer{source};
+    std::string scratch_buffer;
+
+    REQUIRE(ic.convert_all_passes(buffer, scratch_buffer) == 0);
+    REQUIRE(buffer == "A\nB twelve\nC 1\n");
+    REQUIRE(ic.get_last_stats()._n_executed >= 1);
+}
+
+TEST_CASE("incremental_converter #5")
+{
+    std::ostringstream diagnostics;
+    majsdown::incremental_converter ic{diagnostics};
+
+    constexpr std::string_view source = "A\n@@$ let x = 1;\n@@{y}\n";
+
+    std::string buffer{source};
+    std::string scratch_buffer;
+
+    REQUIRE(ic.convert_all_passes(buffer, scratch_buffer) == 1);
+    REQUIRE(diagnostics.str().find("((MJSD ERROR))(3)") != std::string::npos);
+}
+
+TEST_CASE("incremental_converter #6")
+{
+    constexpr std::string_view prelude = "var cfg = {};";
+
+    constexpr std::string_view source = R"(A
+@@$ cfg.title = 'Hello';
+B
+@@$ var other = 1;
+C @@{cfg.title} @@{other}
+)";
+
+    majsdown::incremental_converter ic{std::cerr};
+    REQUIRE(ic.load_prelude(prelude));
+    (void)do_test(ic, source, prelude);
+
+    // The state left by the prelude is rebuilt along with the segments'
+    std::string edited{source};
+    edited.replace(edited.find("B\n"), 1, "Z");
+
+    const auto stats = do_test(ic, edited, prelude);
+    REQUIRE(stats._n_executed == 2);
+    REQUIRE(stats._n_reused == 1);
+
+    edited.replace(edited.find("C @@"), 1, "Y");
+    REQUIRE(do_test(ic, edited, prelude)._n_executed == 3);
+}
+
+TEST_CASE("incremental_converter #7")
+{
+    // A tokenizer would take the regular expression for a division
+    constexpr std::string_view source =
+        "A\n"
+        "@@$ var g = 0; if (true) /'/.test(\"a\"); function outer() {"
+        " let g = 1; globalThis.h = function () { return g; }; }"
+        " outer(); // '\n"
+        "B @@{h()}\n"
+        "@@$ var other = 1;\n"
+        "C @@{h()} @@{other}\n";
+
+    majsdown::incremental_converter ic{std::cerr};
+    (void)do_test(ic, source);
+
+    // Closures behave as in a conversion from scratch
+    std::string edited{source};
+    edited.replace(edited.find("C @@"), 1, "Z");
+
+    const auto stats = do_test(ic, edited);
+    REQUIRE(stats._n_executed == 3);
+    REQUIRE(stats._n_reused == 0);
+
+    edited.replace(edited.find("B @@"), 1, "Y");
+
+    const auto stats2 = do_test(ic, edited);
+    REQUIRE(stats2._n_executed == 2);
+    REQUIRE(stats2._n_reused == 1);
+}
+
+TEST_CASE("incremental_converter #8")
+{
+    constexpr std::string_view source = R"(A
+@@$ var r = Math.random();
+B
+@@$ var other = 1;
+C @@{r >= 0 && r < 1} @@{other}
+)";
+
+    majsdown::incremental_converter ic{std::cerr};
+    (void)do_test(ic, source);
+
+    // Tails that read random numbers are never reused
+    std::string edited{source};
+    edited.replace(edited.find("A\n"), 1, "Z");
+
+    const auto stats = do_test(ic, edited);
+    REQUIRE(stats._n_executed == 3);
+    REQUIRE(stats._n_reused == 0);
+}
+
+TEST_CASE("incremental_converter #9")
+{
+    constexpr std::string_view source = R"(A
+@@$ var v = 1;
+B @@{'@' + '@{v}'}
+@@$ v = 2;
+C
+)";
+
+    majsdown::incremental_converter ic{std::cerr};
+    (void)do_test(ic, source);
+
+    // Directives output by the first pass see the final state, even if the
+    // tail producing it was reused
+    std::string edited{source};
+    edited.replace(edited.find("A\n"), 1, "Z");
+
+    std::string buffer{edited};
+    std::string scratch_buffer;
+
+    REQUIRE(ic.convert_all_passes(buffer, scratch_buffer) == 0);
+    REQUIRE(buffer == "Z\nB 2\nC\n");
+    REQUIRE(buffer == convert_full(edited));
+}
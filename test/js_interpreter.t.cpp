@@ -3,7 +3,10 @@
 #include <doctest/doctest.h>
 
 #include <majsdown/js_interpreter.hpp>
+#include <majsdown/result_cache.hpp>
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 
@@ -181,3 +184,424 @@ XXX
     REQUIRE(output_buffer == "");
     REQUIRE(has_line_diagnostic(oss, 5));
 }
+
+TEST_CASE("js_interpreter majsdown_json #0")
+{
+    {
+        std::ofstream ofs{"./js_interpreter_data.json"};
+        ofs << R"({"rows": [{"n": 1}, {"n": 2}], "title": "T"})";
+    }
+
+    majsdown::js_interpreter ji{std::cerr};
+
+    // Later calls return the same deep-frozen document
+    std::string output_buffer;
+    const bool ok = is_ok(ji.interpret(output_buffer, R"(
+const a = majsdown_json('./js_interpreter_data.json');
+const b = majsdown_json('./js_interpreter_data.json');
+__mjsd([a.title, a.rows.length, a.rows[1].n, a === b,
+    Object.isFrozen(a), Object.isFrozen(a.rows[0])].join(','));
+)"));
+
+    REQUIRE(ok);
+    REQUIRE(output_buffer == "T,2,2,true,true,true");
+}
+
+TEST_CASE("js_interpreter majsdown_json #1")
+{
+    {
+        std::ofstream ofs{"./js_interpreter_bad.json"};
+        ofs << "{";
+    }
+
+    std::ostringstream oss;
+    majsdown::js_interpreter ji{oss};
+
+    std::string output_buffer;
+    REQUIRE(!is_ok(ji.interpret(output_buffer,
+        "__mjsd(majsdown_json('./js_interpreter_bad.json'));")));
+
+    REQUIRE(!is_ok(ji.interpret(output_buffer,
+        "__mjsd(majsdown_json('./js_interpreter_missing.json'));")));
+
+    REQUIRE(output_buffer.empty());
+}
+
+TEST_CASE("js_interpreter majsdown_json #2")
+{
+    // Large enough to be mapped, and ending exactly on a page boundary
+    {
+        std::ofstream ofs{"./js_interpreter_large.json"};
+        ofs << '"' << std::string(64 * 1024 - 2, 'a') << '"';
+    }
+
+    majsdown::js_interpreter ji{std::cerr};
+
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer,
+        "__mjsd(majsdown_json('./js_interpreter_large.json').length);")));
+
+    REQUIRE(output_buffer == "65534");
+}
+
+TEST_CASE("js_interpreter majsdown_embed_bytes #0")
+{
+    {
+        std::ofstream ofs{"./js_interpreter_bytes.bin", std::ios::binary};
+        ofs.write("\x89PNG\0\xFF", 6);
+    }
+
+    majsdown::js_interpreter ji{std::cerr};
+
+    // Binary contents survive, and never pass through JS strings
+    std::string output_buffer;
+    const bool ok = is_ok(ji.interpret(output_buffer, R"(
+const bytes = majsdown_embed_bytes('./js_interpreter_bytes.bin');
+__mjsd([bytes.byteLength, new Uint8Array(bytes)[4],
+    majsdown_base64(bytes),
+    majsdown_data_uri(new Uint8Array(bytes, 4), 'image/png'),
+    majsdown_data_uri('hi'),
+    majsdown_embed('./js_interpreter_bytes.bin').length].join(' '));
+)"));
+
+    REQUIRE(ok);
+    REQUIRE(output_buffer == "6 0 iVBORwD/ data:image/png;base64,AP8= "
+                             "data:application/octet-stream;base64,aGk= 6");
+}
+
+TEST_CASE("js_interpreter profiles #0")
+{
+    std::ostringstream oss;
+    majsdown::js_interpreter ji{oss, majsdown::js_profile::strings};
+
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer,
+        "__mjsd(JSON.stringify({a: ['x'.repeat(2), Math.max(1, 2)]}));")));
+
+    REQUIRE(output_buffer == R"({"a":["xx",2]})");
+
+    // Left-out built-ins fail loudly, naming the profile
+    REQUIRE(!is_ok(ji.interpret(output_buffer, "__mjsd(new Date(0));")));
+    REQUIRE(oss.str().find("'Date' is not available with the 'strings' JS "
+                           "profile") != std::string::npos);
+
+    // Resetting keeps the profile
+    ji.reset();
+    REQUIRE(!is_ok(ji.interpret(output_buffer, "new Map();")));
+}
+
+TEST_CASE("js_interpreter profiles #1")
+{
+    majsdown::js_interpreter ji{std::cerr, majsdown::js_profile::standard};
+
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer,
+        "__mjsd(new Date(0).getUTCFullYear() + 'a-b'.replace(/-/g, '+') + "
+        "new Map([[1, 2]]).get(1) + new Uint8Array(3).length);")));
+
+    REQUIRE(output_buffer == "1970a+b23");
+    REQUIRE(majsdown::parse_js_profile("standard") ==
+            majsdown::js_profile::standard);
+    REQUIRE(!majsdown::parse_js_profile("none").has_value());
+}
+
+TEST_CASE("js_interpreter std prelude #0")
+{
+    majsdown::js_interpreter ji{std::cerr, majsdown::js_profile::strings};
+
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+__mjsd(wrapInCodeBlock('a ``` b', 'md') + '|' +
+    Base64.decode(Base64.encode('héllo')) + '|' +
+    godboltLink('int main() {}').startsWith('[on godbolt](https://'));
+)")));
+
+    REQUIRE(output_buffer == "````md\na ``` b\n````|héllo|true");
+}
+
+TEST_CASE("js_interpreter std prelude #1")
+{
+    majsdown::js_interpreter ji{std::cerr};
+
+    // Documents can redefine exports, before or after they are loaded
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+var Base64 = 'mine';
+function godboltLink() { return 'also mine'; }
+__mjsd(Base64 + ' ' + godboltLink() + ' ' + typeof wrapInCodeBlock);
+wrapInCodeBlock = 1;
+__mjsd(' ' + wrapInCodeBlock + ' ' + Base64);
+)")));
+
+    REQUIRE(output_buffer == "mine also mine function 1 mine");
+}
+
+TEST_CASE("js_interpreter modules #0")
+{
+    std::filesystem::create_directories("./js_interpreter_modules");
+
+    {
+        std::ofstream ofs{"./js_interpreter_modules/a.js"};
+        ofs << "import { twice } from './b.js';\n"
+               "globalThis.evaluations = (globalThis.evaluations ?? 0) + 1;\n"
+               "export const answer = twice(21);\n";
+    }
+
+    {
+        std::ofstream ofs{"./js_interpreter_modules/b.js"};
+        ofs << "export const twice = (x) => x * 2;\n";
+    }
+
+    majsdown::js_interpreter ji{std::cerr};
+    ji.set_module_directory("./js_interpreter_modules");
+
+    // Differently spelled paths name the same module, evaluated once
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+const a = majsdown_import('a.js');
+const b = majsdown_import('./a.js');
+__mjsd([a.answer, a === b, evaluations].join(','));
+)")));
+
+    REQUIRE(output_buffer == "42,true,1");
+
+    // After a reset, modules are evaluated again
+    ji.reset();
+    output_buffer.clear();
+
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+__mjsd([majsdown_import('a.js').answer, evaluations].join(','));
+)")));
+
+    REQUIRE(output_buffer == "42,1");
+
+    std::ostringstream oss;
+    majsdown::js_interpreter ji_missing{oss};
+
+    REQUIRE(!is_ok(
+        ji_missing.interpret_discard("majsdown_import('./none.js');")));
+}
+
+TEST_CASE("js_interpreter majsdown_include once")
+{
+    {
+        std::ofstream ofs{"./js_interpreter_include.js"};
+        ofs << "globalThis.n = (globalThis.n ?? 0) + 1;\n";
+    }
+
+    majsdown::js_interpreter ji{std::cerr};
+
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+majsdown_include('./js_interpreter_include.js', {once: true});
+majsdown_include('js_interpreter_include.js', {once: true});
+__mjsd(n);
+majsdown_include('./js_interpreter_include.js');
+__mjsd(n);
+)")));
+
+    REQUIRE(output_buffer == "12");
+}
+
+TEST_CASE("js_interpreter async #0")
+{
+    {
+        std::ofstream ofs{"./js_interpreter_async_a.txt"};
+        ofs << "A";
+    }
+
+    {
+        std::ofstream ofs{"./js_interpreter_async_b.txt"};
+        ofs << "B";
+    }
+
+    majsdown::js_interpreter ji{std::cerr};
+
+    // Both loads are in flight at once, results are output in call order
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+const a = majsdown_embed_async('./js_interpreter_async_a.txt');
+const b = majsdown_embed_async('./js_interpreter_async_b.txt');
+__mjsd(b);
+__mjsd(a);
+__mjsd((async () => (await a) + (await b))());
+)")));
+
+    // A directive evaluating to a promise is awaited
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+(async () => { __mjsd('|' + await b); })();
+)")));
+
+    REQUIRE(output_buffer == "BAAB|B");
+}
+
+TEST_CASE("js_interpreter async #1")
+{
+    std::ostringstream oss;
+    majsdown::js_interpreter ji{oss};
+
+    std::string output_buffer;
+    REQUIRE(!is_ok(ji.interpret(output_buffer,
+        "__mjsd(majsdown_embed_async('./js_interpreter_none.txt'));")));
+
+    REQUIRE(!is_ok(ji.interpret(
+        output_buffer, "__mjsd(new Promise(() => {}));")));
+
+    majsdown::js_interpreter ji_strings{oss, majsdown::js_profile::strings};
+
+    REQUIRE(!is_ok(ji_strings.interpret(output_buffer,
+        "majsdown_embed_async('./js_interpreter_async_a.txt');")));
+
+    REQUIRE(output_buffer.empty());
+}
+
+TEST_CASE("js_interpreter majsdown_parallel_map #0")
+{
+    majsdown::js_interpreter ji{std::cerr, majsdown::js_profile::strings};
+
+    // Results are in input order, whichever worker computed them
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+__mjsd(majsdown_parallel_map(
+    (s) => s.toUpperCase() + s.length, ['ab', 'cde', 'f']).join(','));
+
+const sums = majsdown_parallel_map(function (o) { return { sum: o.a + o.b }; },
+    Array.from({ length: 100 }, (_, i) => ({ a: i, b: 1 })));
+
+__mjsd('|' + sums.reduce((acc, o) => acc + o.sum, 0));
+__mjsd('|' + majsdown_parallel_map((x) => x, []).length);
+)")));
+
+    REQUIRE(output_buffer == "AB2,CDE3,F1|5050|0");
+}
+
+TEST_CASE("js_interpreter majsdown_parallel_map #1")
+{
+    std::ostringstream oss;
+    majsdown::js_interpreter ji{oss};
+
+    // Mapped functions cannot see the document's globals
+    REQUIRE(!is_ok(ji.interpret_discard(R"(
+const k = 1;
+majsdown_parallel_map((x) => x + k, [1, 2]);
+)")));
+
+    REQUIRE(
+        !is_ok(ji.interpret_discard("majsdown_parallel_map((x) => x, 1);")));
+    REQUIRE(!is_ok(ji.interpret_discard("majsdown_parallel_map('{', [1]);")));
+}
+
+TEST_CASE("js_interpreter majsdown_memo #0")
+{
+    std::filesystem::remove_all("./js_interpreter_memo");
+    majsdown::result_cache cache{
+        "./js_interpreter_memo", 1024 * 1024, std::cerr};
+
+    {
+        std::ofstream ofs{"./js_interpreter_memo_dep.txt"};
+        ofs << "a";
+    }
+
+    const auto run = [&](majsdown::result_cache* memo_cache)
+    {
+        majsdown::js_interpreter ji{std::cerr};
+        ji.set_memo_cache(memo_cache);
+
+        std::string output_buffer;
+        REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+var calls = 0;
+const f = () => 'v' + ++calls;
+__mjsd(majsdown_memo('k', f));
+__mjsd(majsdown_memo('k', f));
+__mjsd(majsdown_memo('d', f, ['./js_interpreter_memo_dep.txt']));
+__mjsd('|' + calls);
+)")));
+
+        return output_buffer;
+    };
+
+    REQUIRE(run(nullptr) == "v1v2v3|3");
+    REQUIRE(run(&cache) == "v1v1v2|2");
+
+    // Values persist across interpreters, until a dependency changes
+    REQUIRE(run(&cache) == "v1v1v2|0");
+
+    {
+        std::ofstream ofs{"./js_interpreter_memo_dep.txt"};
+        ofs << "b";
+    }
+
+    REQUIRE(run(&cache) == "v1v1v1|1");
+}
+
+TEST_CASE("js_interpreter majsdown_memo #1")
+{
+    std::ostringstream oss;
+    majsdown::js_interpreter ji{oss};
+
+    REQUIRE(!is_ok(ji.interpret_discard("majsdown_memo('k', 1);")));
+    REQUIRE(
+        !is_ok(ji.interpret_discard("majsdown_memo('k', () => 1, 'x');")));
+    REQUIRE(!is_ok(ji.interpret_discard(
+        "majsdown_memo('k', () => { throw new Error('e'); });")));
+}
+
+TEST_CASE("js_interpreter determinism #0")
+{
+    majsdown::js_interpreter ji{std::cerr};
+
+    bool nondeterministic = false;
+    ji.set_nondeterminism_flag(&nondeterministic);
+    ji.set_determinism(majsdown::determinism_config{
+        ._now_ms = 86400000, ._random_seed = 42});
+
+    std::string output_buffer;
+    REQUIRE(is_ok(ji.interpret(output_buffer, R"(
+__mjsd(Date.now());
+__mjsd('|' + new Date().toISOString());
+__mjsd('|' + new Date(0).getTime());
+__mjsd('|' + (new Date() instanceof Date));
+const r = [Math.random(), Math.random()];
+__mjsd('|' + (r[0] !== r[1] && r[0] >= 0 && r[1] < 1));
+)")));
+
+    REQUIRE(output_buffer == "86400000|1970-01-02T00:00:00.000Z|0|true|true");
+
+    // Resetting restarts the random sequence, including parallel workers'
+    const auto run = [&]
+    {
+        ji.reset();
+
+        std::string result;
+        REQUIRE(is_ok(ji.interpret(result, R"(
+__mjsd(Math.random() + '|' + majsdown_parallel_map(
+    () => Math.random() + Date.now(), [0, 1]).join(','));
+)")));
+
+        return result;
+    };
+
+    REQUIRE(run() == run());
+    REQUIRE(!nondeterministic);
+}
+
+TEST_CASE("js_interpreter determinism #1")
+{
+    majsdown::js_interpreter ji{std::cerr};
+
+    bool nondeterministic = false;
+    ji.set_nondeterminism_flag(&nondeterministic);
+
+    REQUIRE(is_ok(ji.interpret_discard("new Date(0).getTime();")));
+    REQUIRE(!nondeterministic);
+
+    // Uses of the real clock and random numbers are recorded
+    for (const std::string_view source :
+        {"Math.random();", "Date.now();", "new Date();", "Date();",
+            "majsdown_parallel_map(() => Math.random(), [0]);"})
+    {
+        nondeterministic = false;
+        REQUIRE(is_ok(ji.interpret_discard(source)));
+        REQUIRE(nondeterministic);
+    }
+}
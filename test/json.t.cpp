@@ -0,0 +1,68 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/json.hpp>
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+[[nodiscard]] static std::string roundtrip(const std::string_view source)
+{
+    const std::optional<majsdown::json_value> value =
+        majsdown::parse_json(source);
+
+    REQUIRE(value.has_value());
+
+    std::string result;
+    majsdown::append_json(result, *value);
+    return result;
+}
+
+TEST_CASE("json parse #0")
+{
+    REQUIRE(roundtrip("null") == "null");
+    REQUIRE(roundtrip(" true ") == "true");
+    REQUIRE(roundtrip("[1, 2.5, -3e2]") == "[1,2.5,-300]");
+    REQUIRE(roundtrip(R"({ "a" : { "b" : [] } })") == R"({"a":{"b":[]}})");
+}
+
+TEST_CASE("json parse #1")
+{
+    const std::optional<majsdown::json_value> value =
+        majsdown::parse_json(R"({"id": 1, "params": {"source": "a\nb"}})");
+
+    REQUIRE(value.has_value());
+    REQUIRE(value->is_object());
+
+    const majsdown::json_value* params = value->find("params");
+    REQUIRE(params != nullptr);
+    REQUIRE(params->find("source")->_string == "a\nb");
+    REQUIRE(value->find("missing") == nullptr);
+}
+
+TEST_CASE("json parse #2")
+{
+    const std::optional<majsdown::json_value> value =
+        majsdown::parse_json(R"("é😀\"")");
+
+    REQUIRE(value.has_value());
+    REQUIRE(value->_string == "\xC3\xA9\xF0\x9F\x98\x80\"");
+}
+
+TEST_CASE("json parse #3")
+{
+    REQUIRE(!majsdown::parse_json("").has_value());
+    REQUIRE(!majsdown::parse_json("[1,]").has_value());
+    REQUIRE(!majsdown::parse_json(R"({"a":})").has_value());
+    REQUIRE(!majsdown::parse_json("1 2").has_value());
+    REQUIRE(!majsdown::parse_json(R"("open)").has_value());
+}
+
+TEST_CASE("json append_json_string #0")
+{
+    std::string output;
+    majsdown::append_json_string(output, "a\"b\\c\n\x01");
+
+    REQUIRE(output == R"("a\"b\\c\n\u0001")");
+}
@@ -0,0 +1,86 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/converter.hpp>
+#include <majsdown/pipelined_converter.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+[[nodiscard]] bool no_setup(majsdown::converter&, int)
+{
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("pipelined_converter #0")
+{
+    // Helpers defined by the first pass are available to decorators
+    const std::string source = R"(
+@@${
+function wrap(code, lang) { return "```" + lang + "\n" + code + "\n```"; }
+}$
+\@@{not JS}
+@@_{wrap(code, "js")}_
+```cpp
+@@{1 + 1}
+```
+)";
+
+    std::string buffer = source;
+    REQUIRE(majsdown::convert_all_passes_pipelined(
+                buffer, std::cerr, no_setup, 1) == 0);
+
+    REQUIRE(buffer == R"(
+@@{not JS}
+```js
+2
+```
+)");
+}
+
+TEST_CASE("pipelined_converter #1")
+{
+    // Output matches the sequential passes, across many chunks
+    std::string source;
+    for (int i = 0; i < 200; ++i)
+    {
+        source += "@@$ var x" + std::to_string(i) + " = " + std::to_string(i) +
+                  ";\n# Slide @@{x" + std::to_string(i) +
+                  "}\n\\@@{x" + std::to_string(i) + " * 2}\n---\n";
+    }
+
+    std::string expected = source;
+    std::string scratch_buffer;
+
+    majsdown::converter cnvtr{std::cerr};
+    REQUIRE(cnvtr.convert_all_passes(expected, scratch_buffer) == 0);
+
+    std::string buffer = source;
+    REQUIRE(majsdown::convert_all_passes_pipelined(
+                buffer, std::cerr, no_setup, 64) == 0);
+
+    REQUIRE(buffer == expected);
+}
+
+TEST_CASE("pipelined_converter #2")
+{
+    std::ostringstream oss;
+
+    std::string buffer = "a\n@@{x}\n";
+    REQUIRE(majsdown::convert_all_passes_pipelined(
+                buffer, oss, no_setup, 1) == 1);
+
+    REQUIRE(oss.str().find("((MJSD ERROR))(2):") != std::string::npos);
+
+    // Setup runs on both passes, and its failures fail the pass
+    buffer = "a\n";
+    REQUIRE(majsdown::convert_all_passes_pipelined(buffer, oss,
+                [](majsdown::converter& cnvtr, const int pass_index)
+                { return pass_index == 1 && cnvtr.evaluate("var y = 1;"); },
+                1) == 2);
+}
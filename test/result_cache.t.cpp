@@ -0,0 +1,125 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/result_cache.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+void make_tmp_file(const std::string_view path, const std::string_view contents)
+{
+    std::ofstream ofs(std::string{path});
+    REQUIRE(ofs);
+
+    ofs << contents;
+    ofs.flush();
+
+    REQUIRE(ofs);
+}
+
+[[nodiscard]] std::string make_empty_dir(const std::string_view path)
+{
+    std::filesystem::remove_all(path);
+    return std::string{path};
+}
+
+} // namespace
+
+TEST_CASE("result_cache #0")
+{
+    majsdown::result_cache cache{
+        make_empty_dir("./result_cache_0"), 1024 * 1024, std::cerr};
+
+    const std::uint64_t key = majsdown::result_cache::compute_key("@@{1}", "");
+    REQUIRE(key != majsdown::result_cache::compute_key("@@{2}", ""));
+    REQUIRE(key != majsdown::result_cache::compute_key("@@{1}", "var x;"));
+
+    std::ostringstream oss;
+    REQUIRE(!cache.write_cached_output(key, oss));
+
+    cache.store(key, {}, "1\n");
+    REQUIRE(cache.write_cached_output(key, oss));
+    REQUIRE(oss.str() == "1\n");
+
+    // Empty outputs are valid entries
+    const std::uint64_t empty_key =
+        majsdown::result_cache::compute_key("", "");
+
+    cache.store(empty_key, {}, "");
+
+    std::ostringstream empty_oss;
+    REQUIRE(cache.write_cached_output(empty_key, empty_oss));
+    REQUIRE(empty_oss.str().empty());
+}
+
+TEST_CASE("result_cache #1")
+{
+    make_tmp_file("./result_cache_dep.js", "var x = 1;");
+
+    majsdown::result_cache cache{
+        make_empty_dir("./result_cache_1"), 1024 * 1024, std::cerr};
+
+    const std::uint64_t key = majsdown::result_cache::compute_key("src", "");
+    cache.store(key, {"./result_cache_dep.js", "./result_cache_dep.js"}, "out");
+
+    std::ostringstream oss;
+    std::vector<std::string> touched_files;
+    REQUIRE(cache.write_cached_output(key, oss, &touched_files));
+    REQUIRE(oss.str() == "out");
+    REQUIRE(touched_files ==
+            std::vector<std::string>{"./result_cache_dep.js"});
+
+    // Touched files changing invalidate the entry
+    make_tmp_file("./result_cache_dep.js", "var x = 2;");
+
+    std::ostringstream oss2;
+    REQUIRE(!cache.write_cached_output(key, oss2));
+    REQUIRE(oss2.str().empty());
+
+    // Entries depending on unreadable files are not stored
+    cache.store(key, {"./result_cache_missing.js"}, "out");
+    REQUIRE(!cache.write_cached_output(key, oss2));
+}
+
+TEST_CASE("result_cache #2")
+{
+    majsdown::result_cache cache{
+        make_empty_dir("./result_cache_2"), 4096, std::cerr};
+
+    const std::string big(1500, 'x');
+
+    for (int i = 0; i < 8; ++i)
+    {
+        cache.store(static_cast<std::uint64_t>(i), {}, big);
+    }
+
+    // Entries are evicted once the size cap is exceeded
+    std::size_t n_entries = 0;
+    std::uintmax_t total_size = 0;
+
+    for (const auto& entry :
+        std::filesystem::directory_iterator{"./result_cache_2"})
+    {
+        ++n_entries;
+        total_size += entry.file_size();
+    }
+
+    REQUIRE(n_entries < 8);
+    REQUIRE(total_size <= 4096);
+}
+
+TEST_CASE("result_cache #3")
+{
+    const std::uint64_t key = majsdown::result_cache::compute_memo_key("k");
+
+    REQUIRE(key == majsdown::result_cache::compute_memo_key("k"));
+    REQUIRE(key != majsdown::result_cache::compute_memo_key("k2"));
+    REQUIRE(key != majsdown::result_cache::compute_key("k", ""));
+}
@@ -0,0 +1,72 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/slides.hpp>
+
+#include <string_view>
+
+TEST_CASE("slides #0")
+{
+    const majsdown::slide_deck deck = majsdown::split_slides("A\n");
+
+    REQUIRE(deck._front_matter.empty());
+    REQUIRE(deck._slides.size() == 1);
+    REQUIRE(deck._slides[0] == "A\n");
+}
+
+TEST_CASE("slides #1")
+{
+    const majsdown::slide_deck deck =
+        majsdown::split_slides("A\n\n---\n\nB\n\n---\r\nC");
+
+    REQUIRE(deck._slides.size() == 3);
+    REQUIRE(deck._slides[0] == "A\n\n");
+    REQUIRE(deck._slides[1] == "\nB\n\n");
+    REQUIRE(deck._slides[2] == "C");
+}
+
+TEST_CASE("slides #2")
+{
+    // Front matter is not a slide break
+    const majsdown::slide_deck deck = majsdown::split_slides(
+        "---\ntheme: white\n---\n\nA\n\n---\nB\n");
+
+    REQUIRE(deck._front_matter == "---\ntheme: white\n---\n");
+    REQUIRE(deck._slides.size() == 2);
+    REQUIRE(deck._slides[0] == "\nA\n\n");
+    REQUIRE(deck._slides[1] == "B\n");
+}
+
+TEST_CASE("slides #3")
+{
+    // Breaks inside fenced code blocks are ignored
+    const majsdown::slide_deck deck = majsdown::split_slides(
+        "````md\n\n---\n```\n\n---\n````\n\n---\n~~~\n\n---\n~~~\nB\n");
+
+    REQUIRE(deck._slides.size() == 2);
+    REQUIRE(deck._slides[0] == "````md\n\n---\n```\n\n---\n````\n\n");
+    REQUIRE(deck._slides[1] == "~~~\n---\n~~~\nB\n");
+}
+
+TEST_CASE("slides #4")
+{
+    // Unterminated front matter is treated as a slide break
+    const majsdown::slide_deck deck = majsdown::split_slides("---\nA\n");
+
+    REQUIRE(deck._front_matter.empty());
+    REQUIRE(deck._slides.size() == 2);
+    REQUIRE(deck._slides[0].empty());
+    REQUIRE(deck._slides[1] == "A\n");
+}
+
+TEST_CASE("slides #5")
+{
+    // Right after text, `---` underlines a setext heading
+    const majsdown::slide_deck deck =
+        majsdown::split_slides("Title\n---\nA\n\n---\n---\nB\n");
+
+    REQUIRE(deck._slides.size() == 3);
+    REQUIRE(deck._slides[0] == "Title\n---\nA\n\n");
+    REQUIRE(deck._slides[1].empty());
+    REQUIRE(deck._slides[2] == "B\n");
+}
@@ -0,0 +1,56 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/spsc_queue.hpp>
+
+#include <cstddef>
+#include <string>
+#include <thread>
+
+TEST_CASE("spsc_queue #0")
+{
+    majsdown::spsc_queue<std::string> queue{2};
+
+    std::string value = "a";
+    REQUIRE(queue.try_push(value));
+    REQUIRE(value.empty());
+
+    value = "b";
+    REQUIRE(queue.try_push(value));
+
+    // Rejected pushes leave the value untouched
+    value = "c";
+    REQUIRE(!queue.try_push(value));
+    REQUIRE(value == "c");
+
+    std::string result;
+    REQUIRE(queue.try_pop(result));
+    REQUIRE(result == "a");
+
+    REQUIRE(queue.try_push(value));
+    REQUIRE(queue.pop() == "b");
+    REQUIRE(queue.pop() == "c");
+    REQUIRE(!queue.try_pop(result));
+}
+
+TEST_CASE("spsc_queue #1")
+{
+    majsdown::spsc_queue<std::size_t> queue{4};
+    constexpr std::size_t n = 100000;
+
+    std::thread producer{[&]
+        {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                queue.push(i);
+            }
+        }};
+
+    // Values arrive in order, none lost or duplicated
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        REQUIRE(queue.pop() == i);
+    }
+
+    producer.join();
+}
@@ -0,0 +1,42 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <majsdown/thread_pool.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+TEST_CASE("thread_pool parallel_for #0")
+{
+    majsdown::thread_pool pool{4};
+    REQUIRE(pool.get_n_workers() == 4);
+
+    for (const std::size_t n : {0u, 1u, 3u, 1000u})
+    {
+        std::vector<int> results(n, 0);
+        pool.parallel_for(n, [&](const std::size_t i) { results[i] += 1; });
+
+        for (const int r : results)
+        {
+            REQUIRE(r == 1);
+        }
+    }
+}
+
+TEST_CASE("thread_pool post #0")
+{
+    std::atomic<int> counter{0};
+
+    {
+        majsdown::thread_pool pool{2};
+
+        for (int i = 0; i < 100; ++i)
+        {
+            pool.post([&] { ++counter; });
+        }
+    }
+
+    // Queued tasks are completed before the pool is destroyed
+    REQUIRE(counter == 100);
+}